@@ -17,6 +17,7 @@
   
 #include "addplayerchange.h"
 
+#include <score/score.h>
 #include <score/system.h>
 
 AddPlayerChange::AddPlayerChange(const ScoreLocation &location,
@@ -31,9 +32,13 @@ AddPlayerChange::AddPlayerChange(const ScoreLocation &location,
 void AddPlayerChange::redo()
 {
     myLocation.getSystem().insertPlayerChange(myPlayerChange);
+    myLocation.getScore().invalidatePlayerChanges(
+        myLocation.getSystemIndex());
 }
 
 void AddPlayerChange::undo()
 {
     myLocation.getSystem().removePlayerChange(myPlayerChange);
+    myLocation.getScore().invalidatePlayerChanges(
+        myLocation.getSystemIndex());
 }
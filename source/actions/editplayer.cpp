@@ -35,8 +35,15 @@ void EditPlayer::redo()
     {
         // If the number of strings changed, remove the player from any staves
         // it was assigned to.
-        for (System &system : myScore.getSystems())
+        const Score &score = myScore;
+        for (size_t index = 0; index < score.getSystems().size(); ++index)
         {
+            // Only take a mutable reference to systems with player
+            // changes, since that marks the system as modified.
+            if (score.getSystems()[index].getPlayerChanges().empty())
+                continue;
+
+            System &system = myScore.getSystems()[index];
             for (PlayerChange &change : system.getPlayerChanges())
             {
                 myOriginalChanges.push_back(change);
@@ -65,8 +72,13 @@ void EditPlayer::undo()
     if (!myOriginalChanges.empty())
     {
         int i = 0;
-        for (System &system : myScore.getSystems())
+        const Score &score = myScore;
+        for (size_t index = 0; index < score.getSystems().size(); ++index)
         {
+            if (score.getSystems()[index].getPlayerChanges().empty())
+                continue;
+
+            System &system = myScore.getSystems()[index];
             for (PlayerChange &change : system.getPlayerChanges())
             {
                 change = myOriginalChanges[i];
@@ -30,32 +30,36 @@ EditStaff::EditStaff(const ScoreLocation &location, Staff::ClefType clef,
 
 void EditStaff::redo()
 {
-    System &system = myLocation.getSystem();
-    myOriginalSystem = system;
+    Score &score = myLocation.getScore();
+    const int system_index = myLocation.getSystemIndex();
+    const int next_system_index = system_index + 1;
 
+    // Take the snapshots before obtaining any references to the systems, since
+    // a system is copied the first time it is modified while it is shared.
+    myOriginalSystem = score.getSystemSnapshot(system_index);
+    myOriginalNextSystem = StoredSystem();
+    if (next_system_index < score.getSystems().size())
+        myOriginalNextSystem = score.getSystemSnapshot(next_system_index);
+
+    System &system = myLocation.getSystem();
     Staff &staff = myLocation.getStaff();
     staff.setClefType(myClef);
 
     // If we're changing the number of strings, more work is required...
     if (myNumStrings != staff.getStringCount())
     {
-        Score &score = myLocation.getScore();
         const int staff_index = myLocation.getStaffIndex();
 
         // If the following system doesn't start with a player change, it will
         // need one so that it has players with the correct number of strings.
-        const int next_system_index = myLocation.getSystemIndex() + 1;
-        if (next_system_index < score.getSystems().size())
+        if (myOriginalNextSystem &&
+            myOriginalNextSystem.get()->getStaves().size() >= staff_index)
         {
-            System &next_system = score.getSystems()[next_system_index];
-            myOriginalNextSystem = next_system;
-
-            if (next_system.getStaves().size() >= staff_index)
-                addPlayerChangeAtStart(score, next_system_index);
+            addPlayerChangeAtStart(score, next_system_index);
         }
 
         // Ensure that there's a player change at the start of the system.
-        addPlayerChangeAtStart(score, myLocation.getSystemIndex());
+        addPlayerChangeAtStart(score, system_index);
 
         // Clear out all active players in this staff.
         for (PlayerChange &change : system.getPlayerChanges())
@@ -72,10 +76,15 @@ void EditStaff::undo()
 {
     Score &score = myLocation.getScore();
     const int system_index = myLocation.getSystemIndex();
-    score.getSystems()[system_index] = myOriginalSystem;
+    score.setSystem(system_index, myOriginalSystem.get());
 
     if (myOriginalNextSystem)
-        score.getSystems()[system_index + 1] = *myOriginalNextSystem;
+        score.setSystem(system_index + 1, myOriginalNextSystem.get());
+}
+
+std::vector<StoredSystem *> EditStaff::getStoredSystems()
+{
+    return { &myOriginalSystem, &myOriginalNextSystem };
 }
 
 void EditStaff::addPlayerChangeAtStart(Score &score, int system_index)
@@ -91,5 +100,6 @@ void EditStaff::addPlayerChangeAtStart(Score &score, int system_index)
         PlayerChange change(*current_players);
         change.setPosition(0);
         system.insertPlayerChange(change);
+        score.invalidatePlayerChanges(system_index);
     }
 }
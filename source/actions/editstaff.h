@@ -18,12 +18,12 @@
 #ifndef ACTIONS_EDITCLEF_H
 #define ACTIONS_EDITCLEF_H
 
-#include <boost/optional.hpp>
+#include "storedsystem.h"
 #include <QUndoCommand>
 #include <score/scorelocation.h>
 #include <score/system.h>
 
-class EditStaff : public QUndoCommand
+class EditStaff : public QUndoCommand, public SnapshotHolder
 {
 public:
     EditStaff(const ScoreLocation &location, Staff::ClefType clef, int strings);
@@ -31,12 +31,14 @@ public:
     virtual void redo() override;
     virtual void undo() override;
 
+    virtual std::vector<StoredSystem *> getStoredSystems() override;
+
 private:
     static void addPlayerChangeAtStart(Score &score, int system_index);
 
     ScoreLocation myLocation;
-    System myOriginalSystem;
-    boost::optional<System> myOriginalNextSystem;
+    StoredSystem myOriginalSystem;
+    StoredSystem myOriginalNextSystem;
     Staff::ClefType myClef;
     int myNumStrings;
 };
@@ -27,16 +27,26 @@ PolishScore::PolishScore(Score &score)
 
 void PolishScore::redo()
 {
-    for (const System &system : myScore.getSystems())
-        myOriginalSystems.push_back(system);
+    const int num_systems = static_cast<int>(myScore.getSystems().size());
+    for (int i = 0; i < num_systems; ++i)
+        myOriginalSystems.push_back(myScore.getSystemSnapshot(i));
 
     ScoreUtils::polishScore(myScore);
 }
 
 void PolishScore::undo()
 {
-    std::copy(myOriginalSystems.begin(), myOriginalSystems.end(),
-              myScore.getSystems().begin());
+    for (size_t i = 0; i < myOriginalSystems.size(); ++i)
+        myScore.setSystem(static_cast<int>(i), myOriginalSystems[i].get());
 
     myOriginalSystems.clear();
 }
+
+std::vector<StoredSystem *> PolishScore::getStoredSystems()
+{
+    std::vector<StoredSystem *> systems;
+    for (StoredSystem &system : myOriginalSystems)
+        systems.push_back(&system);
+
+    return systems;
+}
@@ -18,12 +18,13 @@
 #ifndef ACTIONS_POLISHSCORE_H
 #define ACTIONS_POLISHSCORE_H
 
+#include "storedsystem.h"
 #include <QUndoCommand>
-#include <score/system.h>
+#include <vector>
 
 class Score;
 
-class PolishScore : public QUndoCommand
+class PolishScore : public QUndoCommand, public SnapshotHolder
 {
 public:
     PolishScore(Score &score);
@@ -31,9 +32,11 @@ public:
     virtual void redo() override;
     virtual void undo() override;
 
+    virtual std::vector<StoredSystem *> getStoredSystems() override;
+
 private:
     Score &myScore;
-    std::vector<System> myOriginalSystems;
+    std::vector<StoredSystem> myOriginalSystems;
 };
 
 #endif
@@ -33,8 +33,15 @@ void RemoveInstrument::redo()
 
     // Remove the instrument from any player changes that it was involved in.
     myOriginalChanges.clear();
-    for (System &system : myScore.getSystems())
+    const Score &score = myScore;
+    for (size_t index = 0; index < score.getSystems().size(); ++index)
     {
+        // Only take a mutable reference to systems with player changes, since
+        // that marks the system as modified.
+        if (score.getSystems()[index].getPlayerChanges().empty())
+            continue;
+
+        System &system = myScore.getSystems()[index];
         for (PlayerChange &change : system.getPlayerChanges())
         {
             myOriginalChanges.push_back(change);
@@ -69,8 +76,13 @@ void RemoveInstrument::undo()
 
     // Restore the original player changes.
     int i = 0;
-    for (System &system : myScore.getSystems())
+    const Score &score = myScore;
+    for (size_t index = 0; index < score.getSystems().size(); ++index)
     {
+        if (score.getSystems()[index].getPlayerChanges().empty())
+            continue;
+
+        System &system = myScore.getSystems()[index];
         for (PlayerChange &change : system.getPlayerChanges())
         {
             change = myOriginalChanges[i];
@@ -17,6 +17,7 @@
   
 #include "removeplayerchange.h"
 
+#include <score/score.h>
 #include <score/system.h>
 #include <score/utils.h>
 
@@ -32,9 +33,13 @@ RemovePlayerChange::RemovePlayerChange(const ScoreLocation &location)
 void RemovePlayerChange::redo()
 {
     myLocation.getSystem().removePlayerChange(myPlayerChange);
+    myLocation.getScore().invalidatePlayerChanges(
+        myLocation.getSystemIndex());
 }
 
 void RemovePlayerChange::undo()
 {
     myLocation.getSystem().insertPlayerChange(myPlayerChange);
+    myLocation.getScore().invalidatePlayerChanges(
+        myLocation.getSystemIndex());
 }
@@ -23,7 +23,7 @@ RemoveSystem::RemoveSystem(Score &score, int index)
     : QUndoCommand(QObject::tr("Remove System")),
       myScore(score),
       myIndex(index),
-      myOriginalSystem(score.getSystems()[index])
+      myOriginalSystem(score.getSystemSnapshot(index))
 {
 }
 
@@ -34,5 +34,10 @@ void RemoveSystem::redo()
 
 void RemoveSystem::undo()
 {
-    myScore.insertSystem(myOriginalSystem, myIndex);
+    myScore.insertSystem(myOriginalSystem.get(), myIndex);
+}
+
+std::vector<StoredSystem *> RemoveSystem::getStoredSystems()
+{
+    return { &myOriginalSystem };
 }
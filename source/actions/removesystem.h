@@ -18,12 +18,12 @@
 #ifndef ACTIONS_REMOVESYSTEM_H
 #define ACTIONS_REMOVESYSTEM_H
 
+#include "storedsystem.h"
 #include <QUndoCommand>
-#include <score/system.h>
 
 class Score;
 
-class RemoveSystem : public QUndoCommand
+class RemoveSystem : public QUndoCommand, public SnapshotHolder
 {
 public:
     RemoveSystem(Score &score, int index);
@@ -31,10 +31,12 @@ public:
     virtual void redo() override;
     virtual void undo() override;
 
+    virtual std::vector<StoredSystem *> getStoredSystems() override;
+
 private:
     Score &myScore;
     const int myIndex;
-    const System myOriginalSystem;
+    StoredSystem myOriginalSystem;
 };
 
 #endif
@@ -0,0 +1,539 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "storedsystem.h"
+
+#include <algorithm>
+#include <boost/filesystem/operations.hpp>
+#include <score/binaryserialization.h>
+#include <score/system.h>
+#include <stdexcept>
+
+namespace fs = boost::filesystem;
+
+/// The file is only compacted once it is at least this large, to avoid
+/// repeatedly rewriting small files.
+static const uint64_t MIN_COMPACT_SIZE = 1024 * 1024;
+
+/// Creates a new temporary file.
+static fs::path createSpillFile(std::fstream &file)
+{
+    const fs::path path = fs::temp_directory_path() /
+                          fs::unique_path("pte-undo-%%%%-%%%%-%%%%.tmp");
+    file.open(path.string(), std::ios::in | std::ios::out |
+                                 std::ios::binary | std::ios::trunc);
+    if (!file)
+        throw std::runtime_error("Could not create the undo spill file");
+
+    return path;
+}
+
+UndoSpillFile::UndoSpillFile() : mySize(0), myLiveSize(0), myNextId(0)
+{
+}
+
+UndoSpillFile::~UndoSpillFile()
+{
+    if (myFile.is_open())
+    {
+        myFile.close();
+
+        boost::system::error_code ec;
+        fs::remove(myPath, ec);
+    }
+}
+
+UndoSpillFile::EntryId UndoSpillFile::write(const std::string &data)
+{
+    // Create the file the first time that it is needed.
+    if (!myFile.is_open())
+    {
+        myPath = createSpillFile(myFile);
+        mySize = 0;
+    }
+
+    const Entry entry = { mySize, static_cast<uint32_t>(data.size()) };
+
+    myFile.clear();
+    myFile.seekp(static_cast<std::streamoff>(entry.myOffset));
+    myFile.write(data.data(), data.size());
+    myFile.flush();
+    if (!myFile)
+        throw std::runtime_error("Could not write to the undo spill file");
+
+    mySize += data.size();
+    myLiveSize += data.size();
+
+    const EntryId id = myNextId++;
+    myEntries[id] = entry;
+    return id;
+}
+
+std::string UndoSpillFile::read(EntryId id)
+{
+    auto it = myEntries.find(id);
+    if (it == myEntries.end())
+        throw std::logic_error("Invalid undo spill file entry");
+
+    return read(it->second);
+}
+
+std::string UndoSpillFile::read(const Entry &entry)
+{
+    std::string data(entry.mySize, '\0');
+
+    myFile.clear();
+    myFile.seekg(static_cast<std::streamoff>(entry.myOffset));
+    myFile.read(&data[0], data.size());
+    if (!myFile)
+        throw std::runtime_error("Could not read from the undo spill file");
+
+    return data;
+}
+
+void UndoSpillFile::release(EntryId id)
+{
+    auto it = myEntries.find(id);
+    if (it == myEntries.end())
+        return;
+
+    myLiveSize -= it->second.mySize;
+    myEntries.erase(it);
+
+    if (myEntries.empty())
+    {
+        // Remove the file, and create a new one if anything else is spilled.
+        myFile.close();
+        boost::system::error_code ec;
+        fs::remove(myPath, ec);
+        mySize = 0;
+    }
+    else if (mySize >= MIN_COMPACT_SIZE && mySize - myLiveSize > myLiveSize)
+    {
+        try
+        {
+            compact();
+        }
+        catch (const std::exception &)
+        {
+            // Keep using the existing file, and try again after the next
+            // entry is released.
+        }
+    }
+}
+
+void UndoSpillFile::compact()
+{
+    std::fstream file;
+    const fs::path path = createSpillFile(file);
+
+    // The ids are assigned in increasing order, so the entries are copied in
+    // the order that they appear in the file.
+    std::map<EntryId, Entry> entries;
+    uint64_t size = 0;
+    for (const auto &pair : myEntries)
+    {
+        const std::string data = read(pair.second);
+        file.write(data.data(), data.size());
+
+        entries[pair.first] = { size, pair.second.mySize };
+        size += data.size();
+    }
+
+    file.flush();
+    if (!file)
+    {
+        file.close();
+        boost::system::error_code ec;
+        fs::remove(path, ec);
+        throw std::runtime_error("Could not write to the undo spill file");
+    }
+
+    myFile.close();
+    boost::system::error_code ec;
+    fs::remove(myPath, ec);
+
+    myFile.swap(file);
+    myPath = path;
+    myEntries.swap(entries);
+    mySize = size;
+}
+
+uint64_t UndoSpillFile::size() const
+{
+    return mySize;
+}
+
+uint64_t UndoSpillFile::getLiveSize() const
+{
+    return myLiveSize;
+}
+
+/// Serializes the system with the binary archive format.
+static std::string serializeSystem(const System &system)
+{
+    ScoreUtils::BinaryOutputArchive ar(FileVersion::LATEST_VERSION);
+    ar.writeObject(system);
+    return ar.data();
+}
+
+/// The system, or its location in the spill file. This is shared by copies
+/// of a StoredSystem.
+struct StoredSystem::Storage
+{
+    explicit Storage(std::shared_ptr<const System> system)
+        : mySystem(std::move(system)), mySize(0), myEntry(0)
+    {
+    }
+
+    ~Storage()
+    {
+        if (myFile)
+            myFile->release(myEntry);
+    }
+
+    std::shared_ptr<const System> mySystem;
+    /// Cached serialized size of the system, or zero if not known yet.
+    size_t mySize;
+
+    std::shared_ptr<UndoSpillFile> myFile;
+    UndoSpillFile::EntryId myEntry;
+};
+
+StoredSystem::StoredSystem()
+{
+}
+
+StoredSystem::StoredSystem(std::shared_ptr<const System> system)
+{
+    if (system)
+        myStorage = std::make_shared<Storage>(std::move(system));
+}
+
+StoredSystem::operator bool() const
+{
+    return myStorage && (myStorage->mySystem || myStorage->myFile);
+}
+
+std::shared_ptr<const System> StoredSystem::get()
+{
+    if (!myStorage)
+        return nullptr;
+
+    Storage &storage = *myStorage;
+    if (!storage.mySystem && storage.myFile)
+    {
+        const std::string data = storage.myFile->read(storage.myEntry);
+
+        auto system = std::make_shared<System>();
+        ScoreUtils::BinaryInputArchive ar(data.data(),
+                                          data.data() + data.size(),
+                                          FileVersion::LATEST_VERSION);
+        ar.readObject(*system);
+
+        storage.mySystem = system;
+        storage.myFile->release(storage.myEntry);
+        storage.myFile.reset();
+    }
+
+    return storage.mySystem;
+}
+
+size_t StoredSystem::getMemoryUsage() const
+{
+    // If the score still shares the system, it doesn't cost anything extra.
+    if (!myStorage || !myStorage->mySystem ||
+        myStorage->mySystem.use_count() > 1)
+    {
+        return 0;
+    }
+
+    return getSize();
+}
+
+size_t StoredSystem::getSize() const
+{
+    // The in-memory size is larger than the serialized size, but this is a
+    // reasonable estimate for comparing snapshots.
+    if (myStorage->mySize == 0)
+        myStorage->mySize = serializeSystem(*myStorage->mySystem).size();
+
+    return myStorage->mySize;
+}
+
+bool StoredSystem::isSpilled() const
+{
+    return myStorage && myStorage->myFile;
+}
+
+size_t StoredSystem::getSpilledSize() const
+{
+    return isSpilled() ? myStorage->mySize : 0;
+}
+
+bool StoredSystem::spill(const std::shared_ptr<UndoSpillFile> &file)
+{
+    if (!myStorage || !myStorage->mySystem ||
+        myStorage->mySystem.use_count() > 1)
+    {
+        return false;
+    }
+
+    write(file);
+    return true;
+}
+
+void StoredSystem::write(const std::shared_ptr<UndoSpillFile> &file)
+{
+    Storage &storage = *myStorage;
+    const std::string data = serializeSystem(*storage.mySystem);
+    storage.myEntry = file->write(data);
+    storage.mySize = data.size();
+    storage.myFile = file;
+    storage.mySystem.reset();
+}
+
+SnapshotTracker::Node::Node()
+    : myState(State::Untracked),
+      mySystem(nullptr),
+      myReplaced(false),
+      myMemoryUsage(0),
+      myOwner(0)
+{
+}
+
+SnapshotTracker::SnapshotTracker()
+    : mySpillFile(std::make_shared<UndoSpillFile>()),
+      mySpillIndex(0),
+      myMemoryUsage(0),
+      myNumSpilled(0)
+{
+}
+
+void SnapshotTracker::setSnapshots(int command,
+                                   const std::vector<StoredSystem *> &snapshots)
+{
+    if (command >= static_cast<int>(myCommands.size()))
+    {
+        myCommands.resize(command + 1);
+        myCommandMemoryUsage.resize(command + 1);
+    }
+
+    std::vector<Key> previous;
+    previous.swap(myCommands[command]);
+
+    // Add the new snapshots before removing the previous ones, so that a
+    // snapshot which the command still holds remains tracked.
+    for (StoredSystem *snapshot : snapshots)
+    {
+        if (!*snapshot)
+            continue;
+
+        Key key = snapshot->myStorage.get();
+        if (!myNodes.count(key) && snapshot->myStorage->mySystem)
+        {
+            auto it = mySystems.find(snapshot->myStorage->mySystem.get());
+            if (it != mySystems.end())
+            {
+                key = it->second;
+                *snapshot = myNodes[key].mySnapshot;
+            }
+        }
+
+        Node &node = myNodes[key];
+        if (node.myState == State::Untracked)
+            node.mySnapshot = *snapshot;
+
+        node.myCommands.push_back(command);
+        myCommands[command].push_back(key);
+        refresh(key, node);
+    }
+
+    for (Key key : previous)
+        removeHolder(key, command);
+}
+
+void SnapshotTracker::removeCommands(int first)
+{
+    for (int i = static_cast<int>(myCommands.size()) - 1; i >= first; --i)
+    {
+        for (Key key : myCommands[i])
+            removeHolder(key, i);
+    }
+
+    if (first < static_cast<int>(myCommands.size()))
+    {
+        myCommands.resize(first);
+        myCommandMemoryUsage.resize(first);
+    }
+
+    mySpillIndex = std::min(mySpillIndex, first);
+}
+
+void SnapshotTracker::systemReplaced(const System *system)
+{
+    auto it = mySystems.find(system);
+    if (it == mySystems.end())
+        return;
+
+    const Key key = it->second;
+    Node &node = myNodes[key];
+    node.myReplaced = true;
+    refresh(key, node);
+}
+
+void SnapshotTracker::systemRestored(const System *system)
+{
+    auto it = mySystems.find(system);
+    if (it == mySystems.end())
+        return;
+
+    const Key key = it->second;
+    Node &node = myNodes[key];
+    node.myReplaced = false;
+    refresh(key, node);
+}
+
+void SnapshotTracker::enforceBudget(size_t budget)
+{
+    if (budget == 0)
+        return;
+
+    const int num_commands = static_cast<int>(myCommands.size());
+    for (; mySpillIndex < num_commands; ++mySpillIndex)
+    {
+        for (Key key : myCommands[mySpillIndex])
+        {
+            if (myMemoryUsage <= budget)
+                return;
+
+            Node &node = myNodes[key];
+            if (node.myState != State::Resident)
+                continue;
+
+            // The score no longer holds the system, so this releases it once
+            // any other references (e.g. from the renderer) are dropped.
+            node.mySnapshot.write(mySpillFile);
+            node.myReplaced = false;
+            refresh(key, node);
+        }
+    }
+}
+
+size_t SnapshotTracker::getNumSnapshots() const
+{
+    return myNodes.size();
+}
+
+size_t SnapshotTracker::getMemoryUsage() const
+{
+    return myMemoryUsage;
+}
+
+size_t SnapshotTracker::getNumSpilled() const
+{
+    return myNumSpilled;
+}
+
+uint64_t SnapshotTracker::getSpilledBytes() const
+{
+    return mySpillFile->getLiveSize();
+}
+
+const std::vector<size_t> &SnapshotTracker::getCommandMemoryUsage() const
+{
+    return myCommandMemoryUsage;
+}
+
+void SnapshotTracker::refresh(Key key, Node &node)
+{
+    uncount(key, node);
+
+    const StoredSystem::Storage &storage = *node.mySnapshot.myStorage;
+    const System *system = storage.mySystem.get();
+    if (system)
+        mySystems[system] = key;
+    node.mySystem = system;
+
+    node.myOwner = *std::min_element(node.myCommands.begin(),
+                                     node.myCommands.end());
+
+    if (!system)
+    {
+        node.myState = State::Spilled;
+        ++myNumSpilled;
+    }
+    else if (storage.mySystem.use_count() > 1 && !node.myReplaced)
+        node.myState = State::Shared;
+    else
+    {
+        node.myState = State::Resident;
+        node.myMemoryUsage = node.mySnapshot.getSize();
+        myMemoryUsage += node.myMemoryUsage;
+        myCommandMemoryUsage[node.myOwner] += node.myMemoryUsage;
+        mySpillIndex = std::min(mySpillIndex, node.myOwner);
+    }
+}
+
+void SnapshotTracker::uncount(Key key, Node &node)
+{
+    switch (node.myState)
+    {
+    case State::Untracked:
+    case State::Shared:
+        break;
+    case State::Resident:
+        myMemoryUsage -= node.myMemoryUsage;
+        myCommandMemoryUsage[node.myOwner] -= node.myMemoryUsage;
+        node.myMemoryUsage = 0;
+        break;
+    case State::Spilled:
+        --myNumSpilled;
+        break;
+    }
+
+    if (node.mySystem)
+    {
+        auto it = mySystems.find(node.mySystem);
+        if (it != mySystems.end() && it->second == key)
+            mySystems.erase(it);
+
+        node.mySystem = nullptr;
+    }
+
+    node.myState = State::Untracked;
+}
+
+void SnapshotTracker::removeHolder(Key key, int command)
+{
+    auto it = myNodes.find(key);
+    Node &node = it->second;
+
+    node.myCommands.erase(std::find(node.myCommands.begin(),
+                                    node.myCommands.end(), command));
+    if (node.myCommands.empty())
+    {
+        uncount(key, node);
+        myNodes.erase(it);
+    }
+    else
+        refresh(key, node);
+}
+
+SnapshotHolder::~SnapshotHolder()
+{
+}
@@ -0,0 +1,220 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ACTIONS_STOREDSYSTEM_H
+#define ACTIONS_STOREDSYSTEM_H
+
+#include <boost/filesystem/path.hpp>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class System;
+
+/// A temporary file that holds data which undo commands have moved out of
+/// memory. The file is removed when it is destroyed.
+class UndoSpillFile
+{
+public:
+    typedef uint64_t EntryId;
+
+    UndoSpillFile();
+    UndoSpillFile(const UndoSpillFile &) = delete;
+    UndoSpillFile &operator=(const UndoSpillFile &) = delete;
+    ~UndoSpillFile();
+
+    /// Appends the data to the file.
+    EntryId write(const std::string &data);
+    /// Reads back an entry that was previously written.
+    std::string read(EntryId id);
+    /// Frees an entry that is no longer needed. The file is removed once it
+    /// has no entries left, and is compacted if most of it is unused.
+    void release(EntryId id);
+
+    /// Returns the size of the file.
+    uint64_t size() const;
+    /// Returns the number of bytes used by entries that have not been
+    /// released.
+    uint64_t getLiveSize() const;
+
+private:
+    /// Location of an entry in the file.
+    struct Entry
+    {
+        uint64_t myOffset;
+        uint32_t mySize;
+    };
+
+    std::string read(const Entry &entry);
+    /// Copies the live entries to a new file.
+    void compact();
+
+    boost::filesystem::path myPath;
+    std::fstream myFile;
+    uint64_t mySize;
+    uint64_t myLiveSize;
+    std::map<EntryId, Entry> myEntries;
+    EntryId myNextId;
+};
+
+/// Holds a snapshot of a system for an undo command. While the snapshot is
+/// shared with the score it does not take up any additional memory, but once
+/// the system is modified the snapshot is the only copy of the original. In
+/// that case it can be spilled to a file if the undo history is using too much
+/// memory, and is reloaded when it is needed again. Copies of a StoredSystem
+/// share the same storage, so the system is only spilled or reloaded once.
+class StoredSystem
+{
+public:
+    StoredSystem();
+    StoredSystem(std::shared_ptr<const System> system);
+
+    /// Returns whether a system is stored.
+    explicit operator bool() const;
+
+    /// Returns the system, reloading it first if it was spilled.
+    std::shared_ptr<const System> get();
+
+    /// Returns the approximate number of bytes that would be freed by
+    /// spilling the system (zero if it is shared with the score or spilled).
+    size_t getMemoryUsage() const;
+
+    /// Returns whether the system has been spilled to a file.
+    bool isSpilled() const;
+    /// Returns the number of bytes occupied by the system in the spill file.
+    size_t getSpilledSize() const;
+
+    /// Writes the system to the file and releases it from memory, unless it
+    /// is shared with the score.
+    /// @return True if the system was spilled.
+    bool spill(const std::shared_ptr<UndoSpillFile> &file);
+
+private:
+    friend class SnapshotTracker;
+    struct Storage;
+
+    /// Returns the serialized size of the system, which must be in memory.
+    size_t getSize() const;
+    /// Writes the system to the file and releases this reference to it.
+    void write(const std::shared_ptr<UndoSpillFile> &file);
+
+    std::shared_ptr<Storage> myStorage;
+};
+
+/// Tracks the memory used by the snapshots in an undo stack. A system that is
+/// held by several snapshots is only counted (and spilled) once, and is
+/// charged to the oldest command that holds it.
+class SnapshotTracker
+{
+public:
+    SnapshotTracker();
+
+    /// Records the snapshots that are held by a command, replacing any that
+    /// were previously recorded for it. A snapshot of a system that is already
+    /// tracked is changed to share the existing snapshot's storage.
+    void setSnapshots(int command,
+                      const std::vector<StoredSystem *> &snapshots);
+    /// Stops tracking the snapshots of the given command and any later
+    /// commands.
+    void removeCommands(int first);
+
+    /// Records that the score no longer holds a system, e.g. because it was
+    /// copied before being modified. A snapshot that shared the system now
+    /// uses memory, even if something else (such as the renderer) still holds
+    /// a reference to it.
+    void systemReplaced(const System *system);
+    /// Records that the score holds a system again, e.g. after a command
+    /// restored it from a snapshot.
+    void systemRestored(const System *system);
+
+    /// Spills systems from the oldest commands until the memory usage is
+    /// within the budget.
+    void enforceBudget(size_t budget);
+
+    /// Returns the number of unique systems held by the snapshots.
+    size_t getNumSnapshots() const;
+    /// Returns the bytes used by systems that are only held by snapshots.
+    size_t getMemoryUsage() const;
+    size_t getNumSpilled() const;
+    uint64_t getSpilledBytes() const;
+    /// Returns the bytes used by each command's snapshots.
+    const std::vector<size_t> &getCommandMemoryUsage() const;
+
+private:
+    typedef const StoredSystem::Storage *Key;
+
+    enum class State
+    {
+        Untracked,
+        Shared,
+        Resident,
+        Spilled
+    };
+
+    struct Node
+    {
+        Node();
+
+        /// Keeps the storage alive while the node is tracked.
+        StoredSystem mySnapshot;
+        /// The commands that hold the snapshot.
+        std::vector<int> myCommands;
+        State myState;
+        /// The system that the node was registered under, if it is resident.
+        const System *mySystem;
+        /// Whether the score has stopped sharing the system.
+        bool myReplaced;
+        /// The bytes that are charged to the owning command.
+        size_t myMemoryUsage;
+        int myOwner;
+    };
+
+    /// Recomputes the node's state and updates the totals.
+    void refresh(Key key, Node &node);
+    /// Removes the node's contribution to the totals.
+    void uncount(Key key, Node &node);
+    void removeHolder(Key key, int command);
+
+    std::shared_ptr<UndoSpillFile> mySpillFile;
+    std::unordered_map<Key, Node> myNodes;
+    /// The snapshots held by each command.
+    std::vector<std::vector<Key>> myCommands;
+    std::vector<size_t> myCommandMemoryUsage;
+    /// Resident systems, used to find snapshots that can share storage.
+    std::unordered_map<const System *, Key> mySystems;
+    /// Commands before this one have no resident snapshots to spill.
+    int mySpillIndex;
+    size_t myMemoryUsage;
+    size_t myNumSpilled;
+};
+
+/// Implemented by undo commands that keep snapshots of systems, so that the
+/// undo manager can measure and limit the memory used by the undo history.
+class SnapshotHolder
+{
+public:
+    virtual ~SnapshotHolder();
+
+    /// Returns the snapshots held by the command.
+    virtual std::vector<StoredSystem *> getStoredSystems() = 0;
+};
+
+#endif
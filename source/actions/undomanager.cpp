@@ -17,14 +17,27 @@
 
 #include "undomanager.h"
 
+#include "storedsystem.h"
+#include <algorithm>
+#include <iterator>
+#include <QDebug>
+#include <score/score.h>
+
 UndoManager::UndoManager(QObject *parent) :
-    QUndoGroup(parent)
+    QUndoGroup(parent),
+    memoryBudget(0)
 {
+    connect(this, &QUndoGroup::indexChanged, this,
+            &UndoManager::onIndexChanged);
 }
 
-void UndoManager::addNewUndoStack()
+void UndoManager::addNewUndoStack(const Score &score)
 {
     undoStacks.emplace_back(new QUndoStack);
+    scores.push_back(&score);
+    modifiedSystems.emplace_back();
+    snapshotTrackers.emplace_back(new SnapshotTracker());
+    trackedIndices.push_back(0);
     addStack(undoStacks.back().get());
 }
 
@@ -34,12 +47,17 @@ void UndoManager::setActiveStackIndex(int index)
         return;
 
     setActiveStack(undoStacks.at(index).get());
+    emit memoryStatsChanged();
 }
 
 void UndoManager::removeStack(int index)
 {
     // Stack is automatically removed from the QUndoGroup when it is deleted.
     undoStacks.erase(undoStacks.begin() + index);
+    scores.erase(scores.begin() + index);
+    modifiedSystems.erase(modifiedSystems.begin() + index);
+    snapshotTrackers.erase(snapshotTrackers.begin() + index);
+    trackedIndices.erase(trackedIndices.begin() + index);
 }
 
 void UndoManager::push(QUndoCommand *cmd)
@@ -52,6 +70,9 @@ void UndoManager::push(QUndoCommand *cmd, int affectedSystem)
     beginMacro(cmd->actionText());
 
     auto onUndo = new SignalOnUndo();
+    connect(onUndo, &SignalOnUndo::aboutToRedo, [=]() {
+        recordSystems(affectedSystem);
+    });
     if (affectedSystem >= 0)
     {
         connect(onUndo, &SignalOnUndo::triggered, [=]() {
@@ -61,13 +82,16 @@ void UndoManager::push(QUndoCommand *cmd, int affectedSystem)
     else
     {
         connect(onUndo, &SignalOnUndo::triggered, this,
-                &UndoManager::fullRedrawNeeded);
+                &UndoManager::onAllSystemsChanged);
     }
 
     push(onUndo);
     push(cmd);
 
     auto onRedo = new SignalOnRedo();
+    connect(onRedo, &SignalOnRedo::aboutToUndo, [=]() {
+        recordSystems(affectedSystem);
+    });
     if (affectedSystem >= 0)
     {
         connect(onRedo, &SignalOnRedo::triggered, [=]() {
@@ -77,7 +101,7 @@ void UndoManager::push(QUndoCommand *cmd, int affectedSystem)
     else
     {
         connect(onRedo, &SignalOnRedo::triggered, this,
-                &UndoManager::fullRedrawNeeded);
+                &UndoManager::onAllSystemsChanged);
     }
 
     push(onRedo);
@@ -87,11 +111,215 @@ void UndoManager::push(QUndoCommand *cmd, int affectedSystem)
 void UndoManager::setClean()
 {
     activeStack()->setClean();
+    modifiedSystems.at(activeStackIndex()) = ModifiedSystems();
+}
+
+boost::optional<std::vector<int>> UndoManager::getModifiedSystems() const
+{
+    const ModifiedSystems &modified = modifiedSystems.at(activeStackIndex());
+    if (modified.allSystems)
+        return boost::none;
+
+    return std::vector<int>(modified.systems.begin(), modified.systems.end());
 }
 
 void UndoManager::onSystemChanged(int affectedSystem)
 {
+    findReplacedSystems(affectedSystem);
+
+    ModifiedSystems &modified = modifiedSystems.at(activeStackIndex());
+    modified.systems.insert(affectedSystem);
+
     emit redrawNeeded(affectedSystem);
+    emit systemsModified(affectedSystem);
+}
+
+void UndoManager::onAllSystemsChanged()
+{
+    findReplacedSystems(AFFECTS_ALL_SYSTEMS);
+
+    // Systems may have been inserted or removed, so the indices of any
+    // previously modified systems are no longer meaningful.
+    ModifiedSystems &modified = modifiedSystems.at(activeStackIndex());
+    modified.allSystems = true;
+    modified.systems.clear();
+
+    emit fullRedrawNeeded();
+    emit systemsModified(AFFECTS_ALL_SYSTEMS);
+}
+
+/// Returns the score's nodes for the affected systems, in sorted order.
+static std::vector<const System *> getSystemNodes(const Score &score,
+                                                  int affectedSystem)
+{
+    const int numSystems = static_cast<int>(score.getSystems().size());
+
+    std::vector<const System *> nodes;
+    if (affectedSystem == UndoManager::AFFECTS_ALL_SYSTEMS)
+    {
+        for (int i = 0; i < numSystems; ++i)
+            nodes.push_back(score.getSystemNode(i));
+    }
+    else if (affectedSystem < numSystems)
+        nodes.push_back(score.getSystemNode(affectedSystem));
+
+    std::sort(nodes.begin(), nodes.end());
+    return nodes;
+}
+
+void UndoManager::recordSystems(int affectedSystem)
+{
+    const int index = activeStackIndex();
+    if (index >= 0)
+        systemsBeforeChange = getSystemNodes(*scores.at(index), affectedSystem);
+}
+
+void UndoManager::findReplacedSystems(int affectedSystem)
+{
+    const int index = activeStackIndex();
+    if (index < 0)
+        return;
+
+    // Any system that changed nodes was either copied before being modified,
+    // removed, or replaced by a snapshot.
+    const std::vector<const System *> after =
+        getSystemNodes(*scores.at(index), affectedSystem);
+
+    std::vector<const System *> replaced;
+    std::set_difference(systemsBeforeChange.begin(), systemsBeforeChange.end(),
+                        after.begin(), after.end(),
+                        std::back_inserter(replaced));
+    for (const System *system : replaced)
+        sharingChanges.emplace_back(system, false);
+
+    std::vector<const System *> restored;
+    std::set_difference(after.begin(), after.end(),
+                        systemsBeforeChange.begin(), systemsBeforeChange.end(),
+                        std::back_inserter(restored));
+    for (const System *system : restored)
+        sharingChanges.emplace_back(system, true);
+
+    systemsBeforeChange.clear();
+}
+
+int UndoManager::activeStackIndex() const
+{
+    for (size_t i = 0; i < undoStacks.size(); ++i)
+    {
+        if (undoStacks[i].get() == activeStack())
+            return static_cast<int>(i);
+    }
+
+    return -1;
+}
+
+void UndoManager::setMemoryBudget(size_t bytes)
+{
+    memoryBudget = bytes;
+
+    for (size_t i = 0; i < undoStacks.size(); ++i)
+        enforceMemoryBudget(static_cast<int>(i));
+
+    emit memoryStatsChanged();
+}
+
+UndoManager::MemoryStats UndoManager::getMemoryStats() const
+{
+    MemoryStats stats;
+
+    const int index = activeStackIndex();
+    if (index < 0)
+        return stats;
+
+    const SnapshotTracker &tracker = *snapshotTrackers.at(index);
+    stats.numCommands = undoStacks.at(index)->count();
+    stats.numSnapshots = tracker.getNumSnapshots();
+    stats.memoryUsage = tracker.getMemoryUsage();
+    stats.numSpilled = tracker.getNumSpilled();
+    stats.spilledBytes = static_cast<size_t>(tracker.getSpilledBytes());
+    stats.commandMemoryUsage = tracker.getCommandMemoryUsage();
+    stats.commandMemoryUsage.resize(stats.numCommands);
+
+    return stats;
+}
+
+/// Collects the snapshots from the command and any child commands (e.g. for
+/// macros).
+static void findSnapshots(const QUndoCommand *cmd,
+                          std::vector<StoredSystem *> &snapshots)
+{
+    // The snapshots are modified when spilling them, but this does not change
+    // the behaviour of the command.
+    auto holder =
+        dynamic_cast<SnapshotHolder *>(const_cast<QUndoCommand *>(cmd));
+    if (holder)
+    {
+        for (StoredSystem *snapshot : holder->getStoredSystems())
+            snapshots.push_back(snapshot);
+    }
+
+    for (int i = 0; i < cmd->childCount(); ++i)
+        findSnapshots(cmd->child(i), snapshots);
+}
+
+void UndoManager::onIndexChanged(int index)
+{
+    const int stackIndex = activeStackIndex();
+    if (stackIndex < 0)
+        return;
+
+    const QUndoStack &stack = *undoStacks.at(stackIndex);
+    SnapshotTracker &tracker = *snapshotTrackers.at(stackIndex);
+    int &trackedIndex = trackedIndices.at(stackIndex);
+
+    // Pushing a command deletes any commands that could have been redone.
+    tracker.removeCommands(stack.count());
+
+    // Snapshots from older commands only change state when the score stops
+    // or starts sharing their systems, which happens to the systems that the
+    // executed commands modified. This is done before tracking the executed
+    // commands' snapshots: a replaced system may since have been freed, but a
+    // system that was already tracked is kept alive by its snapshot and so
+    // cannot have reused its address.
+    for (const auto &change : sharingChanges)
+    {
+        if (change.second)
+            tracker.systemRestored(change.first);
+        else
+            tracker.systemReplaced(change.first);
+    }
+    sharingChanges.clear();
+
+    // Only the commands that were executed can have taken or released
+    // snapshots, which avoids visiting the whole stack.
+    for (int i = std::min(index, trackedIndex);
+         i < std::max(index, trackedIndex) && i < stack.count(); ++i)
+    {
+        std::vector<StoredSystem *> snapshots;
+        findSnapshots(stack.command(i), snapshots);
+        tracker.setSnapshots(i, snapshots);
+    }
+
+    trackedIndex = index;
+    enforceMemoryBudget(stackIndex);
+
+    emit memoryStatsChanged();
+}
+
+void UndoManager::enforceMemoryBudget(int index)
+{
+    if (memoryBudget == 0 || index < 0)
+        return;
+
+    try
+    {
+        snapshotTrackers.at(index)->enforceBudget(memoryBudget);
+    }
+    catch (const std::exception &e)
+    {
+        // The snapshots that could not be spilled just remain in memory.
+        qWarning() << "Could not spill undo history:" << e.what();
+    }
 }
 
 void UndoManager::beginMacro(const QString &text)
@@ -109,6 +337,16 @@ void SignalOnRedo::redo()
     emit triggered();
 }
 
+void SignalOnRedo::undo()
+{
+    emit aboutToUndo();
+}
+
+void SignalOnUndo::redo()
+{
+    emit aboutToRedo();
+}
+
 void SignalOnUndo::undo()
 {
     emit triggered();
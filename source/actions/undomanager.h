@@ -18,12 +18,19 @@
 #ifndef ACTIONS_UNDOMANAGER_H
 #define ACTIONS_UNDOMANAGER_H
 
+#include <boost/optional/optional.hpp>
 #include <memory>
 #include <QUndoGroup>
 #include <QUndoStack>
+#include <set>
+#include <utility>
 #include <vector>
 
 class QUndoCommand;
+class Score;
+class SnapshotTracker;
+class StoredSystem;
+class System;
 
 class UndoManager : public QUndoGroup
 {
@@ -32,7 +39,8 @@ class UndoManager : public QUndoGroup
 public:
     explicit UndoManager(QObject *parent = nullptr);
 
-    void addNewUndoStack();
+    /// Adds an undo stack for the commands that modify the given score.
+    void addNewUndoStack(const Score &score);
     void setActiveStackIndex(int index);
     void removeStack(int index);
 
@@ -43,22 +51,101 @@ public:
 
     void setClean();
 
+    /// Returns the systems that have been modified (by undoing or redoing
+    /// commands) since the active stack was created or last marked as clean.
+    /// Returns boost::none if any system may have been modified.
+    boost::optional<std::vector<int>> getModifiedSystems() const;
+
     void beginMacro(const QString &text);
     void endMacro();
 
+    /// Sets the maximum number of bytes that the system snapshots in each
+    /// undo stack may use. When a stack is over budget, the snapshots from
+    /// the oldest commands are spilled to a temporary file and are reloaded
+    /// if those commands are undone. A budget of zero disables the limit.
+    void setMemoryBudget(size_t bytes);
+
+    /// Statistics about the memory used by an undo stack.
+    struct MemoryStats
+    {
+        MemoryStats()
+            : numCommands(0),
+              numSnapshots(0),
+              memoryUsage(0),
+              numSpilled(0),
+              spilledBytes(0)
+        {
+        }
+
+        int numCommands;
+        /// The number of unique systems held by the snapshots.
+        size_t numSnapshots;
+        /// Bytes used by snapshots that are only held by the undo stack.
+        size_t memoryUsage;
+        size_t numSpilled;
+        size_t spilledBytes;
+        /// Bytes used by each command's snapshots, from the oldest command to
+        /// the newest. A system that is held by several commands is charged
+        /// to the oldest one.
+        std::vector<size_t> commandMemoryUsage;
+    };
+
+    /// Returns the memory statistics for the active stack.
+    MemoryStats getMemoryStats() const;
+
     static const int AFFECTS_ALL_SYSTEMS = -1;
 
 signals:
     void fullRedrawNeeded();
     void redrawNeeded(int);
+    /// Emitted after a command is done or undone, with the index of the
+    /// affected system (or AFFECTS_ALL_SYSTEMS).
+    void systemsModified(int);
+    /// Emitted when the memory used by the active stack may have changed.
+    void memoryStatsChanged();
 
 private:
     /// Pushes the QUndoCommand onto the active stack.
     void push(QUndoCommand *cmd);
 
     void onSystemChanged(int affectedSystem);
+    void onAllSystemsChanged();
+    /// Records the score's systems before a command modifies them.
+    void recordSystems(int affectedSystem);
+    /// Compares the score's systems with recordSystems(), to find the
+    /// snapshots that the score stopped or started sharing.
+    void findReplacedSystems(int affectedSystem);
+    /// Updates the tracked snapshots for the commands that were pushed, undone
+    /// or redone.
+    void onIndexChanged(int index);
+
+    int activeStackIndex() const;
+
+    /// Spills snapshots from the oldest commands until the stack is within
+    /// the memory budget.
+    void enforceMemoryBudget(int index);
+
+    /// Tracks the systems that were modified since the last save.
+    struct ModifiedSystems
+    {
+        ModifiedSystems() : allSystems(false) {}
+
+        bool allSystems;
+        std::set<int> systems;
+    };
 
     std::vector<std::unique_ptr<QUndoStack>> undoStacks;
+    std::vector<const Score *> scores;
+    std::vector<ModifiedSystems> modifiedSystems;
+    std::vector<std::unique_ptr<SnapshotTracker>> snapshotTrackers;
+    /// The index of each stack when its snapshots were last updated.
+    std::vector<int> trackedIndices;
+    /// The systems from the last call to recordSystems().
+    std::vector<const System *> systemsBeforeChange;
+    /// The systems that the score stopped (false) or started (true) holding
+    /// since the snapshots were last updated, in order.
+    std::vector<std::pair<const System *, bool>> sharingChanges;
+    size_t memoryBudget;
 };
 
 class SignalOnRedo : public QObject, public QUndoCommand
@@ -67,9 +154,12 @@ class SignalOnRedo : public QObject, public QUndoCommand
 
 public:
     virtual void redo() override;
+    virtual void undo() override;
 
 signals:
     void triggered();
+    /// Emitted before the command that precedes this one is undone.
+    void aboutToUndo();
 };
 
 class SignalOnUndo: public QObject, public QUndoCommand
@@ -77,10 +167,13 @@ class SignalOnUndo: public QObject, public QUndoCommand
     Q_OBJECT
 
 public:
+    virtual void redo() override;
     virtual void undo() override;
 
 signals:
     void triggered();
+    /// Emitted before the command that follows this one is redone.
+    void aboutToRedo();
 };
 
 #endif
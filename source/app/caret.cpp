@@ -56,7 +56,9 @@ void Caret::moveHorizontal(int offset)
 
 void Caret::moveVertical(int offset)
 {
-    const int numStrings = myLocation.getStaff().getStringCount();
+    const int numStrings =
+        getCurrentSystem().getStaves()[myLocation.getStaffIndex()]
+            .getStringCount();
     myLocation.setString((myLocation.getString() + offset + numStrings) %
                          numStrings);
 
@@ -96,7 +98,7 @@ void Caret::moveStaff(int offset)
 void Caret::moveToStaff(int staff)
 {
     const int num_staves =
-        static_cast<int>(myLocation.getSystem().getStaves().size());
+        static_cast<int>(getCurrentSystem().getStaves().size());
     staff = boost::algorithm::clamp(staff, 0, num_staves - 1);
 
     const bool is_increasing = staff >= myLocation.getStaffIndex();
@@ -124,13 +126,13 @@ void Caret::moveToStaff(int staff)
 
 bool Caret::moveToNextBar()
 {
-    const Barline *nextBar = myLocation.getSystem().getNextBarline(
+    const Barline *nextBar = getCurrentSystem().getNextBarline(
                 myLocation.getPositionIndex());
     if (!nextBar)
         return false;
 
     // Move into the next system if necessary.
-    if (*nextBar == myLocation.getSystem().getBarlines().back())
+    if (*nextBar == getCurrentSystem().getBarlines().back())
         return moveToSystem(myLocation.getSystemIndex() + 1, true);
     else
     {
@@ -141,7 +143,7 @@ bool Caret::moveToNextBar()
 
 void Caret::moveToPrevBar()
 {
-    const System &system = myLocation.getSystem();
+    const System &system = getCurrentSystem();
     const Barline *prevBar = system.getPreviousBarline(
                 myLocation.getPositionIndex());
     if (prevBar)
@@ -155,7 +157,7 @@ void Caret::moveToPrevBar()
         moveToSystem(myLocation.getSystemIndex() - 1, true);
 
         // Move to the last barline if possible.
-        const System &newSystem = myLocation.getSystem();
+        const System &newSystem = getCurrentSystem();
         const size_t count = newSystem.getBarlines().size();
         if (count > 2)
             moveToPosition(newSystem.getBarlines()[count - 2].getPosition());
@@ -168,10 +170,15 @@ boost::signals2::connection Caret::subscribeToChanges(
     return onLocationChanged.connect(subscriber);
 }
 
+const System &Caret::getCurrentSystem() const
+{
+    return myLocation.getSystem();
+}
+
 int Caret::getLastPosition() const
 {
     // There must be at least one position space to the left of the last bar.
-    return myLocation.getSystem().getBarlines().back().getPosition() - 1;
+    return getCurrentSystem().getBarlines().back().getPosition() - 1;
 }
 
 int Caret::getLastSystemIndex() const
@@ -202,7 +209,7 @@ bool Caret::moveToSystem(int system, bool keepStaff)
         {
             myLocation.setStaffIndex(boost::algorithm::clamp(
                 myLocation.getStaffIndex(), 0,
-                static_cast<int>(myLocation.getSystem().getStaves().size() - 1)));
+                static_cast<int>(getCurrentSystem().getStaves().size() - 1)));
         }
 
         myLocation.setPositionIndex(0);
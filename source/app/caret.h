@@ -90,6 +90,10 @@ private:
     /// Move to the specified staff.
     void moveToStaff(int staff);
 
+    /// Returns the current system. This only reads from the score, so a
+    /// system that is shared with a snapshot of the score is not copied.
+    const System &getCurrentSystem() const;
+
     /// Returns the last valid position in the system.
     int getLastPosition() const;
     /// Returns the last valid system index in the score.
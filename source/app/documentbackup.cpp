@@ -0,0 +1,329 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "documentbackup.h"
+
+#include <algorithm>
+#include <boost/filesystem/operations.hpp>
+#include <chrono>
+#include <formats/powertab/chunkedfile.h>
+#include <iterator>
+#include <score/binaryserialization.h>
+#include <string>
+
+namespace fs = boost::filesystem;
+
+static fs::path getBackupPath(const fs::path &dir, int generation)
+{
+    return dir / ("backup-" + std::to_string(generation) + ".pt2");
+}
+
+static fs::path getJournalPath(const fs::path &dir, int generation)
+{
+    return dir / ("journal-" + std::to_string(generation) + ".log");
+}
+
+static fs::path getFilenamePath(const fs::path &dir)
+{
+    return dir / "filename.txt";
+}
+
+/// Returns the generation of a backup or journal file, or -1.
+static int getGeneration(const fs::path &path, const std::string &prefix,
+                         const std::string &extension)
+{
+    const std::string name = path.filename().string();
+    if (name.size() <= prefix.size() + extension.size() ||
+        name.compare(0, prefix.size(), prefix) != 0 ||
+        path.extension() != extension)
+    {
+        return -1;
+    }
+
+    const std::string number = name.substr(
+        prefix.size(), name.size() - prefix.size() - extension.size());
+    if (number.find_first_not_of("0123456789") != std::string::npos)
+        return -1;
+
+    return std::stoi(number);
+}
+
+DocumentBackup::DocumentBackup(const fs::path &dir)
+    : myDirectory(dir),
+      myGeneration(-1),
+      myHasChanges(false),
+      mySnapshotPending(false)
+{
+}
+
+DocumentBackup::~DocumentBackup()
+{
+    wait();
+}
+
+void DocumentBackup::setFilename(const fs::path &filename)
+{
+    myFilename = filename;
+
+    if (myGeneration >= 0)
+    {
+        fs::ofstream file(getFilenamePath(myDirectory));
+        file << myFilename.string();
+    }
+}
+
+void DocumentBackup::recordChange(const Score &score, int system_index)
+{
+    // The first snapshot includes the change.
+    if (myGeneration < 0)
+    {
+        backup(score);
+        return;
+    }
+
+    myHasChanges = true;
+
+    // The pending snapshot will include the change.
+    if (mySnapshotPending)
+    {
+        backup(score);
+        return;
+    }
+
+    // Append an entry to the journal, prefixed by its size.
+    ScoreUtils::BinaryOutputArchive ar(FileVersion::LATEST_VERSION);
+    ar("system_index", system_index);
+    if (system_index >= 0)
+        ar.writeObject(score.getSystems()[system_index]);
+
+    const uint32_t size = static_cast<uint32_t>(ar.data().size());
+    for (int i = 0; i < 4; ++i)
+        myJournal.put(static_cast<char>((size >> (8 * i)) & 0xff));
+    myJournal.write(ar.data().data(), ar.data().size());
+    myJournal.flush();
+
+    // A change to all systems (e.g. inserting a system) cannot be replayed
+    // from the journal, so take a new snapshot that includes it. Until that
+    // snapshot has been written, the entry above stops recovery from
+    // replaying any later journals onto the previous snapshot. If a snapshot
+    // is still being written, the new one is started later rather than
+    // blocking the calling thread.
+    if (system_index < 0)
+    {
+        mySnapshotPending = true;
+        backup(score);
+    }
+}
+
+bool DocumentBackup::hasChanges() const
+{
+    return myHasChanges;
+}
+
+bool DocumentBackup::isSnapshotPending() const
+{
+    return mySnapshotPending;
+}
+
+bool DocumentBackup::backup(const Score &score)
+{
+    if (myTask.valid())
+    {
+        if (myTask.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready)
+        {
+            return false;
+        }
+
+        myTask.get();
+    }
+
+    const bool first_snapshot = myGeneration < 0;
+    if (first_snapshot)
+        fs::create_directories(myDirectory);
+
+    // The snapshot shares the score's systems, and any systems that are
+    // modified later are copied first.
+    auto snapshot = std::make_shared<Score>(score);
+    const int generation = ++myGeneration;
+    myHasChanges = false;
+    mySnapshotPending = false;
+
+    // Start a new journal for the changes after this snapshot.
+    myJournal.close();
+    myJournal.open(getJournalPath(myDirectory, myGeneration),
+                   std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (first_snapshot && !myFilename.empty())
+        setFilename(myFilename);
+
+    myTask = std::async(std::launch::async, [=]() {
+        writeSnapshot(generation, *snapshot);
+    });
+
+    return true;
+}
+
+void DocumentBackup::wait()
+{
+    if (myTask.valid())
+        myTask.wait();
+}
+
+void DocumentBackup::discard()
+{
+    wait();
+    myTask = std::future<void>();
+    myJournal.close();
+
+    boost::system::error_code ec;
+    fs::remove_all(myDirectory, ec);
+
+    myGeneration = -1;
+    myHasChanges = false;
+    mySnapshotPending = false;
+}
+
+void DocumentBackup::writeSnapshot(int generation, const Score &score)
+{
+    // Write the snapshot. If this fails, the previous snapshot and journal are
+    // still available for recovery.
+    try
+    {
+        const fs::path path = getBackupPath(myDirectory, generation);
+        fs::path temp_path = path;
+        temp_path += ".tmp";
+
+        {
+            fs::ofstream file(temp_path, std::ios::out | std::ios::binary);
+            PowerTab::Chunked::save(file, score);
+
+            file.flush();
+            if (!file)
+                return;
+        }
+
+        fs::rename(temp_path, path);
+    }
+    catch (const std::exception &)
+    {
+        return;
+    }
+
+    // Remove the older snapshots and journals, which are no longer needed.
+    boost::system::error_code ec;
+    for (fs::directory_iterator it(myDirectory, ec), end; !ec && it != end;
+         it.increment(ec))
+    {
+        const fs::path &file = it->path();
+        const int file_generation =
+            std::max(getGeneration(file, "backup-", ".pt2"),
+                     getGeneration(file, "journal-", ".log"));
+
+        if (file_generation >= 0 && file_generation < generation)
+            fs::remove(file, ec);
+    }
+}
+
+/// Replays the entries in the journal file.
+/// @return False if replaying should stop.
+static bool replayJournal(const fs::path &path, Score &score)
+{
+    fs::ifstream file(path, std::ios::in | std::ios::binary);
+    const std::string data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+
+    size_t offset = 0;
+    while (offset < data.size())
+    {
+        // Stop at an incomplete entry (e.g. if the program crashed while
+        // writing it).
+        if (data.size() - offset < 4)
+            return false;
+
+        uint32_t size = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            size |= static_cast<uint32_t>(
+                        static_cast<uint8_t>(data[offset + i]))
+                    << (8 * i);
+        }
+        offset += 4;
+
+        if (data.size() - offset < size)
+            return false;
+
+        const char *begin = data.data() + offset;
+        ScoreUtils::BinaryInputArchive ar(begin, begin + size,
+                                          FileVersion::LATEST_VERSION);
+        offset += size;
+
+        int system_index = -1;
+        ar("system_index", system_index);
+        if (system_index < 0 ||
+            system_index >= static_cast<int>(score.getSystems().size()))
+        {
+            return false;
+        }
+
+        ar.readObject(score.getSystems()[system_index]);
+    }
+
+    return true;
+}
+
+bool DocumentBackup::recover(const fs::path &dir, Score &score,
+                             fs::path &filename)
+{
+    int generation = -1;
+
+    boost::system::error_code ec;
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end;
+         it.increment(ec))
+    {
+        generation = std::max(generation,
+                              getGeneration(it->path(), "backup-", ".pt2"));
+    }
+
+    if (generation < 0)
+        return false;
+
+    {
+        fs::ifstream file(getBackupPath(dir, generation),
+                          std::ios::in | std::ios::binary);
+        PowerTab::Chunked::load(file, score);
+    }
+
+    // Journals after the most recent snapshot may exist if later snapshots
+    // were not finished being written.
+    for (int i = generation; fs::exists(getJournalPath(dir, i)); ++i)
+    {
+        if (!replayJournal(getJournalPath(dir, i), score))
+            break;
+    }
+
+    filename.clear();
+    if (fs::exists(getFilenamePath(dir)))
+    {
+        fs::ifstream file(getFilenamePath(dir));
+        std::string name;
+        std::getline(file, name);
+        filename = name;
+    }
+
+    return true;
+}
@@ -0,0 +1,102 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef APP_DOCUMENTBACKUP_H
+#define APP_DOCUMENTBACKUP_H
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/path.hpp>
+#include <future>
+#include <memory>
+#include <score/score.h>
+
+/// Keeps a backup of an open document so that unsaved changes can be
+/// recovered after a crash.
+///
+/// The backup consists of a snapshot of the score, which is written to disk on
+/// a background thread, and a journal of the systems that were modified after
+/// the snapshot was taken. Copying the score shares its systems rather than
+/// copying them, so the calling thread is not blocked for long.
+///
+/// Files in the backup directory:
+///   - backup-N.pt2: the Nth snapshot (a chunked Power Tab file).
+///   - journal-N.log: the changes after the Nth snapshot. Each entry records
+///     the index of the modified system and its new contents, or -1 if the
+///     change affected all systems (e.g. a system was inserted).
+///   - filename.txt: the path to the document's file, if there is one.
+class DocumentBackup
+{
+public:
+    explicit DocumentBackup(const boost::filesystem::path &dir);
+    DocumentBackup(const DocumentBackup &) = delete;
+    DocumentBackup &operator=(const DocumentBackup &) = delete;
+    ~DocumentBackup();
+
+    /// Sets the path to the document's file, which is recorded in the backup.
+    void setFilename(const boost::filesystem::path &filename);
+
+    /// Records that a system was modified, and appends the system's new
+    /// contents to the journal. If the index is -1 (all systems were
+    /// modified), a new snapshot is needed instead. It is started immediately
+    /// if no snapshot is being written, and otherwise by the next call to
+    /// recordChange() or backup() after the current snapshot is finished.
+    void recordChange(const Score &score, int system_index);
+
+    /// Returns whether there are changes since the last snapshot.
+    bool hasChanges() const;
+    /// Returns whether a change to all systems is waiting for a new snapshot.
+    bool isSnapshotPending() const;
+
+    /// Takes a new snapshot of the score, which is written to disk in the
+    /// background. Returns false if the previous snapshot is still being
+    /// written, in which case the changes will be included in the next
+    /// snapshot.
+    bool backup(const Score &score);
+
+    /// Waits until the most recent snapshot has been written.
+    void wait();
+
+    /// Removes the backup files, e.g. after the document is saved.
+    void discard();
+
+    /// Restores a score from the most recent snapshot in the directory and
+    /// replays the journal. Replaying stops at the first change that affected
+    /// all systems, since the systems may have been rearranged (this only
+    /// happens if the snapshot for that change was not finished).
+    /// @return False if there is no backup to recover.
+    static bool recover(const boost::filesystem::path &dir, Score &score,
+                        boost::filesystem::path &filename);
+
+private:
+    /// Writes the snapshot to disk.
+    void writeSnapshot(int generation, const Score &score);
+
+    const boost::filesystem::path myDirectory;
+    boost::filesystem::path myFilename;
+
+    /// The generation of the most recent snapshot, or -1.
+    int myGeneration;
+    bool myHasChanges;
+    /// Whether a change to all systems has not been included in a snapshot
+    /// yet. Until then, the journal cannot be replayed past that change, so
+    /// later changes are not journaled.
+    bool mySnapshotPending;
+    boost::filesystem::ofstream myJournal;
+    std::future<void> myTask;
+};
+
+#endif
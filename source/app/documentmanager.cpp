@@ -19,6 +19,8 @@
 
 #include <app/settings.h>
 #include <app/settingsmanager.h>
+#include <midi/midieventcache.h>
+#include <midi/playbacktimeline.h>
 
 DocumentManager::DocumentManager()
 {
@@ -137,7 +139,9 @@ int DocumentManager::findDocument(const Document::PathType &filepath)
 }
 
 Document::Document()
-    : myCaret(myScore, myViewOptions)
+    : myCaret(myScore, myViewOptions),
+      myPlaybackTimeline(std::make_shared<PlaybackTimeline>()),
+      myMidiEventCache(std::make_shared<MidiEventCache>())
 {
 }
 
@@ -186,3 +190,13 @@ Caret &Document::getCaret()
 {
     return myCaret;
 }
+
+const std::shared_ptr<PlaybackTimeline> &Document::getPlaybackTimeline() const
+{
+    return myPlaybackTimeline;
+}
+
+const std::shared_ptr<MidiEventCache> &Document::getMidiEventCache() const
+{
+    return myMidiEventCache;
+}
@@ -26,6 +26,8 @@
 #include <score/score.h>
 #include <vector>
 
+class MidiEventCache;
+class PlaybackTimeline;
 class SettingsManager;
 
 /// A document is a score that is either associated with a file or unsaved.
@@ -54,11 +56,21 @@ public:
     const Caret &getCaret() const;
     Caret &getCaret();
 
+    /// Returns the playback state at each bar, which is recorded during
+    /// playback and invalidated when the score is modified.
+    const std::shared_ptr<PlaybackTimeline> &getPlaybackTimeline() const;
+
+    /// Returns the MIDI events for each bar, which are recorded during
+    /// playback and invalidated when the score is modified.
+    const std::shared_ptr<MidiEventCache> &getMidiEventCache() const;
+
 private:
     boost::optional<PathType> myFilename;
     Score myScore;
     ViewOptions myViewOptions;
     Caret myCaret;
+    std::shared_ptr<PlaybackTimeline> myPlaybackTimeline;
+    std::shared_ptr<MidiEventCache> myMidiEventCache;
 };
 
 /// Class for managing open documents.
@@ -76,6 +76,7 @@
 #include <app/caret.h>
 #include <app/clipboard.h>
 #include <app/command.h>
+#include <app/documentbackup.h>
 #include <app/documentmanager.h>
 #include <app/paths.h>
 #include <app/pubsub/clickpubsub.h>
@@ -88,6 +89,8 @@
 #include <audio/midiplayer.h>
 #include <audio/settings.h>
 
+#include <algorithm>
+#include <boost/filesystem/operations.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/range/algorithm/transform.hpp>
 #include <chrono>
@@ -117,10 +120,14 @@
 #include <dialogs/timesignaturedialog.h>
 #include <dialogs/trilldialog.h>
 #include <dialogs/tuningdictionarydialog.h>
+#include <dialogs/undostatsdialog.h>
 #include <dialogs/viewfilterdialog.h>
 
 #include <formats/fileformatmanager.h>
 
+#include <midi/midieventcache.h>
+#include <midi/playbacktimeline.h>
+
 #include <QCoreApplication>
 #include <QDebug>
 #include <QDesktopServices>
@@ -128,6 +135,7 @@
 #include <QFileDialog>
 #include <QFontDatabase>
 #include <QKeyEvent>
+#include <QLockFile>
 #include <QMenuBar>
 #include <QMessageBox>
 #include <QMimeData>
@@ -136,6 +144,7 @@
 #include <QPrintPreviewDialog>
 #include <QScrollArea>
 #include <QTabBar>
+#include <QTimer>
 #include <QUrl>
 #include <QVBoxLayout>
 
@@ -162,7 +171,8 @@ PowerTabEditor::PowerTabEditor()
       myInstrumentPanel(nullptr),
       myInstrumentDockWidget(nullptr),
       myPlaybackWidget(nullptr),
-      myPlaybackArea(nullptr)
+      myPlaybackArea(nullptr),
+      myAutosaveTimer(nullptr)
 {
     this->setWindowIcon(QIcon(":icons/app_icon.png"));
 
@@ -180,10 +190,20 @@ PowerTabEditor::PowerTabEditor()
             SLOT(redrawScore()));
     connect(myUndoManager.get(), SIGNAL(cleanChanged(bool)), this,
             SLOT(updateModified(bool)));
+    connect(myUndoManager.get(), SIGNAL(systemsModified(int)), this,
+            SLOT(backupChange(int)));
 
     myTuningDictionary->loadInBackground();
     mySettingsManager->load(Paths::getConfigDir());
 
+    {
+        auto settings = mySettingsManager->getReadHandle();
+        const int budget_mb =
+            std::max(0, settings->get(Settings::UndoMemoryBudget));
+        myUndoManager->setMemoryBudget(static_cast<size_t>(budget_mb) * 1024 *
+                                       1024);
+    }
+
     createMixer();
     createInstrumentPanel();
     createCommands();
@@ -209,10 +229,127 @@ PowerTabEditor::PowerTabEditor()
     setMinimumSize(800, 600);
     setWindowState(Qt::WindowMaximized);
     setWindowTitle(getApplicationName());
+
+    // Set up a directory for backing up the documents in this session. The
+    // lock file allows other instances to tell that the backups are not from
+    // a session that crashed.
+    myBackupDir = Paths::getUserDataDir() / "backups" /
+                  boost::filesystem::unique_path();
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(myBackupDir, ec);
+    myBackupLock.reset(
+        new QLockFile(Paths::toQString(myBackupDir / "lock")));
+    myBackupLock->setStaleLockTime(0);
+    if (!myBackupLock->tryLock())
+        qDebug() << "Could not lock the backup directory";
+
+    myAutosaveTimer = new QTimer(this);
+    connect(myAutosaveTimer, SIGNAL(timeout()), this, SLOT(autosave()));
+
+    const int autosave_interval = settings->get(Settings::AutosaveInterval);
+    if (autosave_interval > 0)
+        myAutosaveTimer->start(autosave_interval * 1000);
 }
 
 PowerTabEditor::~PowerTabEditor()
 {
+    // The backups are not needed after exiting normally.
+    myBackups.clear();
+    myBackupLock.reset();
+
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(myBackupDir, ec);
+}
+
+void PowerTabEditor::recoverBackups()
+{
+    const boost::filesystem::path backups_dir =
+        Paths::getUserDataDir() / "backups";
+
+    // Find the backups from other sessions that are no longer running.
+    std::vector<std::pair<boost::filesystem::path,
+                          std::unique_ptr<QLockFile>>> sessions;
+
+    boost::system::error_code ec;
+    for (boost::filesystem::directory_iterator it(backups_dir, ec), end;
+         !ec && it != end; it.increment(ec))
+    {
+        const boost::filesystem::path &dir = it->path();
+        if (dir == myBackupDir || !boost::filesystem::is_directory(dir))
+            continue;
+
+        std::unique_ptr<QLockFile> lock(
+            new QLockFile(Paths::toQString(dir / "lock")));
+        lock->setStaleLockTime(0);
+        if (lock->tryLock())
+            sessions.emplace_back(dir, std::move(lock));
+    }
+
+    if (sessions.empty())
+        return;
+
+    const bool recover =
+        QMessageBox::question(
+            this, tr("Recover Documents"),
+            tr("%1 did not exit normally. Do you want to recover any "
+               "unsaved changes?")
+                .arg(getApplicationName())) == QMessageBox::Yes;
+
+    for (auto &session : sessions)
+    {
+        if (recover)
+        {
+            for (boost::filesystem::directory_iterator it(session.first, ec),
+                 end;
+                 !ec && it != end; it.increment(ec))
+            {
+                if (!boost::filesystem::is_directory(it->path()))
+                    continue;
+
+                Document &doc = myDocumentManager->addDocument();
+
+                try
+                {
+                    boost::filesystem::path filename;
+                    if (!DocumentBackup::recover(it->path(), doc.getScore(),
+                                                 filename))
+                    {
+                        myDocumentManager->removeDocument(
+                            myDocumentManager->getCurrentDocumentIndex());
+                        continue;
+                    }
+
+                    // The recovered document is left untitled so that it
+                    // isn't accidentally saved over the original file.
+                    if (!filename.empty())
+                    {
+                        qDebug() << "Recovered changes to"
+                                 << Paths::toQString(filename);
+                    }
+
+                    setupNewTab();
+                    setWindowModified(true);
+
+                    // Keep a backup of the recovered document until it is
+                    // saved.
+                    backupChange(UndoManager::AFFECTS_ALL_SYSTEMS);
+                }
+                catch (const std::exception &e)
+                {
+                    myDocumentManager->removeDocument(
+                        myDocumentManager->getCurrentDocumentIndex());
+
+                    QMessageBox::warning(
+                        this, tr("Error Recovering Document"),
+                        tr("Error recovering document: %1")
+                            .arg(QString(e.what())));
+                }
+            }
+        }
+
+        session.second->unlock();
+        boost::filesystem::remove_all(session.first, ec);
+    }
 }
 
 void PowerTabEditor::openFiles(const QStringList &files)
@@ -338,6 +475,7 @@ bool PowerTabEditor::closeTab(int index)
     if (myDocumentManager->getDocument(index).getCaret().isInPlaybackMode())
         startStopPlayback();
 
+    discardBackup(myDocumentManager->getDocument(index));
     myUndoManager->removeStack(index);
     myDocumentManager->removeDocument(index);
     delete myTabWidget->widget(index);
@@ -390,7 +528,20 @@ bool PowerTabEditor::saveFile(QString path)
 
     try
     {
-        myFileFormatManager->exportFile(doc.getScore(), path_str, *format);
+        // When saving over the document's file, only the systems that were
+        // modified since the file was last saved or opened need to be
+        // written.
+        boost::optional<std::vector<int>> modified_systems =
+            myUndoManager->getModifiedSystems();
+
+        if (modified_systems && doc.hasFilename() &&
+            doc.getFilename() == path_str)
+        {
+            myFileFormatManager->exportChanges(doc.getScore(), path_str,
+                                               *format, *modified_systems);
+        }
+        else
+            myFileFormatManager->exportFile(doc.getScore(), path_str, *format);
     }
     catch (const std::exception &e)
     {
@@ -417,11 +568,22 @@ bool PowerTabEditor::saveFile(QString path)
 
         // Mark the file as being in an unmodified state.
         myUndoManager->setClean();
+        discardBackup(doc);
     }
 
     return true;
 }
 
+void PowerTabEditor::discardBackup(const Document &doc)
+{
+    auto it = myBackups.find(&doc);
+    if (it != myBackups.end())
+    {
+        it->second->discard();
+        myBackups.erase(it);
+    }
+}
+
 bool PowerTabEditor::saveFileAs()
 {
     const QString filter =
@@ -587,10 +749,11 @@ void PowerTabEditor::startStopPlayback(bool from_measure_start)
         myPlaybackWidget->setPlaybackMode(true);
         enableEditing(false);
 
-        const ScoreLocation &location = getLocation();
-        myMidiPlayer.reset(
-            new MidiPlayer(*mySettingsManager, location,
-                           myPlaybackWidget->getPlaybackSpeed()));
+        const Document &doc = myDocumentManager->getCurrentDocument();
+        myMidiPlayer.reset(new MidiPlayer(
+            *mySettingsManager, getLocation(),
+            myPlaybackWidget->getPlaybackSpeed(), doc.getPlaybackTimeline(),
+            doc.getMidiEventCache()));
 
         connect(myMidiPlayer.get(), SIGNAL(playbackSystemChanged(int)), this,
                 SLOT(moveCaretToSystem(int)));
@@ -628,6 +791,10 @@ void PowerTabEditor::startStopPlayback(bool from_measure_start)
 
 void PowerTabEditor::redrawSystem(int index)
 {
+    const Document &doc = myDocumentManager->getCurrentDocument();
+    doc.getPlaybackTimeline()->invalidateSystem(index);
+    doc.getMidiEventCache()->invalidateSystem(index);
+
     getCaret().moveToValidPosition();
     getScoreArea()->redrawSystem(index);
     updateCommands();
@@ -636,6 +803,8 @@ void PowerTabEditor::redrawSystem(int index)
 void PowerTabEditor::redrawScore()
 {
     Document &doc = myDocumentManager->getCurrentDocument();
+    doc.getPlaybackTimeline()->clear();
+    doc.getMidiEventCache()->clear();
     doc.validateViewOptions();
     getCaret().moveToValidPosition();
     getScoreArea()->renderDocument(doc);
@@ -646,6 +815,48 @@ void PowerTabEditor::redrawScore()
     myPlaybackWidget->reset(doc);
 }
 
+void PowerTabEditor::backupChange(int affectedSystem)
+{
+    const Document &doc = myDocumentManager->getCurrentDocument();
+
+    try
+    {
+        std::unique_ptr<DocumentBackup> &backup = myBackups[&doc];
+        if (!backup)
+        {
+            backup.reset(new DocumentBackup(
+                myBackupDir / boost::filesystem::unique_path()));
+
+            if (doc.hasFilename())
+                backup->setFilename(doc.getFilename());
+        }
+
+        backup->recordChange(doc.getScore(), affectedSystem);
+    }
+    catch (const std::exception &e)
+    {
+        qDebug() << "Error backing up document:" << e.what();
+    }
+}
+
+void PowerTabEditor::autosave()
+{
+    for (auto &backup : myBackups)
+    {
+        if (!backup.second->hasChanges())
+            continue;
+
+        try
+        {
+            backup.second->backup(backup.first->getScore());
+        }
+        catch (const std::exception &e)
+        {
+            qDebug() << "Error backing up document:" << e.what();
+        }
+    }
+}
+
 void PowerTabEditor::moveCaretToStart()
 {
     getCaret().moveToStartPosition();
@@ -2500,6 +2711,14 @@ void PowerTabEditor::createCommands()
         QDesktopServices::openUrl(QUrl(AppInfo::BUG_TRACKER_URL));
     });
 
+    myUndoStatsCommand = new Command(tr("Undo History Statistics..."),
+                                     "Help.UndoStatistics", QKeySequence(),
+                                     this);
+    connect(myUndoStatsCommand, &QAction::triggered, [=]() {
+        auto dialog = new UndoStatsDialog(this, *myUndoManager);
+        dialog->show();
+    });
+
     myMixerDockWidgetCommand =
         createCommandWrapper(myMixerDockWidget->toggleViewAction(),
                              "Window.Mixer", QKeySequence(), this);
@@ -2875,6 +3094,8 @@ void PowerTabEditor::createMenus()
     // Help menu.
     myHelpMenu = menuBar()->addMenu(tr("&Help"));
     myHelpMenu->addAction(myReportBugCommand);
+    myHelpMenu->addSeparator();
+    myHelpMenu->addAction(myUndoStatsCommand);
 }
 
 void PowerTabEditor::createTabArea()
@@ -2979,7 +3200,7 @@ void PowerTabEditor::setupNewTab()
         }
     });
 
-    myUndoManager->addNewUndoStack();
+    myUndoManager->addNewUndoStack(doc.getScore());
 
     QString filename = "Untitled";
     if (doc.hasFilename())
@@ -3046,7 +3267,7 @@ void PowerTabEditor::updateCommands()
     if (myIsPlaying)
         return;
 
-    ScoreLocation location = getLocation();
+    const ScoreLocation &location = getLocation();
     const Score &score = location.getScore();
     if (score.getSystems().empty())
         return;
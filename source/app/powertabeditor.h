@@ -22,6 +22,8 @@
 
 #include <app/pubsub/instrumentpubsub.h>
 #include <app/pubsub/playerpubsub.h>
+#include <boost/filesystem/path.hpp>
+#include <map>
 #include <memory>
 #include <score/position.h>
 #include <string>
@@ -29,6 +31,8 @@
 
 class Caret;
 class Command;
+class Document;
+class DocumentBackup;
 class DocumentManager;
 class FileFormatManager;
 class InstrumentPanel;
@@ -36,6 +40,8 @@ class MidiPlayer;
 class Mixer;
 class PlaybackWidget;
 class QActionGroup;
+class QLockFile;
+class QTimer;
 class RecentFiles;
 class ScoreArea;
 class ScoreLocation;
@@ -54,6 +60,10 @@ public:
     /// Opens the given list of files.
     void openFiles(const QStringList &files);
 
+    /// Offers to recover any documents from a previous session that did not
+    /// exit normally.
+    void recoverBackups();
+
 private slots:
     /// Creates a new (blank) document.
     void createNewDocument();
@@ -124,6 +134,11 @@ private slots:
     /// Redraws the entire score.
     void redrawScore();
 
+    /// Records a change to the active document in its backup.
+    void backupChange(int affectedSystem);
+    /// Writes a snapshot of each modified document to its backup.
+    void autosave();
+
     /// Moves the caret to the first position in the staff.
     void moveCaretToStart();
     /// Moves the caret to the right by one position.
@@ -351,6 +366,8 @@ private:
     /// Saves the current document to the specified path.
     /// @return True if the file was successfully saved.
     bool saveFile(QString path);
+    /// Removes the backup for the document, e.g. after it has been saved.
+    void discardBackup(const Document &doc);
 
     /// Adds or removes a rest at the current location.
     void editRest(Position::DurationType duration);
@@ -411,6 +428,14 @@ private:
     PlaybackWidget *myPlaybackWidget;
     QWidget *myPlaybackArea;
 
+    /// Backups of the modified documents, for recovering from a crash.
+    std::map<const Document *, std::unique_ptr<DocumentBackup>> myBackups;
+    /// The directory containing this session's backups.
+    boost::filesystem::path myBackupDir;
+    /// Marks the backup directory as being in use by this session.
+    std::unique_ptr<QLockFile> myBackupLock;
+    QTimer *myAutosaveTimer;
+
     QMenu *myFileMenu;
     Command *myNewDocumentCommand;
     Command *myOpenFileCommand;
@@ -587,6 +612,7 @@ private:
 
     QMenu *myHelpMenu;
     Command *myReportBugCommand;
+    Command *myUndoStatsCommand;
 
 #if 0
 
@@ -17,19 +17,25 @@
   
 #include "scorearea.h"
 
+#include <algorithm>
 #include <app/documentmanager.h>
 #include <app/pubsub/clickpubsub.h>
 #include <chrono>
-#include <future>
+#include <cmath>
 #include <painters/caretpainter.h>
+#include <painters/layoutinfo.h>
 #include <painters/scoreinforenderer.h>
 #include <painters/systemrenderer.h>
 #include <QDebug>
 #include <QGraphicsItem>
 #include <QGraphicsSceneDragDropEvent>
+#include <QPainter>
+#include <QPaintEvent>
 #include <QPrinter>
 #include <QScrollBar>
+#include <QStyleOptionGraphicsItem>
 #include <score/score.h>
+#include <util/parallel.h>
 
 static const double SYSTEM_SPACING = 50;
 
@@ -41,6 +47,10 @@ void ScoreArea::Scene::dragEnterEvent(QGraphicsSceneDragDropEvent *event)
 ScoreArea::ScoreArea(QWidget *parent)
     : QGraphicsView(parent),
       myScoreInfoBlock(nullptr),
+      mySystemsTop(0),
+      myFirstRenderedSystem(0),
+      myLastRenderedSystem(0),
+      myIsUpdatingSystems(false),
       myCaretPainter(nullptr),
       myClickPubSub(std::make_shared<ClickPubSub>())
 {
@@ -51,6 +61,10 @@ void ScoreArea::renderDocument(const Document &document)
 {
     myScene.clear();
     myRenderedSystems.clear();
+    myRenderedSnapshots.clear();
+    mySystemTiles.clear();
+    mySystemHeights = Util::FenwickTree<double>();
+    myFirstRenderedSystem = myLastRenderedSystem = 0;
     myDocument = document;
 
     const Score &score = document.getScore();
@@ -62,57 +76,55 @@ void ScoreArea::renderDocument(const Document &document)
     myCaretPainter->subscribeToMovement([=]() {
         adjustScroll();
     });
+    myCaretPainter->setSystemRectFunction([=](int index) {
+        return getSystemRect(index);
+    });
 
     myScoreInfoBlock = ScoreInfoRenderer::render(score.getScoreInfo());
 
-    myRenderedSystems.reserve(score.getSystems().size());
-    for (unsigned int i = 0; i < score.getSystems().size(); ++i)
-        myRenderedSystems.append(nullptr);
-
-#if 0
-    const int num_threads = std::thread::hardware_concurrency();
-#else
-    const int num_threads = 1;
-#endif
-    std::vector<std::future<void>> tasks;
-    const int work_size = myRenderedSystems.size() / num_threads;
-    qDebug() << "Using" << num_threads << "worker thread(s)";
-
-    for (int i = 0; i < num_threads; ++i)
+    // Computing the layout of a system is the expensive part of rendering,
+    // and requires the system to be loaded. The heights therefore start out
+    // as estimates, and are refined once each system is rendered.
+    const ViewOptions &view_options = document.getViewOptions();
+    const int num_systems = static_cast<int>(score.getSystems().size());
+    std::vector<double> heights(num_systems);
+    double estimate = 0;
+    for (int i = 0; i < num_systems; ++i)
     {
-        const int left = i * work_size;
-        const int right = (i == num_threads - 1) ? myRenderedSystems.size()
-                                                 : (i + 1) * work_size;
-
-        tasks.push_back(std::async(std::launch::async, [&](int left, int right)
+        // A system that has not been loaded is assumed to be similar to the
+        // previous system.
+        if (i == 0 || score.isSystemLoaded(i))
         {
-            for (int i = left; i < right; ++i)
-            {
-                SystemRenderer render(this, score, document.getViewOptions());
-                myRenderedSystems[i] = render(score.getSystems()[i], i);
-            }
-        }, left, right));
+            estimate = SystemRenderer::estimateSystemHeight(
+                score, score.getSystems()[i], i, view_options);
+        }
+
+        heights[i] = estimate + SYSTEM_SPACING;
     }
 
-    for (auto &&task : tasks)
-        task.get();
+    auto layout_end = std::chrono::high_resolution_clock::now();
+    qDebug() << "System heights estimated in"
+             << std::chrono::duration_cast<std::chrono::milliseconds>(
+                    layout_end - start).count() << "ms";
 
-    double height = 0;
     // Score info.
     myScene.addItem(myScoreInfoBlock);
-    height += myScoreInfoBlock->boundingRect().height() + 0.5 * SYSTEM_SPACING;
+    mySystemsTop =
+        myScoreInfoBlock->boundingRect().height() + 0.5 * SYSTEM_SPACING;
 
     // Layout the systems.
-    for (QGraphicsItem *system : myRenderedSystems)
-    {
-        system->setPos(0, height);
-        myScene.addItem(system);
-        height += system->boundingRect().height() + SYSTEM_SPACING;
+    mySystemHeights = Util::FenwickTree<double>(std::move(heights));
 
-        myCaretPainter->addSystemRect(system->sceneBoundingRect());
+    for (int i = 0; i < num_systems; ++i)
+    {
+        myRenderedSystems.append(nullptr);
+        myRenderedSnapshots.push_back(nullptr);
+        mySystemTiles.push_back(SystemTiles());
     }
 
     myScene.addItem(myCaretPainter);
+    updateSceneRect();
+    updateVisibleSystems();
 
     auto end = std::chrono::high_resolution_clock::now();
     qDebug() << "Score rendered in"
@@ -123,39 +135,336 @@ void ScoreArea::renderDocument(const Document &document)
 
 void ScoreArea::redrawSystem(int index)
 {
-    // Delete and remove the system from the scene.
-    delete myRenderedSystems.takeAt(index);
+    const bool visible = myRenderedSystems[index] != nullptr;
+    releaseSystem(index);
+
+    // Rendering the system also updates its height. Otherwise, the height is
+    // estimated until the system becomes visible.
+    if (visible)
+        renderSystem(index);
+    else
+    {
+        const Score &score = myDocument->getScore();
+        setSystemHeight(index, SystemRenderer::estimateSystemHeight(
+                                   score, score.getSystems()[index], index,
+                                   myDocument->getViewOptions()));
+    }
+
+    updateVisibleSystems();
+
+    // The spacing may have changed, so update the caret's position and redraw
+    // it.
+    myCaretPainter->updatePosition();
+}
+
+QRectF ScoreArea::getSystemRect(int index) const
+{
+    return QRectF(0, mySystemsTop + mySystemHeights.prefixSum(index),
+                  LayoutInfo::STAFF_WIDTH,
+                  mySystemHeights.get(index) - SYSTEM_SPACING);
+}
+
+void ScoreArea::setSystemHeight(int index, double height)
+{
+    // If the height changed, only the following systems which have been
+    // rendered need to be moved.
+    const double delta = height + SYSTEM_SPACING - mySystemHeights.get(index);
+    if (delta == 0)
+        return;
+
+    const double visible_top =
+        mapToScene(viewport()->rect()).boundingRect().top();
+    const bool is_above_viewport = getSystemRect(index).bottom() < visible_top;
+
+    mySystemHeights.set(index, height + SYSTEM_SPACING);
+    updateSystemPositions(index);
+    updateSceneRect();
+
+    // The caret's location is only recomputed when it moves.
+    if (myDocument->getCaret().getLocation().getSystemIndex() > index)
+        myCaretPainter->moveBy(0, delta);
+
+    // Keep the visible part of the score in place when a system above it is
+    // resized.
+    if (is_above_viewport)
+    {
+        QScrollBar *scrollbar = verticalScrollBar();
+        scrollbar->setValue(scrollbar->value() +
+                            static_cast<int>(std::lround(
+                                delta * transform().m22())));
+    }
+}
+
+void ScoreArea::updateSystemPositions(int index)
+{
+    for (int i = std::max(index + 1, myFirstRenderedSystem);
+         i < myLastRenderedSystem; ++i)
+    {
+        if (myRenderedSystems[i])
+            myRenderedSystems[i]->setPos(getSystemRect(i).topLeft());
+    }
+}
+
+void ScoreArea::renderSystem(int index)
+{
+    const Score &score = myDocument->getScore();
+    std::shared_ptr<const System> system = score.getSystemSnapshot(index);
+    const std::vector<LayoutConstPtr> layouts = SystemRenderer::layoutSystem(
+        score, *system, index, myDocument->getViewOptions());
+
+    renderSystem(index, std::move(system), layouts);
+}
+
+void ScoreArea::renderSystem(int index, std::shared_ptr<const System> system,
+                             const std::vector<LayoutConstPtr> &layouts)
+{
+    // The layout is used both to refine the system's estimated height and to
+    // create the items.
+    setSystemHeight(index, SystemRenderer::getSystemHeight(layouts));
 
     const Score &score = myDocument->getScore();
     SystemRenderer render(this, score, myDocument->getViewOptions());
-    QGraphicsItem *newSystem = render(score.getSystems()[index], index);
+    QGraphicsItem *item = render(*system, index, layouts);
+
+    item->setPos(getSystemRect(index).topLeft());
+    myScene.addItem(item);
+
+    myRenderedSystems[index] = item;
+    // Hold onto the system, since the rendered items refer to it.
+    myRenderedSnapshots[index] = std::move(system);
+    mySystemTiles[index].myBounds =
+        item->boundingRect() | item->childrenBoundingRect();
+}
+
+void ScoreArea::releaseSystem(int index)
+{
+    delete myRenderedSystems[index];
+    myRenderedSystems[index] = nullptr;
+    myRenderedSnapshots[index].reset();
+    mySystemTiles[index] = SystemTiles();
+}
+
+void ScoreArea::updateVisibleSystems()
+{
+    // Rendering a system can resize it and scroll the view, which calls this
+    // again.
+    if (!myDocument || myIsUpdatingSystems)
+        return;
+
+    myIsUpdatingSystems = true;
+
+    // Rendering systems refines their heights, which may change the range of
+    // visible systems, so repeat until every visible system is rendered.
+    bool rendered = false;
+    while (renderVisibleSystems())
+        rendered = true;
+
+    myIsUpdatingSystems = false;
+
+    // Systems that were loaded for rendering can be unloaded again, since the
+    // rendered items hold onto their own snapshot.
+    if (rendered)
+        myDocument->getScore().releaseSystems();
+}
+
+bool ScoreArea::renderVisibleSystems()
+{
+    // Keep an extra screen of systems above and below the viewport, so that
+    // they are ready before they scroll into view.
+    QRectF visible_rect = mapToScene(viewport()->rect()).boundingRect();
+    const double margin = visible_rect.height();
+    visible_rect.adjust(0, -margin, 0, margin);
+
+    // Find the range of systems that overlap the visible area.
+    const double top = visible_rect.top() - mySystemsTop;
+    const double bottom = visible_rect.bottom() - mySystemsTop;
+    const int num_systems = static_cast<int>(mySystemHeights.size());
+    const int first_visible =
+        static_cast<int>(mySystemHeights.countPrefix(top));
+    const int last_visible =
+        bottom < 0 ? 0 : std::min(static_cast<int>(
+                                      mySystemHeights.countPrefix(bottom)) + 1,
+                                  num_systems);
+
+    // Only the systems that were previously rendered or are now visible need
+    // to be visited.
+    for (int i = myFirstRenderedSystem; i < myLastRenderedSystem; ++i)
+    {
+        if (i < first_visible || i >= last_visible)
+            releaseSystem(i);
+    }
 
-    double height = 0;
-    if (index > 0)
+    myFirstRenderedSystem = first_visible;
+    myLastRenderedSystem = std::max(first_visible, last_visible);
+
+    std::vector<int> indices;
+    for (int i = first_visible; i < last_visible; ++i)
     {
-        height = myRenderedSystems.at(index - 1)->sceneBoundingRect().bottom() +
-                SYSTEM_SPACING;
+        if (!myRenderedSystems[i])
+            indices.push_back(i);
     }
 
-    newSystem->setPos(0, height);
-    height += newSystem->boundingRect().height() + SYSTEM_SPACING;
-    myCaretPainter->setSystemRect(index, newSystem->sceneBoundingRect());
+    if (indices.empty())
+        return false;
+
+    // Computing the layouts is the expensive part of rendering and doesn't
+    // create any graphics items, so it is split across all of the cores. The
+    // systems are loaded beforehand, since that requires the score's lock.
+    const Score &score = myDocument->getScore();
+    const ViewOptions &view_options = myDocument->getViewOptions();
+    std::vector<std::shared_ptr<const System>> systems;
+    for (int i : indices)
+        systems.push_back(score.getSystemSnapshot(i));
+
+    std::vector<std::vector<LayoutConstPtr>> layouts(indices.size());
+    Util::parallelFor(indices.size(), [&](size_t i) {
+        layouts[i] = SystemRenderer::layoutSystem(score, *systems[i],
+                                                  indices[i], view_options);
+    });
+
+    // The items must be created on the GUI thread.
+    for (size_t i = 0; i < indices.size(); ++i)
+        renderSystem(indices[i], std::move(systems[i]), layouts[i]);
 
-    myScene.addItem(newSystem);
-    myRenderedSystems.insert(index, newSystem);
+    return true;
+}
+
+void ScoreArea::updateSceneRect()
+{
+    QRectF rect = myScoreInfoBlock->boundingRect();
+    const size_t num_systems = mySystemHeights.size();
+    if (num_systems > 0)
+        rect |= getSystemRect(static_cast<int>(num_systems - 1));
 
-    // Shift the following systems.
-    for (int i = index + 1; i < myRenderedSystems.size(); ++i)
+    myScene.setSceneRect(rect);
+}
+
+/// Paints an item and its children in the same order as the scene would.
+static void paintItemTree(QPainter &painter, QGraphicsItem &item)
+{
+    if (!item.isVisible())
+        return;
+
+    auto paintChild = [&](QGraphicsItem *child) {
+        painter.save();
+        painter.setTransform(child->itemTransform(&item), true);
+        paintItemTree(painter, *child);
+        painter.restore();
+    };
+
+    auto isBehindParent = [](const QGraphicsItem *child) {
+        return child->zValue() < 0 ||
+               (child->flags() & QGraphicsItem::ItemStacksBehindParent);
+    };
+
+    // The children are sorted by their stacking order.
+    const QList<QGraphicsItem *> children = item.childItems();
+    for (QGraphicsItem *child : children)
     {
-        QGraphicsItem *system = myRenderedSystems[i];
-        system->setPos(0, height);
-        height += system->boundingRect().height() + SYSTEM_SPACING;
-        myCaretPainter->setSystemRect(i, system->sceneBoundingRect());
+        if (isBehindParent(child))
+            paintChild(child);
     }
 
-    // The spacing may have changed, so update the caret's position and redraw
-    // it.
-    myCaretPainter->updatePosition();
+    if (!(item.flags() & QGraphicsItem::ItemHasNoContents))
+    {
+        QStyleOptionGraphicsItem option;
+        option.exposedRect = item.boundingRect();
+
+        painter.save();
+        painter.setOpacity(item.effectiveOpacity());
+        item.paint(&painter, &option, nullptr);
+        painter.restore();
+    }
+
+    for (QGraphicsItem *child : children)
+    {
+        if (!isBehindParent(child))
+            paintChild(child);
+    }
+}
+
+const QImage &ScoreArea::getSystemTile(int index, double scale,
+                                       double pixel_ratio)
+{
+    SystemTiles &tiles = mySystemTiles[index];
+    const auto key = std::make_pair(scale, pixel_ratio);
+    if (!tiles.myImage.isNull() && tiles.myKey == key)
+        return tiles.myImage;
+
+    // Render at the device's resolution, so that the tile is not upscaled on
+    // high DPI displays.
+    const double device_scale = scale * pixel_ratio;
+    const QRectF &bounds = tiles.myBounds;
+    QImage image(std::ceil(bounds.width() * device_scale),
+                 std::ceil(bounds.height() * device_scale),
+                 QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(pixel_ratio);
+    image.fill(Qt::transparent);
+
+    if (!image.isNull())
+    {
+        QPainter painter(&image);
+        painter.setRenderHints(renderHints());
+        painter.scale(scale, scale);
+        painter.translate(-bounds.topLeft());
+        paintItemTree(painter, *myRenderedSystems[index]);
+    }
+
+    tiles.myKey = key;
+    tiles.myImage = std::move(image);
+    return tiles.myImage;
+}
+
+void ScoreArea::paintEvent(QPaintEvent *event)
+{
+    if (!myDocument)
+    {
+        QGraphicsView::paintEvent(event);
+        return;
+    }
+
+    // Rather than drawing every item in the scene, the rendered systems are
+    // drawn from cached images. The items are still used for handling mouse
+    // events, tooltips, etc.
+    QPainter painter(viewport());
+    painter.setRenderHints(renderHints());
+
+    const QRectF exposed_rect = mapToScene(event->rect()).boundingRect();
+    const double scale = transform().m11();
+    const double pixel_ratio = viewport()->devicePixelRatioF();
+
+    // The score information is small, so it is drawn directly.
+    if (myScoreInfoBlock->sceneBoundingRect().intersects(exposed_rect))
+    {
+        painter.setTransform(myScoreInfoBlock->sceneTransform() *
+                             viewportTransform());
+        paintItemTree(painter, *myScoreInfoBlock);
+    }
+
+    painter.resetTransform();
+    for (int i = myFirstRenderedSystem; i < myLastRenderedSystem; ++i)
+    {
+        const QGraphicsItem *system = myRenderedSystems[i];
+        if (!system)
+            continue;
+
+        const QRectF rect =
+            mySystemTiles[i].myBounds.translated(system->scenePos());
+        if (rect.intersects(exposed_rect))
+            painter.drawImage(mapFromScene(rect.topLeft()),
+                              getSystemTile(i, scale, pixel_ratio));
+    }
+
+    // Draw the caret on top of the systems.
+    if (myCaretPainter->isVisible())
+    {
+        QStyleOptionGraphicsItem option;
+        option.exposedRect = myCaretPainter->boundingRect();
+
+        painter.setTransform(myCaretPainter->sceneTransform() *
+                             viewportTransform());
+        myCaretPainter->paint(&painter, &option, viewport());
+    }
 }
 
 void ScoreArea::print(QPrinter &printer)
@@ -169,13 +478,18 @@ void ScoreArea::print(QPrinter &printer)
     QRectF target_rect(0, 0, painter.device()->width(),
                        painter.device()->height());
 
-    QList<QGraphicsItem*> items;
-    items.append(myScoreInfoBlock);
-    items.append(myRenderedSystems);
-
-    for (int i = 0, n = items.length(); i < n; ++i)
+    for (int i = 0, n = myRenderedSystems.size() + 1; i < n; ++i)
     {
-        const QGraphicsItem *item = items[i];
+        // Systems that are not visible are only rendered while they are
+        // being printed.
+        const int system_index = i - 1;
+        const bool temporary =
+            system_index >= 0 && !myRenderedSystems[system_index];
+        if (temporary)
+            renderSystem(system_index);
+
+        const QGraphicsItem *item =
+            i == 0 ? myScoreInfoBlock : myRenderedSystems[system_index];
 
         const QRectF source_rect = item->sceneBoundingRect();
         const float ratio =
@@ -184,9 +498,10 @@ void ScoreArea::print(QPrinter &printer)
 
         if (i > 0)
         {
-            const QGraphicsItem *prev_item = items[i - 1];
-            const double spacing =
-                source_rect.y() - prev_item->sceneBoundingRect().bottom();
+            const QRectF prev_rect =
+                i == 1 ? myScoreInfoBlock->sceneBoundingRect()
+                       : getSystemRect(system_index - 1);
+            const double spacing = source_rect.y() - prev_rect.bottom();
             target_rect.moveTop(target_rect.y() + spacing * ratio);
         }
 
@@ -204,6 +519,9 @@ void ScoreArea::print(QPrinter &printer)
 
         // Set the location for the next item.
         target_rect.moveTop(target_rect.y() + height);
+
+        if (temporary)
+            releaseSystem(system_index);
     }
 
     myCaretPainter->show();
@@ -238,6 +556,18 @@ void ScoreArea::focusOutEvent(QFocusEvent *)
     myScene.update(myCaretPainter->sceneBoundingRect());
 }
 
+void ScoreArea::resizeEvent(QResizeEvent *event)
+{
+    QGraphicsView::resizeEvent(event);
+    updateVisibleSystems();
+}
+
+void ScoreArea::scrollContentsBy(int dx, int dy)
+{
+    QGraphicsView::scrollContentsBy(dx, dy);
+    updateVisibleSystems();
+}
+
 void ScoreArea::refreshZoom()
 {
     double scale_factor = myDocument->getViewOptions().getZoom() / 100.0;
@@ -245,4 +575,12 @@ void ScoreArea::refreshZoom()
     QTransform xform;
     xform.scale(scale_factor, scale_factor);
     setTransform(xform);
+
+    // Free the images for the previous zoom level now, rather than when each
+    // system is next painted, since systems that are out of view may not be
+    // painted again before they are released.
+    for (SystemTiles &tiles : mySystemTiles)
+        tiles.myImage = QImage();
+
+    updateVisibleSystems();
 }
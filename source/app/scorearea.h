@@ -20,14 +20,20 @@
 
 #include <boost/optional.hpp>
 #include <memory>
+#include <painters/layoutinfo.h>
 #include <QGraphicsScene>
 #include <QGraphicsView>
+#include <QImage>
 #include <score/staff.h>
+#include <util/fenwicktree.h>
+#include <utility>
+#include <vector>
 
 class CaretPainter;
 class ClickPubSub;
 class Document;
 class QPrinter;
+class System;
 
 /// The visual display of the score.
 class ScoreArea : public QGraphicsView
@@ -59,15 +65,78 @@ public:
 protected:
     virtual void focusInEvent(QFocusEvent *event) override;
     virtual void focusOutEvent(QFocusEvent *event) override;
+    virtual void paintEvent(QPaintEvent *event) override;
+    virtual void resizeEvent(QResizeEvent *event) override;
+    virtual void scrollContentsBy(int dx, int dy) override;
 
 private:
     /// Adjusts the scroll location whenever the caret moves.
     void adjustScroll();
 
+    /// Creates the items for systems that are in or near the viewport, and
+    /// releases the items for systems that are no longer visible.
+    void updateVisibleSystems();
+    /// Renders any systems in or near the viewport that have not been
+    /// rendered yet, and releases the systems that are no longer visible.
+    /// @return True if any systems were rendered.
+    bool renderVisibleSystems();
+    /// Creates the items for a system and adds them to the scene.
+    void renderSystem(int index);
+    /// Creates the items for a system from its precomputed layouts.
+    void renderSystem(int index, std::shared_ptr<const System> system,
+                      const std::vector<LayoutConstPtr> &layouts);
+    /// Removes a system's items from the scene.
+    void releaseSystem(int index);
+    /// Returns the location of a system in the scene, which is known without
+    /// rendering the system (although the height may be an estimate).
+    QRectF getSystemRect(int index) const;
+    /// Updates the height of a system, and moves the following systems.
+    void setSystemHeight(int index, double height);
+    /// Moves the rendered systems after the given system to their current
+    /// locations.
+    void updateSystemPositions(int index);
+    /// Resizes the scene to fit all of the systems, including those which
+    /// have not been rendered.
+    void updateSceneRect();
+    /// Returns the rasterized image of a rendered system at the given scale
+    /// and device pixel ratio, creating it if necessary.
+    const QImage &getSystemTile(int index, double scale, double pixel_ratio);
+
+    /// Rasterized image of a rendered system, which is painted instead of the
+    /// system's items.
+    struct SystemTiles
+    {
+        /// The area covered by the image, relative to the system.
+        QRectF myBounds;
+        /// The zoom level and device pixel ratio that the image was drawn at.
+        /// Only the image for the current zoom level is kept, so the cache
+        /// does not grow as the user zooms in and out.
+        std::pair<double, double> myKey;
+        QImage myImage;
+    };
+
     Scene myScene;
     boost::optional<const Document &> myDocument;
     QGraphicsItem *myScoreInfoBlock;
+    /// The items for each system, or null if the system is not visible.
     QList<QGraphicsItem *> myRenderedSystems;
+    /// The systems that the rendered items refer to, which are kept alive if
+    /// the score unloads them.
+    std::vector<std::shared_ptr<const System>> myRenderedSnapshots;
+    /// The height of each system plus the spacing below it. The location of
+    /// a system is found from the prefix sums, so resizing one system does
+    /// not require updating the following systems. The height of a system
+    /// that has not been rendered yet is an estimate.
+    Util::FenwickTree<double> mySystemHeights;
+    /// The location of the first system in the scene.
+    double mySystemsTop;
+    /// The range of systems which currently have items in the scene.
+    int myFirstRenderedSystem;
+    int myLastRenderedSystem;
+    /// Whether the visible systems are currently being rendered.
+    bool myIsUpdatingSystems;
+    /// The cached images for each rendered system.
+    std::vector<SystemTiles> mySystemTiles;
     CaretPainter *myCaretPainter;
 
     std::shared_ptr<ClickPubSub> myClickPubSub;
@@ -33,6 +33,10 @@ const Setting<std::vector<std::string>> RecentFiles("app/recent_files", {});
 const Setting<bool> OpenFilesInNewWindow("app/open_files_in_new_window",
                                          false);
 
+const Setting<int> AutosaveInterval("app/autosave_interval", 60);
+
+const Setting<int> UndoMemoryBudget("app/undo_memory_budget", 128);
+
 const Setting<std::string> DefaultInstrumentName("app/default_instrument_name",
                                                  "Untitled");
 
@@ -30,6 +30,13 @@ namespace Settings
     extern const Setting<QByteArray> WindowState;
     extern const Setting<std::vector<std::string>> RecentFiles;
     extern const Setting<bool> OpenFilesInNewWindow;
+    /// How often (in seconds) to back up modified documents. A value of zero
+    /// disables automatic backups.
+    extern const Setting<int> AutosaveInterval;
+    /// The amount of memory (in megabytes) that the undo history of each
+    /// document may use before older changes are moved to a temporary file.
+    /// A value of zero disables the limit.
+    extern const Setting<int> UndoMemoryBudget;
 
     extern const Setting<std::string> DefaultInstrumentName;
     extern const Setting<int> DefaultInstrumentPreset;
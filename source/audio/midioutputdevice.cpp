@@ -52,10 +52,11 @@ MidiOutputDevice::~MidiOutputDevice()
 }
 
 void
-MidiOutputDevice::sendMessage(const std::vector<uint8_t> &data)
+MidiOutputDevice::sendMessage(const uint8_t *data, size_t size)
 {
-    // FIXME - fix const correctness in RtMidi api.
-    myMidiOut->sendMessage(const_cast<std::vector<uint8_t> *>(&data));
+    // Reuse the buffer rather than allocating a new vector for each message.
+    myMessage.assign(data, data + size);
+    myMidiOut->sendMessage(&myMessage);
 }
 
 bool MidiOutputDevice::sendMidiMessage(unsigned char a, unsigned char b,
@@ -82,13 +82,15 @@ public:
         RpnMsb = 101
     };
 
-    void sendMessage(const std::vector<uint8_t> &data);
+    void sendMessage(const uint8_t *data, size_t size);
 
 private:
     bool sendMidiMessage(unsigned char a, unsigned char b, unsigned char c);
 
     std::vector<std::unique_ptr<RtMidiOut>> myMidiOuts;
     RtMidiOut *myMidiOut;
+    /// Buffer for the message that is being sent.
+    std::vector<uint8_t> myMessage;
     /// Maximum volume for each channel (as set in the mixer).
     std::array<uint8_t, NUM_CHANNELS> myMaxVolumes;
     /// Volume of last active dynamic for each channel.
@@ -19,10 +19,10 @@
 
 #include <app/settingsmanager.h>
 #include <audio/midioutputdevice.h>
+#include <audio/midischeduler.h>
 #include <audio/settings.h>
 #include <boost/rational.hpp>
-#include <cassert>
-#include <midi/midifile.h>
+#include <midi/midistream.h>
 #include <score/generalmidi.h>
 #include <score/score.h>
 
@@ -34,10 +34,14 @@
 static const int METRONOME_CHANNEL = 9;
 
 MidiPlayer::MidiPlayer(SettingsManager &settings_manager,
-                       const ScoreLocation &start_location, int speed)
+                       const ScoreLocation &start_location, int speed,
+                       std::shared_ptr<PlaybackTimeline> timeline,
+                       std::shared_ptr<MidiEventCache> cache)
     : mySettingsManager(settings_manager),
       myScore(start_location.getScore()),
       myStartLocation(start_location),
+      myTimeline(std::move(timeline)),
+      myCache(std::move(cache)),
       myIsPlaying(false),
       myPlaybackSpeed(speed)
 {
@@ -92,22 +96,14 @@ void MidiPlayer::run()
             settings->get(Settings::MidiWideVibratoLevel);
     }
 
-    MidiFile file;
-    file.load(myScore, options);
-
-    const int ticks_per_beat = file.getTicksPerBeat();
-
-    // Merge the MIDI evvents for each track.
-    MidiEventList events;
-    for (MidiEventList &track : file.getTracks())
-    {
-        track.convertToAbsoluteTicks();
-        events.concat(track);
-    }
+    const SystemLocation start_location(myStartLocation.getSystemIndex(),
+                                        myStartLocation.getPositionIndex());
 
-    // TODO - since each track is already sorted, an n-way merge should be faster.
-    std::stable_sort(events.begin(), events.end());
-    events.convertToDeltaTicks();
+    // Generate the events on another thread, one bar at a time, so that
+    // playback can start immediately. The timeline allows the events before
+    // the start location to be skipped if they were previously generated, and
+    // the cache avoids regenerating the bars that were not modified.
+    MidiStream stream(myScore, options, myTimeline, myCache, start_location);
 
     // Initialize RtMidi and set the port.
     MidiOutputDevice device;
@@ -117,72 +113,95 @@ void MidiPlayer::run()
         return;
     }
 
-    bool started = false;
     int beat_duration = Midi::BEAT_DURATION_120_BPM;
-    const SystemLocation start_location(myStartLocation.getSystemIndex(),
-                                        myStartLocation.getPositionIndex());
     SystemLocation current_location = start_location;
 
-    for (auto event = events.begin(); event != events.end(); ++event)
+    // Restore the state of each channel (instrument, volume, etc) from the
+    // bar that the events start from.
+    if (const boost::optional<PlaybackTimeline::Bar> &bar =
+            stream.getStartBar())
     {
-        if (!isPlaying())
-            break;
+        beat_duration = bar->myCheckpoint.myTempo;
 
-        if (event->isTempoChange())
-            beat_duration = event->getTempo();
+        for (const MidiEvent &event : bar->getChannelEvents())
+            device.sendMessage(event.getData().begin(), event.getData().size());
+    }
 
-        // Skip events before the start location, except for events such as
-        // instrument changes. Tempo changes are tracked above.
-        if (!started)
+    // Skip events before the start location, except for events such as
+    // instrument changes. Tempo changes are tracked so that playback starts
+    // with the correct tempo.
+    MidiEventList events;
+    auto first_event = events.end();
+    while (first_event == events.end() && stream.getNextBar(events))
+    {
+        for (first_event = events.begin(); first_event != events.end();
+             ++first_event)
         {
-            if (event->getLocation() < start_location)
-            {
-                if (event->isProgramChange())
-                    device.sendMessage(event->getData());
+            if (!(first_event->getLocation() < start_location))
+                break;
 
-                continue;
-            }
-            else
+            if (first_event->isTempoChange())
+                beat_duration = first_event->getTempo();
+            else if (first_event->isProgramChange())
             {
-                performCountIn(device, event->getLocation(), beat_duration);
-
-                started = true;
+                device.sendMessage(first_event->getData().begin(),
+                                   first_event->getData().size());
             }
         }
+    }
 
-        const int delta = event->getTicks();
-        assert(delta >= 0);
+    if (first_event == events.end())
+        return;
 
-        const int duration_us = boost::rational_cast<int>(
-            boost::rational<int>(delta, ticks_per_beat) * beat_duration);
+    performCountIn(device, first_event->getLocation(), beat_duration);
 
-        usleep(duration_us * (100.0 / myPlaybackSpeed));
+    MidiScheduler scheduler(stream.getTicksPerBeat(), beat_duration);
+    scheduler.start(first_event->getTicks(), MidiScheduler::Clock::now(),
+                    myPlaybackSpeed);
 
-        // Don't play metronome events if the metronome is disabled.
-        if (event->isNoteOnOff() && event->getChannel() == METRONOME_CHANNEL &&
-            !myMetronomeEnabled)
+    auto dispatch = [&](MidiEventList::const_iterator begin,
+                        MidiEventList::const_iterator end) {
+        for (auto event = begin; event != end; ++event)
         {
-            continue;
-        }
+            // Don't play metronome events if the metronome is disabled.
+            if (event->isNoteOnOff() &&
+                event->getChannel() == METRONOME_CHANNEL && !myMetronomeEnabled)
+            {
+                continue;
+            }
 
-        device.sendMessage(event->getData());
+            device.sendMessage(event->getData().begin(),
+                               event->getData().size());
 
-        // Notify listeners of the current playback position.
-        if (event->getLocation() != current_location)
-        {
-            const SystemLocation &new_location = event->getLocation();
+            // Notify listeners of the current playback position.
+            if (event->getLocation() != current_location)
+            {
+                const SystemLocation &new_location = event->getLocation();
 
-            // Don't move backwards unless a repeat occurred.
-            if (new_location < current_location && !event->isPositionChange())
+                // Don't move backwards unless a repeat occurred.
+                if (new_location < current_location &&
+                    !event->isPositionChange())
+                {
                     continue;
+                }
 
-            if (new_location.getSystem() != current_location.getSystem())
-                emit playbackSystemChanged(new_location.getSystem());
+                if (new_location.getSystem() != current_location.getSystem())
+                    emit playbackSystemChanged(new_location.getSystem());
 
-            emit playbackPositionChanged(new_location.getPosition());
+                emit playbackPositionChanged(new_location.getPosition());
 
-            current_location = new_location;
+                current_location = new_location;
+            }
         }
+    };
+
+    scheduler.play(first_event, events.end(), myPlaybackSpeed, myIsPlaying,
+                   dispatch);
+
+    while (isPlaying() && stream.getNextBar(events))
+    {
+        scheduler.play(events.begin(), events.end(), myPlaybackSpeed,
+                       myIsPlaying, dispatch);
     }
 }
 
@@ -19,12 +19,15 @@
 #define AUDIO_MIDIPLAYER_H
 
 #include <atomic>
+#include <memory>
 #include <QThread>
+#include <score/score.h>
 #include <score/scorelocation.h>
 
+class MidiEventCache;
 class MidiFile;
 class MidiOutputDevice;
-class Score;
+class PlaybackTimeline;
 class SettingsManager;
 class SystemLocation;
 
@@ -33,8 +36,14 @@ class MidiPlayer : public QThread
     Q_OBJECT
 
 public:
+    /// @param timeline Records the playback state at each bar, which is
+    ///     reused for later playback of the same score.
+    /// @param cache Records the events for each bar, which are reused for
+    ///     later playback of the same score.
     MidiPlayer(SettingsManager &settings_manager,
-               const ScoreLocation &start_location, int speed);
+               const ScoreLocation &start_location, int speed,
+               std::shared_ptr<PlaybackTimeline> timeline = nullptr,
+               std::shared_ptr<MidiEventCache> cache = nullptr);
     ~MidiPlayer();
 
     void changePlaybackSpeed(int new_speed);
@@ -58,8 +67,13 @@ private:
     bool isPlaying() const;
 
     SettingsManager &mySettingsManager;
-    const Score &myScore;
+    /// A copy of the score from when playback was started. Playback runs on
+    /// a separate thread, so it must not access the score that is being
+    /// edited.
+    const Score myScore;
     ScoreLocation myStartLocation;
+    std::shared_ptr<PlaybackTimeline> myTimeline;
+    std::shared_ptr<MidiEventCache> myCache;
     std::atomic<bool> myIsPlaying;
     std::atomic<bool> myMetronomeEnabled;
     /// The current playback speed (percent).
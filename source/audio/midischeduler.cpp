@@ -0,0 +1,125 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "midischeduler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <thread>
+
+/// The longest time to sleep before checking whether playback was stopped or
+/// the speed was changed.
+static const std::chrono::milliseconds theMaxSleep(10);
+
+MidiScheduler::MidiScheduler(int ticks_per_beat, int beat_duration)
+    : myTicksPerBeat(ticks_per_beat),
+      myBeatDuration(beat_duration),
+      mySpeed(100),
+      myAnchorTick(0),
+      myAnchorTime(Clock::now()),
+      myLastTick(0)
+{
+}
+
+void MidiScheduler::start(int64_t tick, Clock::time_point time, int speed)
+{
+    assert(speed > 0);
+
+    myAnchorTick = tick;
+    myAnchorTime = time;
+    mySpeed = speed;
+    myLastTick = tick;
+}
+
+void MidiScheduler::setBeatDuration(int64_t tick, int beat_duration)
+{
+    myAnchorTime = getDeadline(tick);
+    myAnchorTick = tick;
+    myBeatDuration = beat_duration;
+}
+
+void MidiScheduler::setSpeed(int64_t tick, int speed)
+{
+    assert(speed > 0);
+
+    myAnchorTime = getDeadline(tick);
+    myAnchorTick = tick;
+    mySpeed = speed;
+}
+
+MidiScheduler::Clock::time_point MidiScheduler::getDeadline(int64_t tick) const
+{
+    // Compute the offset from the anchor in one step so that rounding errors
+    // don't accumulate.
+    const std::chrono::duration<double, std::micro> offset(
+        static_cast<double>(tick - myAnchorTick) * myBeatDuration * 100.0 /
+        (static_cast<double>(myTicksPerBeat) * mySpeed));
+
+    return myAnchorTime +
+           std::chrono::duration_cast<Clock::duration>(offset);
+}
+
+void MidiScheduler::play(MidiEventList::const_iterator begin,
+                         MidiEventList::const_iterator end,
+                         const std::atomic<int> &speed,
+                         const std::atomic<bool> &playing,
+                         const Dispatch &dispatch)
+{
+    for (auto batch = begin; batch != end;)
+    {
+        const int64_t event_tick = batch->getTicks();
+        auto batch_end = std::find_if(batch, end, [=](const MidiEvent &event) {
+            return event.getTicks() != event_tick;
+        });
+
+        // Events that are earlier than the previous batch are already due.
+        const int64_t tick = std::max(event_tick, myLastTick);
+
+        // Wait until the events are due, while checking whether playback was
+        // stopped or the speed changed.
+        while (true)
+        {
+            if (!playing)
+                return;
+
+            // A speed change only affects the events after the last batch
+            // that was dispatched.
+            const int new_speed = speed;
+            if (new_speed != mySpeed && new_speed > 0)
+                setSpeed(myLastTick, new_speed);
+
+            const Clock::time_point deadline = getDeadline(tick);
+            const Clock::time_point now = Clock::now();
+            if (now >= deadline)
+                break;
+
+            std::this_thread::sleep_until(
+                std::min(deadline, now + theMaxSleep));
+        }
+
+        dispatch(batch, batch_end);
+
+        for (auto event = batch; event != batch_end; ++event)
+        {
+            if (event->isTempoChange())
+                setBeatDuration(tick, event->getTempo());
+        }
+
+        myLastTick = tick;
+        batch = batch_end;
+    }
+}
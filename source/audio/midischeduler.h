@@ -0,0 +1,82 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AUDIO_MIDISCHEDULER_H
+#define AUDIO_MIDISCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <midi/midieventlist.h>
+
+/// Determines when each MIDI event should be sent during playback.
+///
+/// The deadline for each event is computed from the tick of the most recent
+/// tempo or speed change and the time at which that tick was due, rather than
+/// by sleeping for the delta between consecutive events. Sleeping late or
+/// taking time to send a message therefore delays the next event but does not
+/// accumulate over the course of a song.
+class MidiScheduler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::function<void(MidiEventList::const_iterator,
+                               MidiEventList::const_iterator)> Dispatch;
+
+    /// @param beat_duration The initial tempo, in microseconds per beat.
+    MidiScheduler(int ticks_per_beat, int beat_duration);
+
+    /// Sets the time when the event at the given tick is due, and the initial
+    /// playback speed (percent).
+    void start(int64_t tick, Clock::time_point time, int speed);
+
+    /// Changes the tempo for the events after the given tick.
+    void setBeatDuration(int64_t tick, int beat_duration);
+
+    /// Changes the playback speed for the events after the given tick.
+    void setSpeed(int64_t tick, int speed);
+
+    /// Returns the time when the event at the given tick is due.
+    Clock::time_point getDeadline(int64_t tick) const;
+
+    /// Plays the events, which must have absolute ticks. Events that have the
+    /// same tick are dispatched together once they are due, and tempo changes
+    /// are applied after they are dispatched. This can be called repeatedly to
+    /// play consecutive ranges of events. A range may start before the end of
+    /// the previous range (e.g. a grace note at the start of a bar is played
+    /// before the previous bar's last note-off), in which case the earlier
+    /// events are dispatched immediately.
+    /// Playback stops early if `playing` is cleared, and changes to `speed`
+    /// apply to the events that have not yet been dispatched.
+    void play(MidiEventList::const_iterator begin,
+              MidiEventList::const_iterator end, const std::atomic<int> &speed,
+              const std::atomic<bool> &playing, const Dispatch &dispatch);
+
+private:
+    const int myTicksPerBeat;
+    int myBeatDuration;
+    int mySpeed;
+
+    /// The tick of the most recent tempo or speed change, and when it was due.
+    int64_t myAnchorTick;
+    Clock::time_point myAnchorTime;
+    /// The tick of the most recently dispatched events.
+    int64_t myLastTick;
+};
+
+#endif
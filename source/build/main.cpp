@@ -261,6 +261,7 @@ int main(int argc, char *argv[])
 
     // Launch the application.
     program.show();
+    program.recoverBackups();
     program.openFiles(filesToOpen);
 
     return a.exec();
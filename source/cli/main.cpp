@@ -0,0 +1,123 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <app/settingsmanager.h>
+#include <boost/program_options.hpp>
+#include <cstdlib>
+#include <exception>
+#include <formats/batchconverter.h>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+int main(int argc, char *argv[])
+{
+    namespace po = boost::program_options;
+    po::options_description desc(
+        "Usage: pteconvert [options] input_dir\nImports every supported file "
+        "in a directory, and optionally converts them to another "
+        "format.\n\nOptions");
+
+    BatchConverter::Options options;
+    std::string input_dir, output_dir, report_file;
+
+    try
+    {
+        desc.add_options()
+            ("help,h", "Displays this help.")
+            ("input", po::value<std::string>(&input_dir)->required(),
+             "The directory to search for files.")
+            ("output,o", po::value<std::string>(&output_dir),
+             "The directory to write converted files to. If not specified, "
+             "the files are only validated.")
+            ("format,f",
+             po::value<std::string>(&options.myOutputFormat)
+                 ->default_value("pt2"),
+             "The extension of the output format.")
+            ("polish,p", po::bool_switch(&options.myPolish),
+             "Reformat each score before exporting it.")
+            ("report,r", po::value<std::string>(&report_file),
+             "Append the results to a JSON Lines report. Files that are "
+             "already in the report are skipped.")
+            ("threads,j",
+             po::value<unsigned int>(&options.myNumThreads)
+                 ->default_value(options.myNumThreads),
+             "The number of files to process at once.");
+        po::positional_options_description p;
+        p.add("input", 1);
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv)
+                      .options(desc)
+                      .positional(p)
+                      .run(),
+                  vm);
+
+        if (vm.count("help"))
+        {
+            std::cout << desc << std::endl;
+            return EXIT_SUCCESS;
+        }
+
+        po::notify(vm);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl << std::endl << desc << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    options.myInputDir = input_dir;
+    options.myOutputDir = output_dir;
+    options.myReportFile = report_file;
+
+    SettingsManager settings_manager;
+    BatchConverter converter(settings_manager, options);
+
+    std::mutex output_mutex;
+    int num_failures = 0;
+    try
+    {
+        auto results = converter.run([&](const BatchConverter::Result &r) {
+            std::lock_guard<std::mutex> lock(output_mutex);
+            if (r.mySuccess)
+                std::cout << "OK    " << r.myFile.string() << std::endl;
+            else
+            {
+                std::cout << "ERROR " << r.myFile.string() << ": "
+                          << r.myError << std::endl;
+            }
+        });
+
+        for (const BatchConverter::Result &result : results)
+        {
+            if (!result.mySuccess)
+                ++num_failures;
+        }
+
+        std::cout << std::endl
+                  << static_cast<int>(results.size()) - num_failures
+                  << " succeeded, "
+                  << num_failures << " failed." << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return num_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,92 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "undostatsdialog.h"
+
+#include <actions/undomanager.h>
+#include <algorithm>
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QLabel>
+#include <QVBoxLayout>
+
+UndoStatsDialog::UndoStatsDialog(QWidget *parent,
+                                 const UndoManager &undoManager)
+    : QDialog(parent), myUndoManager(undoManager)
+{
+    setWindowTitle(tr("Undo History Statistics"));
+    setAttribute(Qt::WA_DeleteOnClose);
+
+    myCommandsLabel = new QLabel(this);
+    mySnapshotsLabel = new QLabel(this);
+    myMemoryLabel = new QLabel(this);
+    mySpilledLabel = new QLabel(this);
+    myLargestCommandLabel = new QLabel(this);
+
+    auto formLayout = new QFormLayout();
+    formLayout->addRow(tr("Commands:"), myCommandsLabel);
+    formLayout->addRow(tr("System Snapshots:"), mySnapshotsLabel);
+    formLayout->addRow(tr("Memory Usage:"), myMemoryLabel);
+    formLayout->addRow(tr("Spilled to Disk:"), mySpilledLabel);
+    formLayout->addRow(tr("Largest Command:"), myLargestCommandLabel);
+
+    auto buttonBox = new QDialogButtonBox(QDialogButtonBox::Close);
+    connect(buttonBox, SIGNAL(rejected()), this, SLOT(reject()));
+
+    auto mainLayout = new QVBoxLayout(this);
+    mainLayout->addLayout(formLayout);
+    mainLayout->addWidget(buttonBox);
+    setLayout(mainLayout);
+
+    connect(&myUndoManager, SIGNAL(memoryStatsChanged()), this,
+            SLOT(updateStats()));
+    connect(&myUndoManager, SIGNAL(indexChanged(int)), this,
+            SLOT(updateStats()));
+
+    updateStats();
+}
+
+/// Formats a number of bytes as kilobytes.
+static QString formatBytes(size_t bytes)
+{
+    return QObject::tr("%1 KB").arg(bytes / 1024.0, 0, 'f', 1);
+}
+
+void UndoStatsDialog::updateStats()
+{
+    const UndoManager::MemoryStats stats = myUndoManager.getMemoryStats();
+
+    myCommandsLabel->setText(QString::number(stats.numCommands));
+    mySnapshotsLabel->setText(QString::number(stats.numSnapshots));
+    myMemoryLabel->setText(formatBytes(stats.memoryUsage));
+    mySpilledLabel->setText(tr("%1 snapshots (%2)")
+                                .arg(stats.numSpilled)
+                                .arg(formatBytes(stats.spilledBytes)));
+
+    const std::vector<size_t> &usage = stats.commandMemoryUsage;
+    auto largest = std::max_element(usage.begin(), usage.end());
+    if (largest != usage.end() && *largest > 0)
+    {
+        const int index = static_cast<int>(largest - usage.begin());
+        myLargestCommandLabel->setText(
+            tr("%1 (%2)")
+                .arg(myUndoManager.activeStack()->text(index))
+                .arg(formatBytes(*largest)));
+    }
+    else
+        myLargestCommandLabel->setText(tr("None"));
+}
@@ -0,0 +1,47 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DIALOGS_UNDOSTATSDIALOG_H
+#define DIALOGS_UNDOSTATSDIALOG_H
+
+#include <QDialog>
+
+class QLabel;
+class UndoManager;
+
+/// Debugging panel that shows the memory used by the undo history of the
+/// active document.
+class UndoStatsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    UndoStatsDialog(QWidget *parent, const UndoManager &undoManager);
+
+private slots:
+    void updateStats();
+
+private:
+    const UndoManager &myUndoManager;
+    QLabel *myCommandsLabel;
+    QLabel *mySnapshotsLabel;
+    QLabel *myMemoryLabel;
+    QLabel *mySpilledLabel;
+    QLabel *myLargestCommandLabel;
+};
+
+#endif
@@ -0,0 +1,447 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "batchconverter.h"
+
+#include <algorithm>
+#include <app/settingsmanager.h>
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <chrono>
+#include <formats/fileformatmanager.h>
+#include <map>
+#include <mutex>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <score/score.h>
+#include <score/utils/scorepolisher.h>
+#include <set>
+#include <stdexcept>
+#include <util/parallel.h>
+
+namespace fs = boost::filesystem;
+
+BatchConverter::Options::Options()
+    : myPolish(false), myNumThreads(Util::defaultThreadCount())
+{
+}
+
+BatchConverter::Result::Result()
+    : mySuccess(false),
+      myImportTime(0),
+      myPolishTime(0),
+      myExportTime(0),
+      myNumSystems(0),
+      myNumStaves(0),
+      myNumPositions(0),
+      myNumNotes(0),
+      myNumPlayers(0),
+      myNumInstruments(0)
+{
+}
+
+BatchConverter::BatchConverter(const SettingsManager &settings_manager,
+                               const Options &options)
+    : mySettingsManager(settings_manager), myOptions(options)
+{
+}
+
+/// Returns the file's extension in lower case, without the leading period.
+static std::string getExtension(const fs::path &file)
+{
+    std::string extension = file.extension().string();
+    if (!extension.empty())
+        extension.erase(0, 1);
+
+    return boost::algorithm::to_lower_copy(extension);
+}
+
+std::vector<fs::path> BatchConverter::findFiles(
+    std::vector<Result> &failures) const
+{
+    std::set<fs::path> completed;
+    std::set<fs::path> unfinished;
+    if (!myOptions.myReportFile.empty())
+    {
+        for (const fs::path &file : readReport(myOptions.myReportFile))
+            completed.insert(file);
+        for (const fs::path &file : readUnfinishedFiles(myOptions.myReportFile))
+            unfinished.insert(file);
+    }
+
+    FileFormatManager manager(mySettingsManager);
+    std::vector<fs::path> candidates;
+
+    for (fs::recursive_directory_iterator it(myOptions.myInputDir), end;
+         it != end; ++it)
+    {
+        if (!fs::is_regular_file(it->status()) ||
+            !manager.findImportFormat(getExtension(it->path())))
+        {
+            continue;
+        }
+
+        // Store paths relative to the input directory, so that they can be
+        // mirrored in the output directory.
+        fs::path relative;
+        auto input_it = myOptions.myInputDir.begin();
+        for (const fs::path &component : it->path())
+        {
+            if (input_it != myOptions.myInputDir.end() &&
+                *input_it == component)
+            {
+                ++input_it;
+            }
+            else
+                relative /= component;
+        }
+
+        candidates.push_back(relative);
+    }
+
+    // Process the files in a consistent order.
+    std::sort(candidates.begin(), candidates.end());
+
+    // Check for collisions before skipping the completed files, so that a new
+    // file cannot overwrite the output of a file from a previous job.
+    std::map<fs::path, fs::path> outputs;
+    std::vector<fs::path> files;
+    for (const fs::path &file : candidates)
+    {
+        std::string error;
+        if (!myOptions.myOutputDir.empty())
+        {
+            const fs::path output = getOutputPath(file);
+            auto it = outputs.find(output);
+            if (it != outputs.end())
+            {
+                error = "The output file " + output.generic_string() +
+                        " is also the output of " + it->second.generic_string();
+            }
+            else
+                outputs[output] = file;
+        }
+
+        if (completed.count(file))
+            continue;
+
+        if (error.empty() && unfinished.count(file))
+            error = "A previous job stopped while processing this file";
+
+        if (!error.empty())
+        {
+            Result result;
+            result.myFile = file;
+            result.myError = error;
+            failures.push_back(result);
+        }
+        else
+            files.push_back(file);
+    }
+
+    return files;
+}
+
+fs::path BatchConverter::getOutputPath(const fs::path &file) const
+{
+    fs::path output_path = file;
+    output_path.replace_extension(myOptions.myOutputFormat);
+    return output_path;
+}
+
+/// Returns the number of milliseconds since the given time.
+static double getElapsedTime(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start).count();
+}
+
+static void computeStatistics(const Score &score,
+                              BatchConverter::Result &result)
+{
+    result.myNumSystems = static_cast<int>(score.getSystems().size());
+    result.myNumPlayers = static_cast<int>(score.getPlayers().size());
+    result.myNumInstruments = static_cast<int>(score.getInstruments().size());
+
+    for (const System &system : score.getSystems())
+    {
+        result.myNumStaves += static_cast<int>(system.getStaves().size());
+
+        for (const Staff &staff : system.getStaves())
+        {
+            for (const Voice &voice : staff.getVoices())
+            {
+                for (const Position &pos : voice.getPositions())
+                {
+                    ++result.myNumPositions;
+                    result.myNumNotes +=
+                        static_cast<int>(pos.getNotes().size());
+                }
+            }
+        }
+    }
+}
+
+BatchConverter::Result BatchConverter::convertFile(const fs::path &file) const
+{
+    Result result;
+    result.myFile = file;
+
+    try
+    {
+        // Each file uses its own importers and exporters, so that no state
+        // is shared between files.
+        FileFormatManager manager(mySettingsManager);
+
+        const fs::path input_path = myOptions.myInputDir / file;
+        boost::optional<FileFormat> format =
+            manager.findImportFormat(getExtension(file));
+        if (!format)
+            throw std::runtime_error("Unsupported file type");
+
+        Score score;
+        auto start = std::chrono::steady_clock::now();
+        manager.importFile(score, input_path, *format);
+        result.myImportTime = getElapsedTime(start);
+
+        if (myOptions.myPolish)
+        {
+            start = std::chrono::steady_clock::now();
+            ScoreUtils::polishScore(score);
+            result.myPolishTime = getElapsedTime(start);
+        }
+
+        computeStatistics(score, result);
+
+        if (!myOptions.myOutputDir.empty())
+        {
+            boost::optional<FileFormat> output_format =
+                manager.findFormat(myOptions.myOutputFormat);
+            if (!output_format)
+                throw std::runtime_error("Unsupported output format");
+
+            const fs::path output_path =
+                myOptions.myOutputDir / getOutputPath(file);
+            fs::create_directories(output_path.parent_path());
+
+            start = std::chrono::steady_clock::now();
+            manager.exportFile(score, output_path, *output_format);
+            result.myExportTime = getElapsedTime(start);
+        }
+
+        result.mySuccess = true;
+    }
+    catch (const std::exception &e)
+    {
+        result.myError = e.what();
+    }
+    catch (...)
+    {
+        result.myError = "Unknown error";
+    }
+
+    return result;
+}
+
+std::vector<BatchConverter::Result> BatchConverter::run(
+    const ProgressCallback &callback) const
+{
+    std::vector<Result> failures;
+    const std::vector<fs::path> files = findFiles(failures);
+    std::vector<Result> results(files.size());
+
+    fs::ofstream report;
+    if (!myOptions.myReportFile.empty())
+    {
+        // If the job was interrupted while writing a line, start a new line
+        // rather than appending to the incomplete one.
+        bool needs_newline = false;
+        if (fs::exists(myOptions.myReportFile) &&
+            fs::file_size(myOptions.myReportFile) > 0)
+        {
+            fs::ifstream existing(myOptions.myReportFile,
+                                  std::ios::in | std::ios::binary);
+            existing.seekg(-1, std::ios::end);
+            needs_newline = existing.get() != '\n';
+        }
+
+        report.open(myOptions.myReportFile, std::ios::out | std::ios::app);
+        report.exceptions(std::ios::failbit | std::ios::badbit);
+
+        if (needs_newline)
+            report << '\n';
+    }
+
+    for (const Result &result : failures)
+    {
+        if (report.is_open())
+        {
+            report << formatResult(result) << '\n';
+            report.flush();
+        }
+
+        if (callback)
+            callback(result);
+    }
+
+    std::mutex report_mutex;
+    Util::parallelFor(files.size(), [&](size_t i) {
+        if (report.is_open())
+        {
+            // If converting the file crashes the job, this record allows the
+            // file to be reported as a failure when the job is resumed.
+            const std::string line = formatStarted(files[i]);
+            std::lock_guard<std::mutex> lock(report_mutex);
+            report << line << '\n';
+            report.flush();
+        }
+
+        results[i] = convertFile(files[i]);
+
+        if (report.is_open())
+        {
+            // Flush after each file so that the job can be resumed if it is
+            // interrupted.
+            const std::string line = formatResult(results[i]);
+            std::lock_guard<std::mutex> lock(report_mutex);
+            report << line << '\n';
+            report.flush();
+        }
+
+        if (callback)
+            callback(results[i]);
+    }, myOptions.myNumThreads);
+
+    results.insert(results.begin(), failures.begin(), failures.end());
+    return results;
+}
+
+/// Reads the files that have a result in the report, and the files that only
+/// have a record of being started.
+static void parseReport(const fs::path &report_file,
+                        std::vector<fs::path> &finished,
+                        std::vector<fs::path> &unfinished)
+{
+    if (!fs::exists(report_file))
+        return;
+
+    std::set<fs::path> started;
+    fs::ifstream input(report_file);
+    std::string line;
+    while (std::getline(input, line))
+    {
+        rapidjson::Document document;
+        document.Parse(line.c_str());
+
+        if (document.HasParseError() || !document.IsObject())
+            continue;
+
+        auto it = document.FindMember("file");
+        if (it == document.MemberEnd() || !it->value.IsString())
+            continue;
+
+        fs::path file = fs::path(it->value.GetString()).make_preferred();
+        if (document.HasMember("started"))
+            started.insert(file);
+        else
+        {
+            started.erase(file);
+            finished.push_back(file);
+        }
+    }
+
+    unfinished.assign(started.begin(), started.end());
+}
+
+std::vector<fs::path> BatchConverter::readReport(const fs::path &report_file)
+{
+    std::vector<fs::path> finished, unfinished;
+    parseReport(report_file, finished, unfinished);
+    return finished;
+}
+
+std::vector<fs::path> BatchConverter::readUnfinishedFiles(
+    const fs::path &report_file)
+{
+    std::vector<fs::path> finished, unfinished;
+    parseReport(report_file, finished, unfinished);
+    return unfinished;
+}
+
+std::string BatchConverter::formatStarted(const fs::path &file)
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+    const std::string name = file.generic_string();
+
+    writer.StartObject();
+    writer.Key("file");
+    writer.String(name.c_str(), static_cast<rapidjson::SizeType>(name.size()));
+    writer.Key("started");
+    writer.Bool(true);
+    writer.EndObject();
+    return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+std::string BatchConverter::formatResult(const Result &result)
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+    const std::string file = result.myFile.generic_string();
+
+    writer.StartObject();
+    writer.Key("file");
+    writer.String(file.c_str(), static_cast<rapidjson::SizeType>(file.size()));
+    writer.Key("success");
+    writer.Bool(result.mySuccess);
+
+    if (!result.mySuccess)
+    {
+        writer.Key("error");
+        writer.String(result.myError.c_str(),
+                      static_cast<rapidjson::SizeType>(result.myError.size()));
+    }
+    else
+    {
+        writer.Key("import_ms");
+        writer.Double(result.myImportTime);
+        writer.Key("polish_ms");
+        writer.Double(result.myPolishTime);
+        writer.Key("export_ms");
+        writer.Double(result.myExportTime);
+
+        writer.Key("systems");
+        writer.Int(result.myNumSystems);
+        writer.Key("staves");
+        writer.Int(result.myNumStaves);
+        writer.Key("positions");
+        writer.Int(result.myNumPositions);
+        writer.Key("notes");
+        writer.Int(result.myNumNotes);
+        writer.Key("players");
+        writer.Int(result.myNumPlayers);
+        writer.Key("instruments");
+        writer.Int(result.myNumInstruments);
+    }
+
+    writer.EndObject();
+    return std::string(buffer.GetString(), buffer.GetSize());
+}
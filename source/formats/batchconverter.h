@@ -0,0 +1,131 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FORMATS_BATCHCONVERTER_H
+#define FORMATS_BATCHCONVERTER_H
+
+#include <boost/filesystem/path.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+
+class Score;
+class SettingsManager;
+
+/// Imports every supported file in a directory tree, and optionally exports
+/// them to another format. Each file is processed independently, so an error
+/// in one file does not affect the others.
+class BatchConverter
+{
+public:
+    struct Options
+    {
+        Options();
+
+        /// The directory to search for files to import.
+        boost::filesystem::path myInputDir;
+        /// The directory to export files to, with the same layout as the
+        /// input directory. If this is empty, the files are only imported to
+        /// check that they are valid.
+        boost::filesystem::path myOutputDir;
+        /// The extension of the format to export to (e.g. "pt2").
+        std::string myOutputFormat;
+        /// Whether to reformat the score before exporting it.
+        bool myPolish;
+        /// A file that records the result of each file as a line of JSON.
+        /// Files that are already listed in the report are skipped, so an
+        /// interrupted job can be resumed. A line is also recorded before
+        /// each file is processed, so that a file which crashed the previous
+        /// job is reported as a failure instead of being processed again.
+        boost::filesystem::path myReportFile;
+        /// The number of files to process at once.
+        unsigned int myNumThreads;
+    };
+
+    struct Result
+    {
+        Result();
+
+        /// The file's path, relative to the input directory.
+        boost::filesystem::path myFile;
+        bool mySuccess;
+        std::string myError;
+
+        /// Timings, in milliseconds.
+        double myImportTime;
+        double myPolishTime;
+        double myExportTime;
+
+        int myNumSystems;
+        int myNumStaves;
+        int myNumPositions;
+        int myNumNotes;
+        int myNumPlayers;
+        int myNumInstruments;
+    };
+
+    typedef std::function<void(const Result &)> ProgressCallback;
+
+    BatchConverter(const SettingsManager &settings_manager,
+                   const Options &options);
+
+    /// Returns the files in the input directory that can be imported and are
+    /// not listed in the report yet, relative to the input directory.
+    /// Files that should not be processed are instead added to @p failures:
+    /// files whose output path is the same as an earlier file's, and files
+    /// that a previous job started but did not finish.
+    /// @throws std::exception
+    std::vector<boost::filesystem::path> findFiles(
+        std::vector<Result> &failures) const;
+
+    /// Imports and exports a single file. Any errors are recorded in the
+    /// result rather than thrown.
+    Result convertFile(const boost::filesystem::path &file) const;
+
+    /// Processes all of the files from findFiles() in parallel, and appends
+    /// the results to the report. The failures from findFiles() are listed
+    /// first. The callback is invoked after each file is completed, from the
+    /// thread that processed it.
+    /// @throws std::exception if the report cannot be written.
+    std::vector<Result> run(const ProgressCallback &callback = nullptr) const;
+
+    /// Returns the files that have a result in a report. Incomplete lines
+    /// (e.g. from an interrupted job) are ignored.
+    static std::vector<boost::filesystem::path> readReport(
+        const boost::filesystem::path &report_file);
+
+    /// Returns the files that were started but have no result in a report,
+    /// e.g. because the job crashed while processing them.
+    static std::vector<boost::filesystem::path> readUnfinishedFiles(
+        const boost::filesystem::path &report_file);
+
+    /// Formats a result as a single line of JSON.
+    static std::string formatResult(const Result &result);
+
+    /// Formats the record that is written before a file is processed.
+    static std::string formatStarted(const boost::filesystem::path &file);
+
+private:
+    /// Returns the export path for a file, relative to the output directory.
+    boost::filesystem::path getOutputPath(
+        const boost::filesystem::path &file) const;
+
+    const SettingsManager &mySettingsManager;
+    const Options myOptions;
+};
+
+#endif
@@ -86,6 +86,13 @@ FileFormatExporter::~FileFormatExporter()
 {
 }
 
+void FileFormatExporter::saveChanges(const boost::filesystem::path &filename,
+                                     const Score &score,
+                                     const std::vector<int> &)
+{
+    save(filename, score);
+}
+
 FileFormat FileFormatExporter::fileFormat() const
 {
     return myFormat;
@@ -79,6 +79,14 @@ public:
     virtual void save(const boost::filesystem::path &filename,
                       const Score &score) = 0;
 
+    /// Exports the score to the file that it was last saved to or loaded from,
+    /// where only the specified systems have been modified since then.
+    /// By default, the whole file is written again.
+    /// @throw FileFormatException
+    virtual void saveChanges(const boost::filesystem::path &filename,
+                             const Score &score,
+                             const std::vector<int> &modified_systems);
+
     /// Returns the file format corresponding to this exporter.
     FileFormat fileFormat() const;
 
@@ -26,12 +26,12 @@
 
 FileFormatManager::FileFormatManager(const SettingsManager &settings_manager)
 {
-    myImporters.emplace_back(new PowerTabImporter());
+    myImporters.emplace_back(new PowerTabImporter(settings_manager));
     myImporters.emplace_back(new PowerTabOldImporter());
     myImporters.emplace_back(new GuitarProImporter());
     myImporters.emplace_back(new GpxImporter());
 
-    myExporters.emplace_back(new PowerTabExporter());
+    myExporters.emplace_back(new PowerTabExporter(settings_manager));
     myExporters.emplace_back(new MidiExporter(settings_manager));
 }
 
@@ -53,6 +53,18 @@ boost::optional<FileFormat> FileFormatManager::findFormat(
     return boost::none;
 }
 
+boost::optional<FileFormat> FileFormatManager::findImportFormat(
+        const std::string &extension) const
+{
+    for (auto &importer : myImporters)
+    {
+        if (importer->fileFormat().contains(extension))
+            return importer->fileFormat();
+    }
+
+    return boost::none;
+}
+
 std::string FileFormatManager::importFileFilter() const
 {
     std::string filterAll = "All Supported Formats (";
@@ -119,3 +131,20 @@ void FileFormatManager::exportFile(const Score &score,
 
     throw std::runtime_error("Unknown file format");
 }
+
+void FileFormatManager::exportChanges(const Score &score,
+                                      const boost::filesystem::path &filename,
+                                      const FileFormat &format,
+                                      const std::vector<int> &modified_systems)
+{
+    for (auto &exporter : myExporters)
+    {
+        if (exporter->fileFormat() == format)
+        {
+            exporter->saveChanges(filename, score, modified_systems);
+            return;
+        }
+    }
+
+    throw std::runtime_error("Unknown file format");
+}
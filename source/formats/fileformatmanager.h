@@ -37,6 +37,11 @@ public:
     /// Returns the file format corresponding to the given extension.
     boost::optional<FileFormat> findFormat(const std::string &extension) const;
 
+    /// Returns the importable file format corresponding to the given
+    /// extension.
+    boost::optional<FileFormat> findImportFormat(
+        const std::string &extension) const;
+
     /// Returns a correctly formatted file filter for a Qt file dialog.
     /// e.g. "FileType (*.ext1 *.ext2);;FileType2 (*.ext3)".
     std::string importFileFilter() const;
@@ -54,6 +59,14 @@ public:
     void exportFile(const Score &score, const boost::filesystem::path &filename,
                     const FileFormat &format);
 
+    /// Exports the given score to the file that it was last saved to or loaded
+    /// from, given the systems that have been modified since then.
+    /// @throws std::exception
+    void exportChanges(const Score &score,
+                       const boost::filesystem::path &filename,
+                       const FileFormat &format,
+                       const std::vector<int> &modified_systems);
+
 private:
     template <typename Importer>
     void registerImporter();
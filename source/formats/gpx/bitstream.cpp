@@ -19,69 +19,50 @@
 
 #include <cassert>
 #include <istream>
-#include "util.h"
 
 static const uint32_t BYTE_LENGTH = 8;
 
 Gpx::BitStream::BitStream(std::istream &stream)
-    : myPosition(0)
+    : myBytePosition(0), myBuffer(0), myNumBits(0)
 {
     // Copy data from the stream into an internal buffer.
     stream.seekg(0, std::ios::end);
     myBytes.resize(stream.tellg());
 
     stream.seekg(0, std::ios::beg);
-    stream.read(reinterpret_cast<char *>(&myBytes[0]), myBytes.size());
+    stream.read(reinterpret_cast<char *>(myBytes.data()), myBytes.size());
 }
 
 uint32_t Gpx::BitStream::readInt()
 {
-    assert(myPosition % BYTE_LENGTH == 0);
+    assert(myNumBits % BYTE_LENGTH == 0);
 
-    const uint32_t value = Gpx::Util::readUInt(myBytes,
-                                               myPosition / BYTE_LENGTH);
-    myPosition += sizeof(uint32_t) * BYTE_LENGTH;
-    return value;
-}
-
-bool Gpx::BitStream::readBit()
-{
-    if (myPosition / BYTE_LENGTH >= myBytes.size())
-        return 0;
-
-    char byte = myBytes[myPosition / BYTE_LENGTH];
-    byte >>= ((BYTE_LENGTH - 1) - (myPosition % BYTE_LENGTH));
-    byte &= 0x01;
-
-    ++myPosition;
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < sizeof(uint32_t); ++i)
+        value |= static_cast<uint32_t>(readBits(BYTE_LENGTH)) << (i * 8);
 
-    return byte != 0;
+    return value;
 }
 
-int32_t Gpx::BitStream::readBits(int n, BitOrder order)
+void Gpx::BitStream::refill()
 {
-    int32_t value = 0;
+    const size_t size = myBytes.size();
+    const uint8_t *bytes = myBytes.data();
 
-    if (order == Reversed)
-    {
-        for (int i = 0; i < n; ++i)
-            value |= (readBit() << i);
-    }
-    else
+    while (myNumBits <= 56 && myBytePosition < size)
     {
-        for (int i = n - 1; i >= 0; --i)
-            value |= (readBit() << i);
+        myBuffer |= static_cast<uint64_t>(bytes[myBytePosition++])
+                    << (56 - myNumBits);
+        myNumBits += BYTE_LENGTH;
     }
-
-    return value;
 }
 
 size_t Gpx::BitStream::getLocation() const
 {
-    return myPosition / BYTE_LENGTH;
+    return myBytePosition - (myNumBits + BYTE_LENGTH - 1) / BYTE_LENGTH;
 }
 
 bool Gpx::BitStream::isAtEnd() const
 {
-    return getLocation() >= (myBytes.size() - 1);
+    return getLocation() + 1 >= myBytes.size();
 }
@@ -27,6 +27,8 @@ namespace Gpx
 
 /// Provides the ability to read individual bits from a stream.
 /// This is required for the compression scheme used in .gpx files.
+/// Bits are read from a 64-bit buffer that is refilled a byte at a time, so
+/// that reading a group of bits only needs a couple of shifts.
 class BitStream
 {
 public:
@@ -43,10 +45,27 @@ public:
     uint32_t readInt();
 
     /// Reads the next bit from the stream.
-    bool readBit();
+    bool readBit() { return readBits(1) != 0; }
 
-    /// Reads the next n bits from the stream into an integer.
-    int32_t readBits(int n, BitOrder = Normal);
+    /// Reads the next n bits (at most 32) from the stream into an integer.
+    /// Any bits past the end of the stream are read as zero.
+    int32_t readBits(int n, BitOrder order = Normal)
+    {
+        if (n <= 0)
+            return 0;
+
+        if (myNumBits < n)
+            refill();
+
+        uint32_t value = static_cast<uint32_t>(myBuffer >> (64 - n));
+        myBuffer <<= n;
+        myNumBits = (myNumBits > n) ? myNumBits - n : 0;
+
+        if (order == Reversed)
+            value = reverseBits(value) >> (32 - n);
+
+        return static_cast<int32_t>(value);
+    }
 
     /// Returns the position in the stream (measured in bytes).
     size_t getLocation() const;
@@ -55,10 +74,27 @@ public:
     bool isAtEnd() const;
 
 private:
-    /// The current position in the input (measured in bits).
-    size_t myPosition;
+    /// Loads as many whole bytes as will fit into the buffer.
+    void refill();
+
+    /// Reverses the order of the bits in a 32-bit integer.
+    static uint32_t reverseBits(uint32_t value)
+    {
+        value = ((value >> 1) & 0x55555555) | ((value & 0x55555555) << 1);
+        value = ((value >> 2) & 0x33333333) | ((value & 0x33333333) << 2);
+        value = ((value >> 4) & 0x0F0F0F0F) | ((value & 0x0F0F0F0F) << 4);
+        value = ((value >> 8) & 0x00FF00FF) | ((value & 0x00FF00FF) << 8);
+        return (value >> 16) | (value << 16);
+    }
+
     /// The compressed data being read.
     std::vector<uint8_t> myBytes;
+    /// The position of the next byte to load into the buffer.
+    size_t myBytePosition;
+    /// The unread bits, starting from the most significant bit.
+    uint64_t myBuffer;
+    /// The number of unread bits in the buffer.
+    int myNumBits;
 };
 
 }
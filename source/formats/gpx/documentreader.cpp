@@ -17,8 +17,12 @@
   
 #include "documentreader.h"
 
+#include <algorithm>
 #include <boost/date_time/gregorian/gregorian_types.hpp>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <iterator>
 #include <score/generalmidi.h>
 #include <score/score.h>
 #include <sstream>
@@ -28,26 +32,82 @@ static const int POSITIONS_PER_SYSTEM = 35;
 
 using namespace pugi;
 
-/// Utility function for parsing a string of space-separated values.
-template <typename T>
-static void convertStringToList(const std::string &source, std::vector<T> &dest)
+/// Utility function for parsing a string of space-separated integers.
+static void convertStringToList(const char *source, std::vector<int> &dest)
 {
-    std::stringstream ss(source);
-    T item;
     dest.clear();
 
-    while (ss >> item)
+    char *end = nullptr;
+    for (long item = std::strtol(source, &end, 10); end != source;
+         item = std::strtol(source, &end, 10))
     {
-        dest.push_back(item);
+        dest.push_back(static_cast<int>(item));
+        source = end;
     }
 
     if (dest.empty())
         std::cerr << "Parsing of list failed!!" << std::endl;
 }
 
-Gpx::DocumentReader::DocumentReader(const std::string &xml)
+/// Returns the number of children of a node.
+static size_t countChildren(const xml_node &node)
 {
-    xml_parse_result result = myXmlData.load(xml.c_str());
+    return std::distance(node.begin(), node.end());
+}
+
+/// Returns the slot for the item with the given id, creating it if necessary.
+template <typename T>
+static T &insertItem(std::vector<T> &items, int id, size_t count)
+{
+    // Ids are normally numbered sequentially, so reject any that are far
+    // larger than the number of items rather than allocating a huge vector.
+    if (id < 0 || static_cast<size_t>(id) > 2 * count + 64)
+        throw std::runtime_error("Invalid id: " + std::to_string(id));
+
+    if (static_cast<size_t>(id) >= items.size())
+    {
+        T unused = T();
+        unused.id = -1;
+        items.resize(id + 1, unused);
+    }
+
+    items[id].id = id;
+    return items[id];
+}
+
+/// The beats of an empty voice.
+static const std::vector<int> theEmptyVoiceBeats;
+
+/// Returns the item with the given id.
+template <typename T>
+static const T &findItem(const std::vector<T> &items, int id)
+{
+    if (id < 0 || static_cast<size_t>(id) >= items.size() ||
+        items[id].id != id)
+    {
+        throw std::runtime_error("Invalid id: " + std::to_string(id));
+    }
+
+    return items[id];
+}
+
+/// Returns the first "Property" child with the given name.
+static xml_node findProperty(const xml_node &properties, const char *name)
+{
+    for (xml_node property : properties.children("Property"))
+    {
+        if (std::strcmp(property.attribute("name").value(), name) == 0)
+            return property;
+    }
+
+    return xml_node();
+}
+
+Gpx::DocumentReader::DocumentReader(std::vector<char> xml)
+    : myXmlBuffer(std::move(xml))
+{
+    xml_parse_result result = myXmlData.load_buffer_inplace(
+        myXmlBuffer.data(), myXmlBuffer.size());
 
     if (result.status != pugi::status_ok)
         throw std::runtime_error(result.description());
@@ -119,8 +179,13 @@ void Gpx::DocumentReader::readTracks(Score &score)
             Tuning tuning = player.getTuning();
             // Read the tuning - need to convert from a string of numbers
             // separated by spaces to a vector of integers.
-            xml_node pitches = properties.select_single_node(
-                        "./Property/Pitches").node();
+            xml_node pitches;
+            for (xml_node property : properties.children("Property"))
+            {
+                if ((pitches = property.child("Pitches")))
+                    break;
+            }
+
             if (pitches)
 			{
 				std::vector<int> tuningNotes;
@@ -131,8 +196,13 @@ void Gpx::DocumentReader::readTracks(Score &score)
             }
 
             // Read capo
-            xml_node capo = properties.select_single_node(
-                        "./Property/Fret").node();
+            xml_node capo;
+            for (xml_node property : properties.children("Property"))
+            {
+                if ((capo = property.child("Fret")))
+                    break;
+            }
+
             tuning.setCapo(capo.text().as_int());
 
             player.setTuning(tuning);
@@ -145,34 +215,42 @@ void Gpx::DocumentReader::readTracks(Score &score)
 
 void Gpx::DocumentReader::readBars()
 {
-    for (xml_node currentBar : myFile.child("Bars"))
+    const xml_node bars = myFile.child("Bars");
+    const size_t count = countChildren(bars);
+    myBars.reserve(count);
+
+    for (xml_node currentBar : bars)
     {
-        Gpx::Bar bar;
-        bar.id = currentBar.attribute("id").as_int();
+        Gpx::Bar &bar = insertItem(
+            myBars, currentBar.attribute("id").as_int(), count);
         convertStringToList(currentBar.child_value("Voices"), bar.voiceIds);
-
-        myBars[bar.id] = bar;
     }
 }
 
 void Gpx::DocumentReader::readVoices()
 {
-    for (xml_node currentVoice : myFile.child("Voices"))
+    const xml_node voices = myFile.child("Voices");
+    const size_t count = countChildren(voices);
+    myVoices.reserve(count);
+
+    for (xml_node currentVoice : voices)
     {
-        Gpx::Voice voice;
-        voice.id = currentVoice.attribute("id").as_int();
+        Gpx::Voice &voice = insertItem(
+            myVoices, currentVoice.attribute("id").as_int(), count);
         convertStringToList(currentVoice.child_value("Beats"), voice.beatIds);
-
-        myVoices[voice.id] = voice;
     }
 }
 
 void Gpx::DocumentReader::readBeats()
 {
-    for (xml_node currentBeat : myFile.child("Beats"))
+    const xml_node beats = myFile.child("Beats");
+    const size_t count = countChildren(beats);
+    myBeats.reserve(count);
+
+    for (xml_node currentBeat : beats)
     {
-        Gpx::Beat beat;
-        beat.id = currentBeat.attribute("id").as_int();
+        Gpx::Beat &beat = insertItem(
+            myBeats, currentBeat.attribute("id").as_int(), count);
         beat.rhythmId = currentBeat.child("Rhythm").attribute("ref").as_int();
         convertStringToList(currentBeat.child_value("Notes"), beat.noteIds);
 
@@ -185,36 +263,44 @@ void Gpx::DocumentReader::readBeats()
         if (properties)
         {
             // Search for brush direction in the properties list.
-            xml_node brush = properties.select_single_node(
-                        "./Property[@name = 'Brush']/Direction").node();
+            xml_node brush = findProperty(properties, "Brush");
             if (brush)
-            {
-                beat.brushDirection = brush.child_value();
-            }
+                beat.brushDirection = brush.child_value("Direction");
         }
-
-        myBeats[beat.id] = beat;
     }
 }
 
 void Gpx::DocumentReader::readRhythms()
 {
-    for (xml_node currentRhythm : myFile.child("Rhythms"))
+    static const std::pair<const char *, int> theNoteValues[] = {
+        { "Whole", 1 }, { "Half", 2 }, { "Quarter", 4 }, { "Eighth", 8 },
+        { "16th", 16 }, { "32nd", 32 }, { "64th", 64 }
+    };
+
+    const xml_node rhythms = myFile.child("Rhythms");
+    const size_t count = countChildren(rhythms);
+    myRhythms.reserve(count);
+
+    for (xml_node currentRhythm : rhythms)
     {
-        Gpx::Rhythm rhythm;
-        rhythm.id = currentRhythm.attribute("id").as_int();
+        Gpx::Rhythm &rhythm = insertItem(
+            myRhythms, currentRhythm.attribute("id").as_int(), count);
 
         // Convert duration to PowerTab format.
-        const std::string noteValueStr = currentRhythm.child_value("NoteValue");
-
-        std::map<std::string, int> noteValuesToInt = {
-			{ "Whole", 1 }, { "Half", 2 }, { "Quarter", 4 },
-			{ "Eighth", 8 }, { "16th", 16 }, { "32nd", 32 },
-			{ "64th", 64 }
-		};
+        const char *noteValueStr = currentRhythm.child_value("NoteValue");
+        auto noteValue = std::find_if(
+            std::begin(theNoteValues), std::end(theNoteValues),
+            [=](const std::pair<const char *, int> &value) {
+                return std::strcmp(value.first, noteValueStr) == 0;
+            });
+
+        if (noteValue == std::end(theNoteValues))
+        {
+            throw std::runtime_error(std::string("Invalid note value: ") +
+                                     noteValueStr);
+        }
 
-        assert(noteValuesToInt.find(noteValueStr) != noteValuesToInt.end());
-        rhythm.noteValue = noteValuesToInt.find(noteValueStr)->second;
+        rhythm.noteValue = noteValue->second;
 
         // Handle dotted/double dotted notes
         int numDots = currentRhythm.child("AugmentationDot").attribute(
@@ -222,38 +308,38 @@ void Gpx::DocumentReader::readRhythms()
 
         rhythm.dotted = numDots == 1;
         rhythm.doubleDotted = numDots == 2;
-
-        myRhythms[rhythm.id] = rhythm;
     }
 }
 
 void Gpx::DocumentReader::readNotes()
 {
-    for (xml_node currentNote : myFile.child("Notes"))
+    const xml_node notes = myFile.child("Notes");
+    const size_t count = countChildren(notes);
+    myNotes.reserve(count);
+
+    for (xml_node currentNote : notes)
     {
-        Gpx::TabNote note;
-        note.id = currentNote.attribute("id").as_int();
+        Gpx::TabNote &note = insertItem(
+            myNotes, currentNote.attribute("id").as_int(), count);
         note.properties = currentNote.child("Properties");
 
-        note.tied = currentNote.child("Tie").attribute(
-                    "destination").as_string() == std::string("true");
-        note.ghostNote = currentNote.child_value("AntiAccent") ==
-                std::string("Normal");
+        note.tied = std::strcmp(currentNote.child("Tie").attribute(
+                    "destination").as_string(), "true") == 0;
+        note.ghostNote = std::strcmp(currentNote.child_value("AntiAccent"),
+                                     "Normal") == 0;
         note.accentType = currentNote.child("Accent").text().as_int();
         note.vibratoType = currentNote.child_value("Vibrato");
         note.letRing = !currentNote.child("LetRing").empty();
         note.trillNote = currentNote.child("Trill").text().as_int(-1);
-
-        myNotes[note.id] = note;
     }
 }
 
 void Gpx::DocumentReader::readAutomations()
 {
-    for (xpath_node node :
-         myFile.select_nodes("./MasterTrack/Automations/Automation"))
+    for (xml_node currentAutomation : myFile.child("MasterTrack")
+                                          .child("Automations")
+                                          .children("Automation"))
     {
-        xml_node currentAutomation = node.node();
         Gpx::Automation gpxAutomation;
         gpxAutomation.type = currentAutomation.child_value("Type");
         gpxAutomation.linear = currentAutomation.child(
@@ -286,11 +372,8 @@ void Gpx::DocumentReader::readMasterBars(Score &score)
 
     int barIndex = 0;
     int startPos = 0;
-    for (xml_node masterBar : myFile.child("MasterBars"))
+    for (xml_node masterBar : myFile.child("MasterBars").children("MasterBar"))
     {
-        if (masterBar.name() != std::string("MasterBar"))
-            continue;
-
         // Try to create a new system every so often.
         if (startPos > POSITIONS_PER_SYSTEM)
         {
@@ -306,9 +389,10 @@ void Gpx::DocumentReader::readMasterBars(Score &score)
 
         Barline barline;
 
-        if (myAutomations.find(barIndex) != myAutomations.end())
+        auto automationIt = myAutomations.find(barIndex);
+        if (automationIt != myAutomations.end())
         {
-            const Automation automation = myAutomations.find(barIndex)->second;
+            const Automation &automation = automationIt->second;
             if (automation.type == "Tempo")
             {
                 if (automation.value.size() != 2)
@@ -344,10 +428,16 @@ void Gpx::DocumentReader::readMasterBars(Score &score)
             int currentPos = (startPos != 0) ? startPos + 1 : 0;
 
             // TODO - import multiple voices.
-            for (int beatId :
-                 myVoices[myBars[barIds[i]].voiceIds.at(0)].beatIds)
+            // A voice id of -1 indicates that the voice is empty.
+            const Gpx::Bar &bar = findItem(myBars, barIds[i]);
+            const std::vector<int> &beatIds =
+                (bar.voiceIds.empty() || bar.voiceIds[0] < 0)
+                    ? theEmptyVoiceBeats
+                    : findItem(myVoices, bar.voiceIds[0]).beatIds;
+
+            for (int beatId : beatIds)
             {
-                const Gpx::Beat &beat = myBeats[beatId];
+                const Gpx::Beat &beat = findItem(myBeats, beatId);
 
                 // Create text item at this position if necessary.
                 if (!beat.freeText.empty())
@@ -366,7 +456,8 @@ void Gpx::DocumentReader::readMasterBars(Score &score)
                 pos.setProperty(Position::TremoloPicking, beat.tremoloPicking);
                 pos.setProperty(Position::Acciaccatura, beat.graceNote);
 
-                const Gpx::Rhythm &rhythm = myRhythms.at(beat.rhythmId);
+                const Gpx::Rhythm &rhythm =
+                    findItem(myRhythms, beat.rhythmId);
                 pos.setDurationType(static_cast<Position::DurationType>(
                                         rhythm.noteValue));
                 pos.setProperty(Position::Dotted, rhythm.dotted);
@@ -475,7 +566,7 @@ void Gpx::DocumentReader::readTimeSignature(const xml_node &masterBar,
 Note Gpx::DocumentReader::convertNote(int noteId, Position &position,
                                       const Tuning &tuning) const
 {
-    Gpx::TabNote gpxNote = myNotes.at(noteId);
+    const Gpx::TabNote &gpxNote = findItem(myNotes, noteId);
     Note ptbNote;
 
     ptbNote.setProperty(Note::Tied, gpxNote.tied);
@@ -21,6 +21,7 @@
 #include <map>
 #include <pugixml.hpp>
 #include <score/note.h>
+#include <string>
 #include <vector>
 
 class Barline;
@@ -90,7 +91,9 @@ struct Automation
 class DocumentReader
 {
 public:
-    DocumentReader(const std::string &xml);
+    /// Parses the XML document in place. The reader keeps the buffer, since
+    /// the parsed nodes refer to it.
+    explicit DocumentReader(std::vector<char> xml);
 
     void readScore(Score &score);
 
@@ -114,14 +117,16 @@ private:
                            TimeSignature &timeSignature);
     Note convertNote(int noteId, Position &position, const Tuning &tuning) const;
 
+    std::vector<char> myXmlBuffer;
     pugi::xml_document myXmlData;
     pugi::xml_node myFile;
 
-    std::map<int, Gpx::Bar> myBars;
-    std::map<int, Gpx::Voice> myVoices;
-    std::map<int, Gpx::Beat> myBeats;
-    std::map<int, Gpx::Rhythm> myRhythms;
-    std::map<int, Gpx::TabNote> myNotes;
+    /// Items are stored by id, since the ids are numbered sequentially.
+    std::vector<Gpx::Bar> myBars;
+    std::vector<Gpx::Voice> myVoices;
+    std::vector<Gpx::Beat> myBeats;
+    std::vector<Gpx::Rhythm> myRhythms;
+    std::vector<Gpx::TabNote> myNotes;
     std::map<int, Gpx::Automation> myAutomations;
 };
 }
@@ -17,9 +17,11 @@
   
 #include "filesystem.h"
 
+#include <algorithm>
 #include "bitstream.h"
 #include <boost/algorithm/clamp.hpp>
 #include <cassert>
+#include <cstring>
 #include <formats/fileformat.h>
 #include "util.h"
 
@@ -30,6 +32,7 @@ enum ChunkHeader
 };
 
 static const uint32_t SECTOR_SIZE = 0x1000;
+static const size_t HEADER_SIZE = 4;
 
 Gpx::FileSystem::FileSystem(std::istream &stream)
 {
@@ -46,8 +49,16 @@ Gpx::FileSystem::FileSystem(std::istream &stream)
         throw FileFormatException("Invalid header");
 
     const uint32_t length = input.readInt();
-    std::vector<uint8_t> output;
-    output.reserve(length);
+
+    // Write directly into a buffer of the expected size, which only needs to
+    // grow if the file is malformed.
+    std::vector<uint8_t> output(length);
+    size_t outputSize = 0;
+
+    auto reserve = [&](size_t count) {
+        if (outputSize + count > output.size())
+            output.resize(std::max(output.size() * 2, outputSize + count));
+    };
 
     // We now have a succession of compressed and uncompressed chunks.
     while (!input.isAtEnd() && input.getLocation() < length)
@@ -59,9 +70,10 @@ Gpx::FileSystem::FileSystem(std::istream &stream)
         if (chunkHeader == Uncompressed)
         {
             const int32_t rawLength = input.readBits(2, Gpx::BitStream::Reversed);
+            reserve(rawLength);
 
             for (int32_t i = 0; i < rawLength; ++i)
-                output.push_back(input.readBits(8));
+                output[outputSize++] = static_cast<uint8_t>(input.readBits(8));
         }
         // For a compressed chunk, we have a 4-bit integer giving a length P,
         // then two integers of P bits representing the offset and length of the
@@ -71,82 +83,154 @@ Gpx::FileSystem::FileSystem(std::istream &stream)
         {
             const int32_t p = input.readBits(4);
             const int32_t offset = input.readBits(p, Gpx::BitStream::Reversed);
-            const size_t startPos = output.size() - offset;
+            if (static_cast<size_t>(offset) > outputSize)
+                throw FileFormatException("Invalid GPX Format");
 
             const int32_t length = boost::algorithm::clamp<int32_t>(
                 input.readBits(p, Gpx::BitStream::Reversed), 0, offset);
-
-            std::copy(output.begin() + startPos,
-                      output.begin() + startPos + length,
-                      std::back_inserter(output));
+            reserve(length);
+
+            // Since the length is at most the offset, the source and
+            // destination ranges never overlap.
+            uint8_t *data = output.data();
+            std::memcpy(data + outputSize, data + outputSize - offset,
+                        length);
+            outputSize += length;
         }
     }
 
+    output.resize(outputSize);
+    if (output.size() < HEADER_SIZE)
+        throw FileFormatException("Invalid GPX Format");
+
     // The data we just read should now have a header indicating that it's
     // uncompressed!
     const uint32_t newHeader = Gpx::Util::readUInt(output, 0);
     if (newHeader != BCFS_HEADER)
         throw FileFormatException("Invalid GPX Format");
 
-    readUncompressedData(output);
+    myData = std::move(output);
+    readUncompressedData();
 }
 
-const std::string &Gpx::FileSystem::getFileContents(
-        const std::string &filename) const
+Gpx::FileSystem::File::File()
+    : mySize(0), myIsContiguous(true), myIsLoaded(false)
 {
-    std::map<std::string, std::string>::const_iterator file = myFiles.find(filename);
+}
 
-    if (file == myFiles.end())
+boost::string_ref Gpx::FileSystem::getFileContents(
+        const std::string &filename) const
+{
+    auto it = myFiles.find(filename);
+    if (it == myFiles.end())
         throw FileFormatException("Invalid filename");
-    else
-        return file->second;
+
+    const File &file = it->second;
+    if (file.myIsContiguous)
+    {
+        if (file.mySectors.empty())
+            return boost::string_ref();
+
+        return boost::string_ref(getSector(file.mySectors.front()).data(),
+                                 file.mySize);
+    }
+
+    std::lock_guard<std::mutex> lock(myMutex);
+    if (!file.myIsLoaded)
+    {
+        file.myContents.reserve(file.mySize);
+        for (uint32_t sector : file.mySectors)
+        {
+            const boost::string_ref data = getSector(sector);
+            file.myContents.append(
+                data.data(),
+                std::min<size_t>(data.size(),
+                                 file.mySize - file.myContents.size()));
+        }
+
+        file.myIsLoaded = true;
+    }
+
+    return file.myContents;
+}
+
+boost::string_ref Gpx::FileSystem::getSector(uint32_t sector) const
+{
+    // Sector offsets are relative to the end of the BCFS header.
+    const size_t size = myData.size() - HEADER_SIZE;
+    const size_t start = std::min<size_t>(size_t(sector) * SECTOR_SIZE, size);
+    const size_t end = std::min<size_t>(start + SECTOR_SIZE, size);
+
+    return boost::string_ref(
+        reinterpret_cast<const char *>(myData.data()) + HEADER_SIZE + start,
+        end - start);
+}
+
+bool Gpx::FileSystem::isContiguous(const File &file) const
+{
+    // Only the sectors that hold the file's data need to be adjacent.
+    size_t size = 0;
+    for (size_t i = 1; i < file.mySectors.size(); ++i)
+    {
+        const boost::string_ref prev = getSector(file.mySectors[i - 1]);
+        size += prev.size();
+        if (size >= file.mySize)
+            break;
+
+        if (getSector(file.mySectors[i]).data() != prev.end())
+            return false;
+    }
+
+    return true;
 }
 
-void Gpx::FileSystem::readUncompressedData(std::vector<uint8_t> &data)
+void Gpx::FileSystem::readUncompressedData()
 {
-    // Remove the BCFS header.
-    data.erase(data.begin(), data.begin() + 4);
+    const size_t dataSize = myData.size() - HEADER_SIZE;
+    auto readUInt = [&](size_t index) {
+        if (index + 4 > dataSize)
+            throw FileFormatException("Invalid GPX Format");
+        return Util::readUInt(myData, HEADER_SIZE + index);
+    };
+
     size_t offset = 0;
 
     // Read all files from the file system.
-    while ( (offset = (offset + SECTOR_SIZE)) + 3 < data.size())
+    while ( (offset = (offset + SECTOR_SIZE)) + 3 < dataSize)
     {
-        if (Util::readUInt(data, offset) == 2)
+        if (readUInt(offset) == 2)
         {
             const size_t fileNameIndex = offset + 4;
             const size_t fileSizeIndex= offset + 0x8C;
             const size_t blockIndex= offset + 0x94;
 
-            int block = 0;
-            int blockCount = 0;
-            std::vector<uint8_t> fileData;
+            File file;
+            size_t availableSize = 0;
+            uint32_t block = 0;
 
-            // Read the file data.
-            while ((block = Util::readUInt(data,
-                                           blockIndex + 4 * blockCount)) != 0)
+            // Find the sectors containing the file data.
+            while ((block = readUInt(blockIndex + 4 * file.mySectors.size())) !=
+                   0)
             {
+                file.mySectors.push_back(block);
+                availableSize += getSector(block).size();
                 offset = block * SECTOR_SIZE;
-                std::copy(data.begin() + offset,
-                          data.begin() +
-                          boost::algorithm::clamp<size_t>(offset + SECTOR_SIZE,
-                                                          0, data.size()),
-                          std::back_inserter(fileData));
-                ++blockCount;
             }
 
             // Read the file name and save the file.
-            const uint32_t fileSize = Util::readUInt(data, fileSizeIndex);
-            if (fileData.size() >= fileSize)
+            file.mySize = readUInt(fileSizeIndex);
+            if (availableSize >= file.mySize)
             {
-                std::string fileName;
-                std::copy(data.begin() + fileNameIndex,
-                          data.begin() + fileNameIndex + 127,
-                          std::back_inserter(fileName));
+                file.myIsContiguous = isContiguous(file);
+
+                const char *name = reinterpret_cast<const char *>(
+                    myData.data() + HEADER_SIZE + fileNameIndex);
+                std::string fileName(
+                    name, std::min<size_t>(127, dataSize - fileNameIndex));
                 // Trim extra NULL characters.
                 fileName.erase(fileName.find_last_not_of('\0') + 1);
 
-                std::string file(fileData.begin(), fileData.begin() + fileSize);
-                myFiles[fileName] = file;
+                myFiles[fileName] = std::move(file);
             }
         }
     }
@@ -18,9 +18,11 @@
 #ifndef FORMATS_GPX_FILESYSTEM_H
 #define FORMATS_GPX_FILESYSTEM_H
 
+#include <boost/utility/string_ref.hpp>
 #include <cstdint>
 #include <iosfwd>
 #include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -30,18 +32,50 @@ namespace Gpx
 /// The uncompressed *.gpx file is essentially a filesystem containing several
 /// xml files.
 /// This class handles the extraction of information from that filesystem.
+/// The decompressed data is kept in a single buffer, and files are returned
+/// as views into that buffer where possible.
 class FileSystem
 {
 public:
     FileSystem(std::istream &stream);
 
-    const std::string &getFileContents(const std::string &filename) const;
+    /// Returns the contents of the file, which remain valid for the lifetime
+    /// of the filesystem. Files whose sectors are not contiguous are
+    /// assembled on first access.
+    /// @throws FileFormatException if the file does not exist.
+    boost::string_ref getFileContents(const std::string &filename) const;
 
 private:
-    void readUncompressedData(std::vector<uint8_t> &data);
+    struct File
+    {
+        File();
 
-    /// Maps filenames to file contents.
-    std::map<std::string, std::string> myFiles;
+        /// The sectors containing the file's data, in order.
+        std::vector<uint32_t> mySectors;
+        /// The size of the file, in bytes.
+        uint32_t mySize;
+        /// Whether the file's data is stored contiguously in the buffer.
+        bool myIsContiguous;
+        /// The assembled contents of a non-contiguous file, once loaded.
+        mutable std::string myContents;
+        mutable bool myIsLoaded;
+    };
+
+    void readUncompressedData();
+
+    /// Returns whether the file's data can be read directly from the buffer.
+    bool isContiguous(const File &file) const;
+
+    /// Returns the start of a sector and the number of bytes available in
+    /// it, which may be less than a full sector at the end of the data.
+    boost::string_ref getSector(uint32_t sector) const;
+
+    /// The decompressed data, including the header.
+    std::vector<uint8_t> myData;
+    /// Maps filenames to their location in the data.
+    std::map<std::string, File> myFiles;
+    /// Protects the lazily assembled file contents.
+    mutable std::mutex myMutex;
 };
 
 }
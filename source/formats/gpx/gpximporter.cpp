@@ -36,7 +36,10 @@ void GpxImporter::load(const boost::filesystem::path &filename, Score &score)
     boost::filesystem::ifstream file(filename, std::ios::binary | std::ios::in);
     Gpx::FileSystem fs(file);
 
-    Gpx::DocumentReader reader(fs.getFileContents("score.gpif"));
+    // The document is parsed in place, so the reader needs its own copy.
+    const boost::string_ref contents = fs.getFileContents("score.gpif");
+    Gpx::DocumentReader reader(
+        std::vector<char>(contents.begin(), contents.end()));
     reader.readScore(score);
 
     ScoreUtils::polishScore(score);
@@ -17,6 +17,7 @@
 
 #include "inputstream.h"
 
+#include <algorithm>
 #include <cassert>
 #include <map>
 
@@ -31,10 +32,20 @@ const std::map<std::string, Gp::Version> theVersionStrings = {
     { "FICHIER GUITAR PRO v5.10", Gp::Version5_1 }
 };
 
-Gp::InputStream::InputStream(std::istream &stream) : myStream(stream)
+Gp::InputStream::InputStream(std::istream &stream) : myPosition(0)
 {
-    myStream.exceptions(std::istream::failbit | std::istream::badbit |
-                       std::istream::eofbit);
+    // Load the entire file, rather than reading a few bytes at a time from the
+    // stream.
+    stream.seekg(0, std::ios::end);
+    const std::streamoff size = stream.tellg();
+    if (!stream || size < 0)
+        throw FileFormatException("Could not read file");
+
+    myData.resize(static_cast<size_t>(size));
+    stream.seekg(0, std::ios::beg);
+    stream.read(myData.data(), size);
+    if (stream.gcount() != size)
+        throw FileFormatException("Could not read file");
 
     const std::string versionString = readVersionString();
 
@@ -45,16 +56,21 @@ Gp::InputStream::InputStream(std::istream &stream) : myStream(stream)
         throw FileFormatException("Unsupported file version: " + versionString);
 }
 
+void Gp::InputStream::throwEndOfFile()
+{
+    throw FileFormatException("Unexpected end of file");
+}
+
 std::string Gp::InputStream::readVersionString()
 {
-    myStream.seekg(std::ios_base::beg);
+    myPosition = 0;
 
     // THe version consists of a 30 character string, although not all 30
     // characters may be used.
     std::string version = readCharacterString<uint8_t>();
 
     // Skip past any unread characters to land at position 0x1f.
-    myStream.seekg(31, std::ios_base::beg);
+    myPosition = 31;
 
     return version;
 }
@@ -78,21 +94,19 @@ std::string Gp::InputStream::readFixedLengthString(uint32_t maxLength)
 {
     const uint8_t actualLength = read<uint8_t>();
 
-    std::string str;
-
-    if (maxLength != 0)
-        str.resize(maxLength);
-    else
-        str.resize(actualLength);
-
-    if (str.size() != 0)
-        myStream.read(&str[0], str.size());
+    // The full field is always consumed, even if the string is shorter.
+    const uint32_t fieldLength = (maxLength != 0) ? maxLength : actualLength;
+    const char *data = readBytes(fieldLength);
 
+    std::string str(data, std::min<uint32_t>(fieldLength, actualLength));
     str.resize(actualLength);
     return str;
 }
 
 void Gp::InputStream::skip(int numBytes)
 {
-    myStream.seekg(numBytes, std::ios_base::cur);
-}
\ No newline at end of file
+    if (numBytes < 0 && static_cast<size_t>(-numBytes) > myPosition)
+        throwEndOfFile();
+
+    myPosition += numBytes;
+}
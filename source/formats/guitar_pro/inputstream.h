@@ -20,7 +20,9 @@
 
 #include <bitset>
 #include <cstdint>
+#include <cstring>
 #include <istream>
+#include <string>
 #include <vector>
 
 #include "document.h"
@@ -30,12 +32,17 @@ namespace Gp
 
 typedef std::bitset<8> Flags;
 
+/// Reads data from a Guitar Pro file. The whole file is loaded into memory
+/// up front, and values are then decoded directly from the buffer.
 class InputStream
 {
 public:
+    /// Loads the contents of the stream.
+    /// @throws FileFormatException
     InputStream(std::istream &stream);
 
     /// Reads simple data (e.g. uint32_t, int16_t) from the input stream.
+    /// @throws FileFormatException if the end of the file is reached.
     template <class T>
     T read();
 
@@ -70,15 +77,33 @@ private:
     template <class LengthPrefixType>
     std::string readCharacterString();
 
-    std::istream &myStream;
+    /// Returns the next n bytes and advances past them.
+    /// @throws FileFormatException if there are fewer than n bytes left.
+    const char *readBytes(size_t n)
+    {
+        if (myPosition > myData.size() || n > myData.size() - myPosition)
+            throwEndOfFile();
+
+        const char *bytes = myData.data() + myPosition;
+        myPosition += n;
+        return bytes;
+    }
+
+    [[noreturn]] static void throwEndOfFile();
+
+    std::vector<char> myData;
+    /// The current offset into the data. This may be past the end of the
+    /// data after a skip.
+    size_t myPosition;
 };
 
 template <class T>
 inline T InputStream::read()
 {
     static_assert(std::is_arithmetic<T>::value, "T must be an arithmetic type");
+    // The data is little-endian, as are all of the supported platforms.
     T data;
-    myStream.read((char *)&data, sizeof(data));
+    std::memcpy(&data, readBytes(sizeof(data)), sizeof(data));
     return data;
 }
 
@@ -89,15 +114,8 @@ inline std::string InputStream::readCharacterString()
                   "LengthPrefixType must be an integral type");
 
     const LengthPrefixType length = read<LengthPrefixType>();
-
-    std::string str;
-    str.resize(length);
-
-    if (length != 0)
-        myStream.read(&str[0], length);
-
-    return str;
+    return std::string(readBytes(length), length);
 }
 }
 
-#endif
\ No newline at end of file
+#endif
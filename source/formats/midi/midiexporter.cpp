@@ -142,9 +142,10 @@ void MidiExporter::writeTrack(std::ostream & os, const MidiEventList & events)
     const std::iostream::pos_type chunk_start_pos = os.tellp();
     for (const MidiEvent &event : events)
     {
-        writeVariableLength(os, event.getTicks());
-        os.write(reinterpret_cast<const char *>(event.getData().data()),
-                 event.getData().size());
+        writeVariableLength(os, static_cast<uint32_t>(event.getTicks()));
+
+        const MidiEvent::Data data = event.getData();
+        os.write(reinterpret_cast<const char *>(data.begin()), data.size());
     }
 
     const std::iostream::pos_type chunk_end_pos = os.tellp();
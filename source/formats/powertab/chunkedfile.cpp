@@ -0,0 +1,477 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "chunkedfile.h"
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/optional/optional.hpp>
+#include <istream>
+#include <iterator>
+#include <memory>
+#include <ostream>
+#include <score/score.h>
+
+namespace
+{
+/// Writes the score, except that only the number of systems is recorded.
+class ScoreOutputArchive : public ScoreUtils::BinaryOutputArchive,
+                           public PartialScoreArchive
+{
+public:
+    ScoreOutputArchive(FileVersion version) : BinaryOutputArchive(version)
+    {
+    }
+
+    using BinaryOutputArchive::operator();
+
+    template <typename Name>
+    void operator()(const Name &, const Score::SystemList &systems)
+    {
+        writeVarUint(systems.size());
+    }
+};
+
+/// Reads the score, and records where the systems should be stored so that
+/// they can be loaded separately.
+class ScoreInputArchive : public ScoreUtils::BinaryInputArchive
+{
+public:
+    ScoreInputArchive(const std::string &data, FileVersion version,
+                      size_t num_systems)
+        : BinaryInputArchive(data.data(), data.data() + data.size(), version),
+          myNumSystems(num_systems),
+          mySystems(nullptr)
+    {
+    }
+
+    using BinaryInputArchive::operator();
+
+    template <typename Name>
+    void operator()(const Name &, Score::SystemList &systems)
+    {
+        if (readVarUint() != myNumSystems)
+        {
+            throw std::runtime_error(
+                "The system count does not match the index");
+        }
+
+        systems.clear();
+        systems.reserve(myNumSystems);
+        for (size_t i = 0; i < myNumSystems; ++i)
+            systems.push_back(std::make_shared<System>());
+        mySystems = &systems;
+    }
+
+    Score::SystemList &getSystems() const
+    {
+        if (!mySystems)
+            throw std::runtime_error("Missing system data");
+        return *mySystems;
+    }
+
+private:
+    const size_t myNumSystems;
+    Score::SystemList *mySystems;
+};
+
+const size_t theBlockSize = 8 + 4 + 4;
+
+void writeUint32(std::ostream &os, uint32_t val)
+{
+    for (int i = 0; i < 4; ++i)
+        os.put(static_cast<char>((val >> (8 * i)) & 0xff));
+}
+
+void writeUint64(std::ostream &os, uint64_t val)
+{
+    for (int i = 0; i < 8; ++i)
+        os.put(static_cast<char>((val >> (8 * i)) & 0xff));
+}
+
+uint64_t readUint(const std::string &data, size_t &offset, int num_bytes)
+{
+    if (data.size() < offset + num_bytes)
+        throw std::runtime_error("Unexpected end of file index");
+
+    uint64_t val = 0;
+    for (int i = 0; i < num_bytes; ++i)
+    {
+        val |= static_cast<uint64_t>(static_cast<uint8_t>(data[offset + i]))
+               << (8 * i);
+    }
+
+    offset += num_bytes;
+    return val;
+}
+
+PowerTab::Chunked::Block readBlock(const std::string &data, size_t &offset)
+{
+    PowerTab::Chunked::Block block;
+    block.myOffset = readUint(data, offset, 8);
+    block.myCompressedSize = static_cast<uint32_t>(readUint(data, offset, 4));
+    block.mySize = static_cast<uint32_t>(readUint(data, offset, 4));
+
+    if (block.myOffset > data.size() ||
+        block.myCompressedSize > data.size() - block.myOffset)
+    {
+        throw std::runtime_error("Invalid block offset");
+    }
+
+    return block;
+}
+
+void writeBlock(std::ostream &os, const PowerTab::Chunked::Block &block)
+{
+    writeUint64(os, block.myOffset);
+    writeUint32(os, block.myCompressedSize);
+    writeUint32(os, block.mySize);
+}
+
+/// Loads systems from the compressed blocks in the file.
+class LazySystemLoader : public SystemLoader
+{
+public:
+    LazySystemLoader(std::string data, PowerTab::Chunked::Index index)
+        : myData(std::move(data)), myIndex(std::move(index))
+    {
+    }
+
+    void load(int index, System &system) override
+    {
+        const PowerTab::Chunked::Block &block = myIndex.mySystemBlocks[index];
+        PowerTab::Chunked::deserializeSystem(
+            PowerTab::Chunked::decompress(myData, block), myIndex.myVersion,
+            system);
+    }
+
+    size_t getMemoryUsage(int index) const override
+    {
+        // The in-memory representation is significantly larger than the
+        // serialized data, but this is a reasonable estimate for the relative
+        // sizes of systems.
+        return myIndex.mySystemBlocks[index].mySize;
+    }
+
+private:
+    const std::string myData;
+    const PowerTab::Chunked::Index myIndex;
+};
+}
+
+namespace PowerTab
+{
+namespace Chunked
+{
+bool hasMagic(std::istream &is)
+{
+    return ScoreUtils::Binary::hasMagic(is, MAGIC);
+}
+
+Index readIndex(const std::string &data)
+{
+    if (data.size() < MAGIC.size() ||
+        !std::equal(MAGIC.begin(), MAGIC.end(), data.begin()))
+    {
+        throw std::runtime_error("Invalid chunked file header");
+    }
+
+    size_t offset = MAGIC.size();
+    const uint64_t version = readUint(data, offset, 4);
+    if (version > static_cast<uint64_t>(FileVersion::LATEST_VERSION) ||
+        version < static_cast<uint64_t>(FileVersion::INITIAL_VERSION))
+    {
+        throw std::runtime_error("Invalid file version");
+    }
+
+    Index index;
+    index.myVersion = static_cast<FileVersion>(version);
+    index.myScoreBlock = readBlock(data, offset);
+
+    const uint64_t num_systems = readUint(data, offset, 4);
+    if (num_systems * theBlockSize > data.size() - offset)
+        throw std::runtime_error("Unexpected end of file index");
+
+    index.mySystemBlocks.reserve(num_systems);
+    for (uint64_t i = 0; i < num_systems; ++i)
+        index.mySystemBlocks.push_back(readBlock(data, offset));
+
+    return index;
+}
+
+std::string compress(const std::string &data)
+{
+    std::string compressed;
+    {
+        boost::iostreams::filtering_ostream output;
+        output.push(boost::iostreams::zlib_compressor());
+        output.push(boost::iostreams::back_inserter(compressed));
+        output.write(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+
+    return compressed;
+}
+
+std::string decompress(const std::string &data, const Block &block)
+{
+    std::string contents;
+    contents.reserve(block.mySize);
+
+    boost::iostreams::filtering_istream input;
+    input.push(boost::iostreams::zlib_decompressor());
+    input.push(boost::iostreams::array_source(data.data() + block.myOffset,
+                                              block.myCompressedSize));
+    boost::iostreams::copy(input, boost::iostreams::back_inserter(contents));
+
+    if (contents.size() != block.mySize)
+        throw std::runtime_error("Invalid block size");
+
+    return contents;
+}
+
+std::string serializeSystem(const System &system, FileVersion version)
+{
+    ScoreUtils::BinaryOutputArchive ar(version);
+    ar.writeObject(system);
+    return ar.data();
+}
+
+void deserializeSystem(const std::string &contents, FileVersion version,
+                       System &system)
+{
+    ScoreUtils::BinaryInputArchive ar(
+        contents.data(), contents.data() + contents.size(), version);
+    ar.readObject(system);
+
+    if (!ar.atEnd())
+        throw std::runtime_error("Unexpected data after system");
+}
+
+/// Writes the file, given the compressed contents of each system.
+static void writeFile(std::ostream &output, const Score &score,
+                      const std::vector<std::string> &system_data,
+                      std::vector<Block> &system_blocks)
+{
+    const FileVersion version = FileVersion::LATEST_VERSION;
+
+    ScoreOutputArchive ar(version);
+    const_cast<Score &>(score).serialize(ar, version);
+    const std::string score_data = compress(ar.data());
+
+    // Compute the offset of each block, which follow the index.
+    uint64_t offset = MAGIC.size() + 4 + theBlockSize + 4 +
+                      theBlockSize * system_blocks.size();
+
+    Block score_block;
+    score_block.myOffset = offset;
+    score_block.myCompressedSize = static_cast<uint32_t>(score_data.size());
+    score_block.mySize = static_cast<uint32_t>(ar.data().size());
+    offset += score_block.myCompressedSize;
+
+    for (Block &block : system_blocks)
+    {
+        block.myOffset = offset;
+        offset += block.myCompressedSize;
+    }
+
+    output.write(MAGIC.data(), MAGIC.size());
+    writeUint32(output, static_cast<uint32_t>(version));
+    writeBlock(output, score_block);
+    writeUint32(output, static_cast<uint32_t>(system_blocks.size()));
+    for (const Block &block : system_blocks)
+        writeBlock(output, block);
+
+    output.write(score_data.data(),
+                 static_cast<std::streamsize>(score_data.size()));
+    for (const std::string &data : system_data)
+        output.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+/// Serializes and compresses the specified systems.
+static void compressSystems(const Score &score,
+                            const std::vector<size_t> &indices,
+                            std::vector<std::string> &system_data,
+                            std::vector<Block> &system_blocks,
+                            unsigned int num_threads)
+{
+    auto systems = score.getSystems();
+
+    Util::parallelFor(indices.size(), [&](size_t i) {
+        const size_t index = indices[i];
+        const std::string contents =
+            serializeSystem(systems[index], FileVersion::LATEST_VERSION);
+        system_data[index] = compress(contents);
+        system_blocks[index].mySize = static_cast<uint32_t>(contents.size());
+        system_blocks[index].myCompressedSize =
+            static_cast<uint32_t>(system_data[index].size());
+    }, num_threads);
+}
+
+void save(std::ostream &output, const Score &score, unsigned int num_threads)
+{
+    const size_t num_systems = score.getSystems().size();
+    std::vector<std::string> system_data(num_systems);
+    std::vector<Block> system_blocks(num_systems);
+
+    std::vector<size_t> indices(num_systems);
+    for (size_t i = 0; i < num_systems; ++i)
+        indices[i] = i;
+
+    compressSystems(score, indices, system_data, system_blocks, num_threads);
+    writeFile(output, score, system_data, system_blocks);
+}
+
+/// Reads the file index and everything except for the systems.
+static Score::SystemList &loadScore(const std::string &data,
+                                    const Index &index, Score &score)
+{
+    const std::string score_data = decompress(data, index.myScoreBlock);
+    ScoreInputArchive ar(score_data, index.myVersion,
+                         index.mySystemBlocks.size());
+    score.serialize(ar, index.myVersion);
+
+    if (!ar.atEnd())
+        throw std::runtime_error("Unexpected data after score");
+
+    return ar.getSystems();
+}
+
+static std::string readFile(std::istream &input)
+{
+    if (!input)
+        throw std::runtime_error("Could not open stream");
+
+    return std::string((std::istreambuf_iterator<char>(input)),
+                       std::istreambuf_iterator<char>());
+}
+
+void load(std::istream &input, Score &score, unsigned int num_threads)
+{
+    const std::string data = readFile(input);
+    const Index index = readIndex(data);
+
+    Score::SystemList &systems = loadScore(data, index, score);
+    Util::parallelFor(systems.size(), [&](size_t i) {
+        deserializeSystem(decompress(data, index.mySystemBlocks[i]),
+                          index.myVersion, *systems[i]);
+    }, num_threads);
+}
+
+void loadLazy(std::istream &input, Score &score, size_t memory_budget)
+{
+    std::string data = readFile(input);
+    Index index = readIndex(data);
+
+    loadScore(data, index, score);
+
+    std::unique_ptr<SystemLoader> loader(
+        new LazySystemLoader(std::move(data), std::move(index)));
+    score.setSystemLoader(std::move(loader), memory_budget);
+}
+void saveChanges(const boost::filesystem::path &filename, const Score &score,
+                 const std::vector<int> &modified_systems,
+                 unsigned int num_threads)
+{
+    const size_t num_systems = score.getSystems().size();
+    std::vector<std::string> system_data(num_systems);
+    std::vector<Block> system_blocks(num_systems);
+    std::vector<size_t> indices;
+
+    // Reuse the blocks from the existing file if it has the same systems.
+    std::string data;
+    boost::optional<Index> index;
+    {
+        boost::filesystem::ifstream file(filename,
+                                         std::ios::in | std::ios::binary);
+        if (file && hasMagic(file))
+        {
+            data = readFile(file);
+
+            try
+            {
+                index = readIndex(data);
+            }
+            catch (const std::exception &)
+            {
+            }
+        }
+    }
+
+    if (index && index->myVersion == FileVersion::LATEST_VERSION &&
+        index->mySystemBlocks.size() == num_systems)
+    {
+        std::vector<bool> modified(num_systems, false);
+        for (int i : modified_systems)
+        {
+            if (i >= 0 && static_cast<size_t>(i) < num_systems)
+                modified[i] = true;
+        }
+
+        for (size_t i = 0; i < num_systems; ++i)
+        {
+            if (modified[i])
+                indices.push_back(i);
+            else
+            {
+                const Block &block = index->mySystemBlocks[i];
+                system_data[i] =
+                    data.substr(block.myOffset, block.myCompressedSize);
+                system_blocks[i] = block;
+            }
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < num_systems; ++i)
+            indices.push_back(i);
+    }
+
+    compressSystems(score, indices, system_data, system_blocks, num_threads);
+
+    // Write to a temporary file and then replace the original file, so that
+    // the original file is left intact if anything goes wrong.
+    boost::filesystem::path temp_path = filename;
+    temp_path += boost::filesystem::unique_path(".%%%%-%%%%.tmp");
+
+    try
+    {
+        {
+            boost::filesystem::ofstream file(temp_path,
+                                             std::ios::out | std::ios::binary);
+            writeFile(file, score, system_data, system_blocks);
+
+            file.flush();
+            if (!file)
+                throw std::runtime_error("Could not write file");
+        }
+
+        boost::filesystem::rename(temp_path, filename);
+    }
+    catch (...)
+    {
+        boost::system::error_code ec;
+        boost::filesystem::remove(temp_path, ec);
+        throw;
+    }
+}
+}
+}
@@ -0,0 +1,110 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FORMATS_POWERTAB_CHUNKEDFILE_H
+#define FORMATS_POWERTAB_CHUNKEDFILE_H
+
+#include <array>
+#include <boost/filesystem/path.hpp>
+#include <cstdint>
+#include <iosfwd>
+#include <score/binaryserialization.h>
+#include <string>
+#include <util/parallel.h>
+#include <vector>
+
+class Score;
+class System;
+
+/// A variant of the binary archive where each system is stored in a separate,
+/// individually compressed block. An index at the start of the file records
+/// the location of each block, so that the systems can be decompressed and
+/// deserialized independently (e.g. in parallel).
+///
+/// Layout (all integers are little-endian):
+///   - The 'PTC2' header and the file version (uint32).
+///   - The block containing the rest of the score.
+///   - The number of systems (uint32), followed by a block for each system.
+/// Each block is described by its offset from the start of the file (uint64),
+/// its compressed size (uint32), and its uncompressed size (uint32).
+namespace PowerTab
+{
+namespace Chunked
+{
+    const std::array<char, 4> MAGIC = {{ 'P', 'T', 'C', '2' }};
+
+    /// Location of a compressed block within the file.
+    struct Block
+    {
+        uint64_t myOffset;
+        uint32_t myCompressedSize;
+        uint32_t mySize;
+    };
+
+    /// The file header and block index.
+    struct Index
+    {
+        FileVersion myVersion;
+        Block myScoreBlock;
+        std::vector<Block> mySystemBlocks;
+    };
+
+    /// Returns whether the stream begins with the chunked file header.
+    bool hasMagic(std::istream &is);
+
+    /// Parses the header and block index from the start of the file data.
+    Index readIndex(const std::string &data);
+
+    /// Compresses the data for a block.
+    std::string compress(const std::string &data);
+
+    /// Decompresses the contents of a block.
+    std::string decompress(const std::string &data, const Block &block);
+
+    /// Serializes a single system into the (uncompressed) contents of a block.
+    std::string serializeSystem(const System &system, FileVersion version);
+
+    /// Deserializes a system from the (uncompressed) contents of a block.
+    void deserializeSystem(const std::string &contents, FileVersion version,
+                           System &system);
+
+    /// Writes the score, compressing the systems across several threads.
+    void save(std::ostream &output, const Score &score,
+              unsigned int num_threads = Util::defaultThreadCount());
+
+    /// Loads the score, decompressing and deserializing the systems across
+    /// several threads.
+    void load(std::istream &input, Score &score,
+              unsigned int num_threads = Util::defaultThreadCount());
+
+    /// Loads the score, but only deserializes each system the first time
+    /// that it is accessed (see Score::setSystemLoader()).
+    void loadLazy(std::istream &input, Score &score, size_t memory_budget);
+
+    /// Writes the score to a file that it was previously saved to or loaded
+    /// from, where only the given systems have been modified since then. If
+    /// the existing file has the same systems, the compressed blocks for the
+    /// unmodified systems are copied as-is rather than being serialized again.
+    /// The new file replaces the existing file with an atomic rename.
+    void saveChanges(const boost::filesystem::path &filename,
+                     const Score &score,
+                     const std::vector<int> &modified_systems,
+                     unsigned int num_threads = Util::defaultThreadCount());
+}
+}
+
+#endif
@@ -17,21 +17,59 @@
 
 #include "powertabexporter.h"
 
+#include "chunkedfile.h"
 #include "common.h"
+#include <app/settingsmanager.h>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/filtering_streambuf.hpp>
+#include <formats/settings.h>
+#include <score/binaryserialization.h>
 #include <score/score.h>
 #include <score/serialization.h>
 
-PowerTabExporter::PowerTabExporter()
-    : FileFormatExporter(getPowerTabFileFormat())
+PowerTabExporter::PowerTabExporter(Encoding encoding)
+    : FileFormatExporter(getPowerTabFileFormat()),
+      myEncoding(encoding),
+      mySettingsManager(nullptr)
 {
 }
 
+PowerTabExporter::PowerTabExporter(const SettingsManager &settings_manager)
+    : FileFormatExporter(getPowerTabFileFormat()),
+      myEncoding(Encoding::Json),
+      mySettingsManager(&settings_manager)
+{
+}
+
+PowerTabExporter::Encoding PowerTabExporter::getEncoding() const
+{
+    if (!mySettingsManager)
+        return myEncoding;
+
+    auto settings = mySettingsManager->getReadHandle();
+    return static_cast<Encoding>(settings->get(Settings::PowerTabEncoding));
+}
+
 void PowerTabExporter::save(const boost::filesystem::path &filename,
                             const Score &score)
 {
+    const Encoding encoding = getEncoding();
+    if (encoding == Encoding::Binary)
+    {
+        boost::filesystem::ofstream file(filename,
+                                         std::ios::out | std::ios::binary);
+        ScoreUtils::saveBinary(file, score);
+        return;
+    }
+    else if (encoding == Encoding::Chunked)
+    {
+        boost::filesystem::ofstream file(filename,
+                                         std::ios::out | std::ios::binary);
+        PowerTab::Chunked::save(file, score);
+        return;
+    }
+
     // Use gzip to compress the resulting data.
     boost::filesystem::ofstream file(filename,
                                      std::ios::out | std::ios::binary);
@@ -42,3 +80,13 @@ void PowerTabExporter::save(const boost::filesystem::path &filename,
     std::ostream compressed_output(&out);
     ScoreUtils::save(compressed_output, "score", score);
 }
+
+void PowerTabExporter::saveChanges(const boost::filesystem::path &filename,
+                                   const Score &score,
+                                   const std::vector<int> &modified_systems)
+{
+    if (getEncoding() == Encoding::Chunked)
+        PowerTab::Chunked::saveChanges(filename, score, modified_systems);
+    else
+        save(filename, score);
+}
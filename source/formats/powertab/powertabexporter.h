@@ -23,10 +23,31 @@
 class PowerTabExporter : public FileFormatExporter
 {
 public:
-    PowerTabExporter();
+    /// The on-disk representation of the score.
+    enum class Encoding : int
+    {
+        Json = 0,   ///< Gzip-compressed JSON.
+        Binary = 1, ///< Compact binary archive (see binaryserialization.h).
+        Chunked = 2 ///< Separately compressed systems (see chunkedfile.h).
+    };
+
+    PowerTabExporter(Encoding encoding = Encoding::Json);
+    /// Reads the encoding from the settings each time a file is saved.
+    PowerTabExporter(const SettingsManager &settings_manager);
 
     virtual void save(const boost::filesystem::path &filename,
                       const Score &score) override;
+
+    /// For chunked files, only the modified systems are written again.
+    virtual void saveChanges(const boost::filesystem::path &filename,
+                             const Score &score,
+                             const std::vector<int> &modified_systems) override;
+
+private:
+    Encoding getEncoding() const;
+
+    const Encoding myEncoding;
+    const SettingsManager *mySettingsManager;
 };
 
 #endif
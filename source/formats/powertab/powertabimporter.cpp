@@ -17,25 +17,62 @@
 
 #include "powertabimporter.h"
 
+#include "chunkedfile.h"
 #include "common.h"
 
+#include <algorithm>
+#include <app/settingsmanager.h>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/iostreams/filtering_streambuf.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
+#include <formats/settings.h>
+#include <score/binaryserialization.h>
 #include <score/score.h>
 #include <score/serialization.h>
 
 PowerTabImporter::PowerTabImporter()
-    : FileFormatImporter(getPowerTabFileFormat())
+    : FileFormatImporter(getPowerTabFileFormat()),
+      mySettingsManager(nullptr)
+{
+}
+
+PowerTabImporter::PowerTabImporter(const SettingsManager &settings_manager)
+    : FileFormatImporter(getPowerTabFileFormat()),
+      mySettingsManager(&settings_manager)
 {
 }
 
 void PowerTabImporter::load(const boost::filesystem::path &filename,
                             Score &score)
 {
-    // The files are compressed by gzip, so we need to uncompress them before
-    // loading the data.
     boost::filesystem::ifstream file(filename, std::ios::in | std::ios::binary);
+
+    // Binary archives are identified by their header.
+    if (ScoreUtils::Binary::hasMagic(file))
+    {
+        ScoreUtils::loadBinary(file, score);
+        return;
+    }
+    else if (PowerTab::Chunked::hasMagic(file))
+    {
+        if (mySettingsManager)
+        {
+            auto settings = mySettingsManager->getReadHandle();
+            if (settings->get(Settings::LazyLoading))
+            {
+                const size_t budget = static_cast<size_t>(std::max(
+                    0, settings->get(Settings::LazyLoadingMemoryBudget)));
+                PowerTab::Chunked::loadLazy(file, score, budget * 1024 * 1024);
+                return;
+            }
+        }
+
+        PowerTab::Chunked::load(file, score);
+        return;
+    }
+
+    // Otherwise, the files are compressed by gzip, so we need to uncompress
+    // them before loading the data.
     boost::iostreams::filtering_istreambuf in;
     in.push(boost::iostreams::gzip_decompressor());
     in.push(file);
@@ -20,13 +20,20 @@
 
 #include <formats/fileformatmanager.h>
 
+class SettingsManager;
+
 class PowerTabImporter : public FileFormatImporter
 {
 public:
     PowerTabImporter();
+    /// Uses the lazy loading settings from the settings manager.
+    PowerTabImporter(const SettingsManager &settings_manager);
 
     virtual void load(const boost::filesystem::path &filename,
                       Score &score) override;
+
+private:
+    const SettingsManager *mySettingsManager;
 };
 
 #endif
@@ -0,0 +1,39 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FORMATS_SETTINGS_H
+#define FORMATS_SETTINGS_H
+
+#include <util/settingstree.h>
+
+/// File format settings and their default values.
+namespace Settings
+{
+    /// The encoding used when saving Power Tab files
+    /// (a PowerTabExporter::Encoding value).
+    extern const Setting<int> PowerTabEncoding;
+
+    /// Whether systems in chunked Power Tab files are only loaded once they
+    /// are needed.
+    extern const Setting<bool> LazyLoading;
+
+    /// The approximate amount of memory (in MB) that can be used by systems
+    /// that are loaded on demand before unmodified systems are unloaded.
+    extern const Setting<int> LazyLoadingMemoryBudget;
+}
+
+#endif
@@ -17,6 +17,7 @@
   
 #include "midievent.h"
 
+#include <algorithm>
 #include <cassert>
 
 enum Controller : uint8_t
@@ -41,20 +42,21 @@ static const uint8_t theSysExManufacturerId = 0x7d;
 static const uint8_t theChannelMask = 0x0f;
 static const uint8_t theStatusByteMask = ~theChannelMask;
 
-MidiEvent::MidiEvent(int ticks, std::vector<uint8_t> data,
-                     const SystemLocation &location, int player, int instrument)
+MidiEvent::MidiEvent(int64_t ticks, std::initializer_list<uint8_t> data,
+                     const SystemLocation &location)
     : myTicks(ticks),
-      myData(std::move(data)),
       myLocation(location),
-      myPlayer(player),
-      myInstrument(instrument)
+      myData(),
+      mySize(static_cast<uint8_t>(data.size()))
 {
+    assert(data.size() <= MAX_DATA_SIZE);
+    std::copy(data.begin(), data.end(), myData.begin());
 }
 
-MidiEvent MidiEvent::endOfTrack(int ticks)
+MidiEvent MidiEvent::endOfTrack(int64_t ticks)
 {
     return MidiEvent(ticks, { StatusByte::MetaMessage, MetaType::TrackEnd, 0 },
-                     SystemLocation(), -1, -1);
+                     SystemLocation());
 }
 
 bool MidiEvent::isTempoChange() const
@@ -75,7 +77,7 @@ bool MidiEvent::isProgramChange() const
     return (getStatusByte() & theStatusByteMask) == StatusByte::ProgramChange;
 }
 
-MidiEvent MidiEvent::setTempo(int ticks, int microseconds)
+MidiEvent MidiEvent::setTempo(int64_t ticks, int microseconds)
 {
     const uint32_t val = microseconds;
     return MidiEvent(ticks, { StatusByte::MetaMessage,
@@ -83,73 +85,76 @@ MidiEvent MidiEvent::setTempo(int ticks, int microseconds)
                               static_cast<uint8_t>((val >> 16) & 0xff),
                               static_cast<uint8_t>((val >> 8) & 0xff),
                               static_cast<uint8_t>(val & 0xff) },
-                     SystemLocation(), -1, -1);
+                     SystemLocation());
 }
 
-MidiEvent MidiEvent::noteOn(int ticks, uint8_t channel, uint8_t pitch,
+MidiEvent MidiEvent::noteOn(int64_t ticks, uint8_t channel, uint8_t pitch,
                             uint8_t velocity, const SystemLocation &location)
 {
     return MidiEvent(
         ticks,
         { static_cast<uint8_t>(StatusByte::NoteOn + channel), pitch, velocity },
-        location, -1, -1);
+        location);
 }
 
-MidiEvent MidiEvent::noteOff(int ticks, uint8_t channel, uint8_t pitch,
+MidiEvent MidiEvent::noteOff(int64_t ticks, uint8_t channel, uint8_t pitch,
                              const SystemLocation &location)
 {
     return MidiEvent(
         ticks,
         { static_cast<uint8_t>(StatusByte::NoteOff + channel), pitch, 127 },
-        location, -1, -1);
+        location);
 }
 
-MidiEvent MidiEvent::volumeChange(int ticks, uint8_t channel, uint8_t level)
+MidiEvent MidiEvent::volumeChange(int64_t ticks, uint8_t channel,
+                                  uint8_t level)
 {
     return MidiEvent(
         ticks, { static_cast<uint8_t>(StatusByte::ControlChange + channel),
                  Controller::ChannelVolume, level },
-        SystemLocation(), -1, -1);
+        SystemLocation());
 }
 
-MidiEvent MidiEvent::programChange(int ticks, uint8_t channel, uint8_t preset)
+MidiEvent MidiEvent::programChange(int64_t ticks, uint8_t channel,
+                                   uint8_t preset)
 {
     return MidiEvent(
         ticks,
         { static_cast<uint8_t>(StatusByte::ProgramChange + channel), preset },
-        SystemLocation(), -1, -1);
+        SystemLocation());
 }
 
-MidiEvent MidiEvent::modWheel(int ticks, uint8_t channel, uint8_t width)
+MidiEvent MidiEvent::modWheel(int64_t ticks, uint8_t channel, uint8_t width)
 {
     return MidiEvent(
         ticks, { static_cast<uint8_t>(StatusByte::ControlChange + channel),
                  Controller::ModWheel, width },
-        SystemLocation(), -1, -1);
+        SystemLocation());
 }
 
-MidiEvent MidiEvent::holdPedal(int ticks, uint8_t channel, bool enabled)
+MidiEvent MidiEvent::holdPedal(int64_t ticks, uint8_t channel, bool enabled)
 {
     return MidiEvent(
         ticks,
         { static_cast<uint8_t>(StatusByte::ControlChange + channel),
           Controller::HoldPedal, static_cast<uint8_t>(enabled ? 127 : 0) },
-        SystemLocation(), -1, -1);
+        SystemLocation());
 }
 
-MidiEvent MidiEvent::pitchWheel(int ticks, uint8_t channel, uint8_t amount)
+MidiEvent MidiEvent::pitchWheel(int64_t ticks, uint8_t channel, uint8_t amount)
 {
     return MidiEvent(
         ticks,
         { static_cast<uint8_t>(StatusByte::PitchWheel + channel), 0, amount },
-        SystemLocation(), -1, -1);
+        SystemLocation());
 }
 
-MidiEvent MidiEvent::positionChange(int ticks, const SystemLocation &location)
+MidiEvent MidiEvent::positionChange(int64_t ticks,
+                                    const SystemLocation &location)
 {
     return MidiEvent(
         ticks, { StatusByte::SysEx, theSysExManufacturerId, theSysExMsgEnd },
-        location, -1, -1);
+        location);
 }
 
 bool MidiEvent::isPositionChange() const
@@ -169,25 +174,26 @@ uint8_t MidiEvent::getChannel() const
     return getStatusByte() & theChannelMask;
 }
 
-std::vector<MidiEvent> MidiEvent::pitchWheelRange(int ticks, uint8_t channel,
+std::vector<MidiEvent> MidiEvent::pitchWheelRange(int64_t ticks,
+                                                  uint8_t channel,
                                                   uint8_t semitones)
 {
     return {
         MidiEvent(ticks,
                   { static_cast<uint8_t>(StatusByte::ControlChange + channel),
                     Controller::RpnMsb, 0 },
-                  SystemLocation(), -1, -1),
+                  SystemLocation()),
         MidiEvent(ticks,
                   { static_cast<uint8_t>(StatusByte::ControlChange + channel),
                     Controller::RpnLsb, 0 },
-                  SystemLocation(), -1, -1),
+                  SystemLocation()),
         MidiEvent(ticks,
                   { static_cast<uint8_t>(StatusByte::ControlChange + channel),
                     Controller::DataEntryCoarse, semitones },
-                  SystemLocation(), -1, -1),
+                  SystemLocation()),
         MidiEvent(ticks,
                   { static_cast<uint8_t>(StatusByte::ControlChange + channel),
                     Controller::DataEntryFine, 0 },
-                  SystemLocation(), -1, -1),
+                  SystemLocation()),
     };
 }
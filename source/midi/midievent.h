@@ -20,12 +20,26 @@
 
 #include <score/systemlocation.h>
 
+#include <array>
+#include <boost/range/iterator_range_core.hpp>
 #include <cstdint>
+#include <initializer_list>
 #include <vector>
 
+/// A MIDI message and its timestamp.
+/// Events are fixed-size and trivially copyable, so that generating, sorting
+/// and merging large lists of events does not require a heap allocation for
+/// each event. The message is stored inline, since every message that is
+/// generated (including the meta messages and the SysEx message used for
+/// position changes) is at most MAX_DATA_SIZE bytes long.
 class MidiEvent
 {
 public:
+    /// The size of the longest message (a tempo change).
+    static const size_t MAX_DATA_SIZE = 6;
+
+    typedef boost::iterator_range<const uint8_t *> Data;
+
     enum StatusByte : uint8_t
     {
         NoteOff = 0x80,
@@ -42,10 +56,13 @@ public:
         return myTicks < other.myTicks;
     }
 
-    int getTicks() const { return myTicks; }
-    void setTicks(int ticks) { myTicks = ticks; }
+    int64_t getTicks() const { return myTicks; }
+    void setTicks(int64_t ticks) { myTicks = ticks; }
     uint8_t getStatusByte() const { return myData[0]; }
-    const std::vector<uint8_t> &getData() const { return myData; }
+    Data getData() const
+    {
+        return Data(myData.data(), myData.data() + mySize);
+    }
     const SystemLocation &getLocation() const { return myLocation; }
 
     bool isTempoChange() const;
@@ -55,31 +72,34 @@ public:
     bool isNoteOnOff() const;
     uint8_t getChannel() const;
 
-    static MidiEvent endOfTrack(int ticks);
-    static MidiEvent setTempo(int ticks, int microseconds);
-    static MidiEvent noteOn(int ticks, uint8_t channel, uint8_t pitch,
+    static MidiEvent endOfTrack(int64_t ticks);
+    static MidiEvent setTempo(int64_t ticks, int microseconds);
+    static MidiEvent noteOn(int64_t ticks, uint8_t channel, uint8_t pitch,
                             uint8_t velocity, const SystemLocation &location);
-    static MidiEvent noteOff(int ticks, uint8_t channel, uint8_t pitch,
+    static MidiEvent noteOff(int64_t ticks, uint8_t channel, uint8_t pitch,
                              const SystemLocation &location);
-    static MidiEvent volumeChange(int ticks, uint8_t channel, uint8_t level);
-    static MidiEvent programChange(int ticks, uint8_t channel, uint8_t preset);
-    static MidiEvent modWheel(int ticks, uint8_t channel, uint8_t width);
-    static MidiEvent holdPedal(int ticks, uint8_t channel, bool enabled);
-    static MidiEvent pitchWheel(int ticks, uint8_t channel, uint8_t amount);
-    static MidiEvent positionChange(int ticks, const SystemLocation &location);
-    static std::vector<MidiEvent> pitchWheelRange(int ticks, uint8_t channel,
+    static MidiEvent volumeChange(int64_t ticks, uint8_t channel,
+                                  uint8_t level);
+    static MidiEvent programChange(int64_t ticks, uint8_t channel,
+                                   uint8_t preset);
+    static MidiEvent modWheel(int64_t ticks, uint8_t channel, uint8_t width);
+    static MidiEvent holdPedal(int64_t ticks, uint8_t channel, bool enabled);
+    static MidiEvent pitchWheel(int64_t ticks, uint8_t channel,
+                                uint8_t amount);
+    static MidiEvent positionChange(int64_t ticks,
+                                    const SystemLocation &location);
+    static std::vector<MidiEvent> pitchWheelRange(int64_t ticks,
+                                                  uint8_t channel,
                                                   uint8_t semitones);
 
 private:
-    MidiEvent(int ticks, std::vector<uint8_t> data,
-              const SystemLocation &location, int player, int instrument);
-
-    int myTicks; // TODO - does this need to be 64-bit for absolute times?
-    std::vector<uint8_t> myData;
+    MidiEvent(int64_t ticks, std::initializer_list<uint8_t> data,
+              const SystemLocation &location);
 
+    int64_t myTicks;
     SystemLocation myLocation;
-    int myPlayer;
-    int myInstrument;
+    std::array<uint8_t, MAX_DATA_SIZE> myData;
+    uint8_t mySize;
 };
 
 #endif
@@ -0,0 +1,86 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "midieventcache.h"
+
+#include <limits>
+
+MidiEventCache::MidiEventCache() : myTicksPerBeat(0)
+{
+}
+
+void MidiEventCache::setOptions(const MidiFile::LoadOptions &options,
+                                int ticks_per_beat)
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+
+    if (options != myOptions || ticks_per_beat != myTicksPerBeat)
+    {
+        myOptions = options;
+        myTicksPerBeat = ticks_per_beat;
+        myEntries.clear();
+    }
+}
+
+std::shared_ptr<const MidiEventCache::Entry> MidiEventCache::find(
+    const Key &key, int tempo, uint8_t start_bend,
+    const PlayerChange *players) const
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+
+    auto it = myEntries.find(key);
+    if (it == myEntries.end())
+        return nullptr;
+
+    const Entry &entry = *it->second;
+    if (entry.myTempo != tempo || entry.myStartBend != start_bend ||
+        entry.myPlayers.is_initialized() != (players != nullptr) ||
+        (players && !(*entry.myPlayers == *players)))
+    {
+        return nullptr;
+    }
+
+    return it->second;
+}
+
+void MidiEventCache::insert(const Key &key, std::shared_ptr<const Entry> entry)
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+    myEntries[key] = std::move(entry);
+}
+
+void MidiEventCache::invalidateSystem(int system)
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+
+    const int min = std::numeric_limits<int>::min();
+    myEntries.erase(
+        myEntries.lower_bound(std::make_tuple(system - 1, min, min, min)),
+        myEntries.lower_bound(std::make_tuple(system + 2, min, min, min)));
+}
+
+void MidiEventCache::clear()
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+    myEntries.clear();
+}
+
+size_t MidiEventCache::size() const
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+    return myEntries.size();
+}
@@ -0,0 +1,91 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MIDI_MIDIEVENTCACHE_H
+#define MIDI_MIDIEVENTCACHE_H
+
+#include <boost/optional/optional.hpp>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <midi/midifile.h>
+#include <mutex>
+#include <score/playerchange.h>
+#include <tuple>
+#include <vector>
+
+/// Caches the events that were generated for each bar of a voice, so that
+/// after the score is edited only the modified systems need to be
+/// regenerated.
+///
+/// Besides the contents of its system, a bar's events depend on the adjacent
+/// systems (for ties and slides between systems), the players that are
+/// active at the start of the bar, and the tempo and pitch bend at the start
+/// of the bar. The events are stored relative to the start of the bar, so
+/// they can be reused when the bar is played at a different time (e.g. when
+/// repeated, or after an earlier bar's duration has changed).
+class MidiEventCache
+{
+public:
+    /// The system index, bar position, staff index, and voice index.
+    typedef std::tuple<int, int, int, int> Key;
+
+    struct Entry
+    {
+        /// The state at the start of the bar that the events depend on.
+        int myTempo;
+        uint8_t myStartBend;
+        boost::optional<PlayerChange> myPlayers;
+
+        /// The events for each player's track, with ticks relative to the
+        /// start of the bar.
+        std::vector<MidiEventList> myTracks;
+        /// The pitch bend and the number of ticks at the end of the bar.
+        uint8_t myEndBend;
+        int myDuration;
+    };
+
+    MidiEventCache();
+
+    /// Clears the cache if the options differ from the options that were
+    /// used to generate the cached events.
+    void setOptions(const MidiFile::LoadOptions &options, int ticks_per_beat);
+
+    /// Returns the cached events for the bar, if they were generated with
+    /// the same tempo, pitch bend and players.
+    std::shared_ptr<const Entry> find(const Key &key, int tempo,
+                                      uint8_t start_bend,
+                                      const PlayerChange *players) const;
+
+    void insert(const Key &key, std::shared_ptr<const Entry> entry);
+
+    /// Discards the events for the system and its adjacent systems.
+    void invalidateSystem(int system);
+    /// Discards all of the events (e.g. after systems are inserted or
+    /// removed, or a player is edited).
+    void clear();
+
+    size_t size() const;
+
+private:
+    mutable std::mutex myMutex;
+    MidiFile::LoadOptions myOptions;
+    int myTicksPerBeat;
+    std::map<Key, std::shared_ptr<const Entry>> myEntries;
+};
+
+#endif
@@ -19,6 +19,8 @@
 
 #include <algorithm>
 #include <cassert>
+#include <functional>
+#include <queue>
 
 MidiEventList::MidiEventList(bool absolute_ticks)
     : myAbsoluteTicks(absolute_ticks)
@@ -34,12 +36,14 @@ void MidiEventList::convertToDeltaTicks()
         return;
 
     // First, sort by timestamp. Events for different voices may have been added
-    // out of order.
-    std::stable_sort(myEvents.begin(), myEvents.end(),
-                     [](const MidiEvent &a, const MidiEvent &b)
-                     {
-                         return a.getTicks() < b.getTicks();
-                     });
+    // out of order, but the events are often already sorted (e.g. after
+    // merging several lists).
+    auto compare = [](const MidiEvent &a, const MidiEvent &b) {
+        return a.getTicks() < b.getTicks();
+    };
+
+    if (!std::is_sorted(myEvents.begin(), myEvents.end(), compare))
+        std::stable_sort(myEvents.begin(), myEvents.end(), compare);
 
     for (size_t i = myEvents.size() - 1; i >= 1; --i)
     {
@@ -67,3 +71,65 @@ void MidiEventList::concat(const MidiEventList &other)
     myEvents.insert(myEvents.end(), other.myEvents.begin(),
                     other.myEvents.end());
 }
+
+namespace
+{
+/// The next unmerged event from one of the lists.
+struct MergeCursor
+{
+    int64_t myTicks; ///< Absolute ticks of the event.
+    size_t myList;
+    size_t myIndex;
+
+    /// Orders the cursors so that the priority queue returns the earliest
+    /// event, and the list with the lowest index if there is a tie.
+    bool operator>(const MergeCursor &other) const
+    {
+        return myTicks != other.myTicks ? myTicks > other.myTicks
+                                        : myList > other.myList;
+    }
+};
+}
+
+MidiEventList MidiEventList::merge(const std::vector<MidiEventList> &lists)
+{
+    MidiEventList merged;
+
+    size_t total_size = 0;
+    for (const MidiEventList &list : lists)
+        total_size += list.myEvents.size();
+    merged.myEvents.reserve(total_size);
+
+    std::priority_queue<MergeCursor, std::vector<MergeCursor>,
+                        std::greater<MergeCursor>> queue;
+
+    for (size_t i = 0; i < lists.size(); ++i)
+    {
+        if (!lists[i].myEvents.empty())
+            queue.push({ lists[i].myEvents.front().getTicks(), i, 0 });
+    }
+
+    while (!queue.empty())
+    {
+        const MergeCursor cursor = queue.top();
+        queue.pop();
+
+        const std::vector<MidiEvent> &events = lists[cursor.myList].myEvents;
+        merged.myEvents.push_back(events[cursor.myIndex]);
+        merged.myEvents.back().setTicks(cursor.myTicks);
+
+        // Advance to the next event in the list, converting from delta ticks
+        // if necessary.
+        const size_t next = cursor.myIndex + 1;
+        if (next < events.size())
+        {
+            int64_t ticks = events[next].getTicks();
+            if (!lists[cursor.myList].myAbsoluteTicks)
+                ticks += cursor.myTicks;
+
+            queue.push({ ticks, cursor.myList, next });
+        }
+    }
+
+    return merged;
+}
@@ -38,6 +38,16 @@ public:
     }
 
     void concat(const MidiEventList &other);
+    void clear() { myEvents.clear(); }
+
+    /// Merges several lists of events, which must each be sorted by time (in
+    /// either absolute or delta ticks), into a single list with absolute
+    /// ticks. Events with the same time are ordered by the index of their
+    /// list and then by their order within the list, which is equivalent to
+    /// concatenating the lists and performing a stable sort.
+    static MidiEventList merge(const std::vector<MidiEventList> &lists);
+
+    size_t size() const { return myEvents.size(); }
 
     typedef std::vector<MidiEvent>::iterator iterator;
     typedef std::vector<MidiEvent>::const_iterator const_iterator;
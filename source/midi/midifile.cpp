@@ -17,9 +17,11 @@
   
 #include "midifile.h"
 
-#include "repeatcontroller.h"
+#include "midieventcache.h"
 
+#include <algorithm>
 #include <boost/rational.hpp>
+#include <cassert>
 
 #include <score/generalmidi.h>
 #include <score/score.h>
@@ -68,163 +70,286 @@ static int getChannel(const ActivePlayer &player)
     return getChannel(player.getPlayerNumber());
 }
 
-static bool findPositionChange(MidiEventList &event_list, int ticks,
-                               bool record_position_changes,
-                               RepeatController &repeat_controller,
-                               const SystemLocation &prev_location,
-                               SystemLocation &location)
+MidiFile::Generator::Generator(MidiFile &file, const Score &score,
+                               const LoadOptions &options,
+                               std::shared_ptr<MidiEventCache> cache)
+    : myFile(file),
+      myScore(score),
+      myOptions(options),
+      myCache(std::move(cache)),
+      myPlayOrder(score),
+      myBarIndex(0),
+      myLocation(0, 0),
+      mySystemIndex(-1),
+      myCurrentTick(0),
+      myCurrentTempo(Midi::BEAT_DURATION_120_BPM),
+      myPlayerTracks(score.getPlayers().size())
 {
-    SystemLocation new_location;
-    if (repeat_controller.checkForRepeat(prev_location, location, new_location))
+    myFile.myTicksPerBeat = DEFAULT_PPQ;
+    if (myCache)
+        myCache->setOptions(myOptions, myFile.myTicksPerBeat);
+
+    // Set the initial channel volume and pitch bend range..
+    for (unsigned int i = 0; i < score.getPlayers().size(); ++i)
     {
-        if (record_position_changes)
+        myPlayerTracks[i].append(
+            MidiEvent::volumeChange(0, getChannel(i), Dynamic::fff));
+
+        for (const MidiEvent &event :
+             MidiEvent::pitchWheelRange(0, getChannel(i), PITCH_BEND_RANGE))
         {
-            event_list.append(MidiEvent::positionChange(ticks, new_location));
+            myPlayerTracks[i].append(event);
         }
+    }
+}
 
-        location = new_location;
-        return true;
+MidiFile::Generator::~Generator()
+{
+}
+
+MidiFile::Generator::Checkpoint MidiFile::Generator::getCheckpoint() const
+{
+    Checkpoint checkpoint;
+    checkpoint.myBarIndex = myBarIndex;
+    checkpoint.myLocation = myLocation;
+    checkpoint.mySystemIndex = mySystemIndex;
+    checkpoint.myTick = myCurrentTick;
+    checkpoint.myTempo = myCurrentTempo;
+    checkpoint.myActiveBends = myActiveBends;
+    return checkpoint;
+}
+
+void MidiFile::Generator::restore(const Checkpoint &checkpoint)
+{
+    myBarIndex = checkpoint.myBarIndex;
+    myLocation = checkpoint.myLocation;
+    mySystemIndex = checkpoint.mySystemIndex;
+    myCurrentTick = checkpoint.myTick;
+    myCurrentTempo = checkpoint.myTempo;
+    myActiveBends = checkpoint.myActiveBends;
+
+    // The initial events are only needed when starting from the first bar.
+    if (myBarIndex > 0)
+    {
+        for (MidiEventList &track : myPlayerTracks)
+            track.clear();
     }
+}
 
-    return false;
+size_t MidiFile::Generator::getNumTracks() const
+{
+    return myPlayerTracks.size() + 2;
 }
 
-static SystemLocation moveToNextBar(MidiEventList &event_list, int ticks,
-                                    bool record_position_changes,
-                                    const System &system,
-                                    SystemLocation location, int next_bar_pos,
-                                    RepeatController &repeat_controller)
+bool MidiFile::Generator::generateBar(std::vector<MidiEventList> &tracks)
 {
-    SystemLocation prev_location = location;
-    SystemLocation new_location;
+    assert(tracks.size() == getNumTracks());
+
+    if (myBarIndex >= myPlayOrder.getNumBars())
+    {
+        flush(tracks);
+        return false;
+    }
 
-    // Move to the next barline and follow any directions / repeats / alternate
-    // endings.
-    location.setPosition(next_bar_pos);
+    const PlayOrder::Bar &bar = myPlayOrder.getBar(myBarIndex);
+    myLocation = bar.myLocation;
 
-    if (findPositionChange(event_list, ticks, record_position_changes,
-                           repeat_controller, prev_location, location))
+    const System &system = myScore.getSystems()[myLocation.getSystem()];
+    const Barline *current_bar = ScoreUtils::findByPosition(
+        system.getBarlines(), myLocation.getPosition());
+    const Barline *next_bar = system.getNextBarline(myLocation.getPosition());
+
+    if (myLocation.getSystem() != mySystemIndex)
     {
-        return location;
+        myActiveBends.resize(system.getStaves().size(), DEFAULT_BEND);
+        mySystemIndex = myLocation.getSystem();
     }
 
-    // If we're at the end of the system, shift to the next system and also
-    // check for a position change there.
-    if (next_bar_pos == system.getBarlines().back().getPosition())
+    const int64_t start_tick = myCurrentTick;
+    myCurrentTempo = myFile.addTempoEvent(
+        myMasterTrack, start_tick, myCurrentTempo, system,
+        current_bar->getPosition(), next_bar->getPosition());
+
+    // The players at the start of the bar, which determine whether cached
+    // events can be reused.
+    const PlayerChange *players =
+        myCache ? ScoreUtils::getCurrentPlayers(myScore, myLocation.getSystem(),
+                                                current_bar->getPosition())
+                : nullptr;
+
+    for (unsigned int staff_index = 0; staff_index < system.getStaves().size();
+         ++staff_index)
     {
-        location.setSystem(location.getSystem() + 1);
-        location.setPosition(0);
+        const Staff &staff = system.getStaves()[staff_index];
 
-        if (findPositionChange(event_list, ticks, record_position_changes,
-                               repeat_controller, prev_location, location))
+        for (unsigned int voice_index = 0;
+             voice_index < staff.getVoices().size(); ++voice_index)
         {
-            return location;
+            const int64_t end_tick = addEventsForVoice(
+                start_tick, system, players, staff_index, voice_index,
+                current_bar->getPosition(), next_bar->getPosition());
+
+            myCurrentTick = std::max(myCurrentTick, end_tick);
         }
     }
 
-    return location;
-}
+    // Generate metronome events.
+    myCurrentTick = std::max(
+        myCurrentTick,
+        myFile.generateMetronome(myMetronomeTrack, start_tick, system,
+                                 *current_bar, *next_bar, myLocation,
+                                 myOptions));
 
-MidiFile::MidiFile() : myTicksPerBeat(0)
-{
+    // Move to the next bar, following any repeats or directions.
+    if (bar.myIsPositionChange && myOptions.myRecordPositionChanges)
+    {
+        myMetronomeTrack.append(
+            MidiEvent::positionChange(myCurrentTick, bar.myNextLocation));
+    }
+
+    myLocation = bar.myNextLocation;
+
+    ++myBarIndex;
+    flush(tracks);
+    return true;
 }
 
-void MidiFile::load(const Score &score, const LoadOptions &options)
+int64_t MidiFile::Generator::addEventsForVoice(int64_t start_tick,
+                                               const System &system,
+                                               const PlayerChange *players,
+                                               int staff_index, int voice_index,
+                                               int bar_start, int bar_end)
 {
-    myTicksPerBeat = DEFAULT_PPQ;
+    const Staff &staff = system.getStaves()[staff_index];
+    const Voice &voice = staff.getVoices()[voice_index];
+    uint8_t &active_bend = myActiveBends[staff_index];
 
-    RepeatController repeat_controller(score);
+    if (!myCache)
+    {
+        return myFile.addEventsForBar(
+            myPlayerTracks, active_bend, start_tick, myCurrentTempo, myScore,
+            system, myLocation.getSystem(), staff, staff_index, voice,
+            voice_index, bar_start, bar_end, myOptions);
+    }
 
-    MidiEventList master_track;
-    MidiEventList metronome_track;
+    const MidiEventCache::Key key(myLocation.getSystem(), bar_start,
+                                  staff_index, voice_index);
+    std::shared_ptr<const MidiEventCache::Entry> entry =
+        myCache->find(key, myCurrentTempo, active_bend, players);
 
-    // Set the initial channel volume and pitch bend range..
-    std::vector<MidiEventList> regular_tracks(score.getPlayers().size());
-    for (unsigned int i = 0; i < score.getPlayers().size(); ++i)
+    if (entry)
     {
-        regular_tracks[i].append(
-            MidiEvent::volumeChange(0, getChannel(i), Dynamic::fff));
-
-        for (const MidiEvent &event :
-             MidiEvent::pitchWheelRange(0, getChannel(i), PITCH_BEND_RANGE))
+        for (size_t i = 0; i < myPlayerTracks.size(); ++i)
         {
-            regular_tracks[i].append(event);
+            for (MidiEvent event : entry->myTracks[i])
+            {
+                event.setTicks(event.getTicks() + start_tick);
+                myPlayerTracks[i].append(event);
+            }
         }
 
+        active_bend = entry->myEndBend;
+        return start_tick + entry->myDuration;
     }
 
-    SystemLocation location(0, 0);
-    std::vector<uint8_t> active_bends;
-    int system_index = -1;
-    int current_tick = 0;
-    int current_tempo = Midi::BEAT_DURATION_120_BPM;
-
-    while (location.getSystem() < score.getSystems().size())
+    auto new_entry = std::make_shared<MidiEventCache::Entry>();
+    new_entry->myTempo = myCurrentTempo;
+    new_entry->myStartBend = active_bend;
+    if (players)
+        new_entry->myPlayers = *players;
+
+    // Generate the events, and then record the events that were appended to
+    // each track.
+    std::vector<size_t> prev_sizes;
+    for (const MidiEventList &track : myPlayerTracks)
+        prev_sizes.push_back(track.size());
+
+    const int64_t end_tick = myFile.addEventsForBar(
+        myPlayerTracks, active_bend, start_tick, myCurrentTempo, myScore,
+        system, myLocation.getSystem(), staff, staff_index, voice, voice_index,
+        bar_start, bar_end, myOptions);
+
+    new_entry->myTracks.resize(myPlayerTracks.size());
+    for (size_t i = 0; i < myPlayerTracks.size(); ++i)
     {
-        const System &system = score.getSystems()[location.getSystem()];
-        const Barline *current_bar = ScoreUtils::findByPosition(
-            system.getBarlines(), location.getPosition());
-        const Barline *next_bar = system.getNextBarline(location.getPosition());
-
-        if (location.getSystem() != system_index)
+        for (auto it = myPlayerTracks[i].begin() + prev_sizes[i];
+             it != myPlayerTracks[i].end(); ++it)
         {
-            active_bends.resize(system.getStaves().size(), DEFAULT_BEND);
-            system_index = location.getSystem();
+            MidiEvent event = *it;
+            event.setTicks(event.getTicks() - start_tick);
+            new_entry->myTracks[i].append(event);
         }
+    }
 
-        const int start_tick = current_tick;
-        current_tempo =
-            addTempoEvent(master_track, start_tick, current_tempo, system,
-                          current_bar->getPosition(), next_bar->getPosition());
+    new_entry->myEndBend = active_bend;
+    new_entry->myDuration = static_cast<int>(end_tick - start_tick);
+    myCache->insert(key, std::move(new_entry));
 
-        for (unsigned int staff_index = 0; staff_index < system.getStaves().size();
-             ++staff_index)
-        {
-            const Staff &staff = system.getStaves()[staff_index];
+    return end_tick;
+}
 
-            for (unsigned int voice_index = 0; voice_index < staff.getVoices().size();
-                 ++voice_index)
-            {
-                const int end_tick = addEventsForBar(
-                    regular_tracks, active_bends[staff_index], start_tick,
-                    current_tempo, score, system, location.getSystem(), staff,
-                    staff_index, staff.getVoices()[voice_index], voice_index,
-                    current_bar->getPosition(), next_bar->getPosition(),
-                    options);
-
-                current_tick = std::max(current_tick, end_tick);
-            }
-        }
+/// Sorts the bar's events and appends them to the track. The voices are
+/// generated one after another, so the events are not already in order.
+static void appendBar(MidiEventList &track, MidiEventList &bar)
+{
+    std::stable_sort(bar.begin(), bar.end());
+    track.concat(bar);
+    bar.clear();
+}
+
+void MidiFile::Generator::flush(std::vector<MidiEventList> &tracks)
+{
+    appendBar(tracks.front(), myMasterTrack);
+
+    for (size_t i = 0; i < myPlayerTracks.size(); ++i)
+        appendBar(tracks[i + 1], myPlayerTracks[i]);
+
+    appendBar(tracks.back(), myMetronomeTrack);
+}
+
+bool MidiFile::LoadOptions::operator==(const LoadOptions &other) const
+{
+    return myVibratoStrength == other.myVibratoStrength &&
+           myWideVibratoStrength == other.myWideVibratoStrength &&
+           myEnableMetronome == other.myEnableMetronome &&
+           myStrongAccentVel == other.myStrongAccentVel &&
+           myWeakAccentVel == other.myWeakAccentVel &&
+           myMetronomePreset == other.myMetronomePreset &&
+           myRecordPositionChanges == other.myRecordPositionChanges;
+}
+
+MidiFile::MidiFile() : myTicksPerBeat(0)
+{
+}
 
-        // Generate metronome events.
-        current_tick = std::max(
-            current_tick,
-            generateMetronome(metronome_track, start_tick, system, *current_bar,
-                              *next_bar, location, options));
+void MidiFile::load(const Score &score, const LoadOptions &options,
+                    std::shared_ptr<MidiEventCache> cache)
+{
+    Generator generator(*this, score, options, std::move(cache));
 
-        location = moveToNextBar(
-            metronome_track, current_tick, options.myRecordPositionChanges,
-            system, location, next_bar->getPosition(), repeat_controller);
+    std::vector<MidiEventList> tracks(generator.getNumTracks());
+    while (generator.generateBar(tracks))
+    {
     }
 
-    myTracks.push_back(master_track);
-    myTracks.insert(myTracks.end(), regular_tracks.begin(), regular_tracks.end());
-    if (options.myEnableMetronome)
-        myTracks.push_back(metronome_track);
+    // The last track contains the metronome events.
+    if (!options.myEnableMetronome)
+        tracks.pop_back();
 
+    myTracks = std::move(tracks);
     for (MidiEventList &track : myTracks)
     {
-        track.append(MidiEvent::endOfTrack(current_tick));
+        track.append(MidiEvent::endOfTrack(generator.getCurrentTick()));
         track.convertToDeltaTicks();
     }
 }
 
-int MidiFile::generateMetronome(MidiEventList &event_list, int current_tick,
-                                const System &system,
-                                const Barline &current_bar,
-                                const Barline &next_bar,
-                                const SystemLocation &location,
-                                const LoadOptions &options)
+int64_t MidiFile::generateMetronome(MidiEventList &event_list,
+                                    int64_t current_tick, const System &system,
+                                    const Barline &current_bar,
+                                    const Barline &next_bar,
+                                    const SystemLocation &location,
+                                    const LoadOptions &options)
 {
     const TimeSignature &time_sig = current_bar.getTimeSignature();
 
@@ -279,7 +404,7 @@ int MidiFile::generateMetronome(MidiEventList &event_list, int current_tick,
     return current_tick;
 }
 
-int MidiFile::addTempoEvent(MidiEventList &event_list, int current_tick,
+int MidiFile::addTempoEvent(MidiEventList &event_list, int64_t current_tick,
                             int current_tempo, const System &system,
                             int bar_start, int bar_end)
 {
@@ -395,18 +520,18 @@ static int getArpeggioOffset(int ppq, int current_tempo)
 /// function.
 struct BendEventInfo
 {
-    BendEventInfo(int tick, uint8_t bend_amount)
+    BendEventInfo(int64_t tick, uint8_t bend_amount)
         : myTick(tick), myBendAmount(bend_amount)
     {
     }
 
-    int myTick;
+    int64_t myTick;
     uint8_t myBendAmount;
 };
 
 static void generateGradualBend(std::vector<BendEventInfo> &bends,
-                                int start_tick, int duration, int start_bend,
-                                int release_bend)
+                                int64_t start_tick, int duration,
+                                int start_bend, int release_bend)
 {
     const int num_events = std::abs(start_bend - release_bend);
     if (!num_events)
@@ -415,7 +540,7 @@ static void generateGradualBend(std::vector<BendEventInfo> &bends,
     const int event_duration = duration / num_events;
     for (int i = 1; i <= num_events; ++i)
     {
-        const int tick = start_tick + i * event_duration;
+        const int64_t tick = start_tick + i * event_duration;
         if (start_bend < release_bend)
             bends.push_back(BendEventInfo(tick, start_bend + i));
         else
@@ -424,8 +549,8 @@ static void generateGradualBend(std::vector<BendEventInfo> &bends,
 }
 
 static void generateBends(std::vector<BendEventInfo> &bends,
-                          uint8_t &active_bend, int start_tick, int duration,
-                          int ppq, const Note &note)
+                          uint8_t &active_bend, int64_t start_tick,
+                          int duration, int ppq, const Note &note)
 {
     const Bend &bend = note.getBend();
 
@@ -511,9 +636,9 @@ static void generateBends(std::vector<BendEventInfo> &bends,
     }
 }
 
-static void generateSlides(std::vector<BendEventInfo> &bends, int start_tick,
-                           int note_duration, int ppq, const Note &note,
-                           const Note *next_note)
+static void generateSlides(std::vector<BendEventInfo> &bends,
+                           int64_t start_tick, int note_duration, int ppq,
+                           const Note &note, const Note *next_note)
 {
     if (note.hasProperty(Note::ShiftSlide) ||
         note.hasProperty(Note::LegatoSlide) ||
@@ -568,8 +693,9 @@ static void generateSlides(std::vector<BendEventInfo> &bends, int start_tick,
     }
 }
 
-int MidiFile::addEventsForBar(
-    std::vector<MidiEventList> &tracks, uint8_t &active_bend, int current_tick,
+int64_t MidiFile::addEventsForBar(
+    std::vector<MidiEventList> &tracks, uint8_t &active_bend,
+    int64_t current_tick,
     int current_tempo, const Score &score, const System &system,
     int system_index, const Staff &staff, int staff_index, const Voice &voice,
     int voice_index, int bar_start, int bar_end, const LoadOptions &options)
@@ -842,7 +968,8 @@ int MidiFile::addEventsForBar(
 
                 for (int i = 0; i < num_notes; ++i)
                 {
-                    const int tick = current_tick + i * trem_pick_duration;
+                    const int64_t tick =
+                        current_tick + i * trem_pick_duration;
 
                     for (const ActivePlayer &player : active_players)
                     {
@@ -19,15 +19,19 @@
 #define MIDI_MIDIFILE_H
 
 #include <midi/midieventlist.h>
+#include <score/systemlocation.h>
+#include <score/utils/playorder.h>
 
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 class Barline;
+class MidiEventCache;
+class PlayerChange;
 class Score;
 class Staff;
 class System;
-class SystemLocation;
 class Voice;
 
 class MidiFile
@@ -46,6 +50,12 @@ public:
         {
         }
 
+        bool operator==(const LoadOptions &other) const;
+        bool operator!=(const LoadOptions &other) const
+        {
+            return !(*this == other);
+        }
+
         uint8_t myVibratoStrength;
         uint8_t myWideVibratoStrength;
         bool myEnableMetronome;
@@ -55,32 +65,113 @@ public:
         bool myRecordPositionChanges;
     };
 
+    /// Generates the events for a score one bar at a time, in playback order
+    /// (following any repeats). This allows playback to start before the
+    /// entire score has been processed.
+    class Generator
+    {
+    public:
+        /// The state needed to resume generating events from the start of a
+        /// bar.
+        struct Checkpoint
+        {
+            /// The number of bars that were generated before this bar.
+            size_t myBarIndex;
+            SystemLocation myLocation;
+            int mySystemIndex;
+            int64_t myTick;
+            int myTempo;
+            std::vector<uint8_t> myActiveBends;
+        };
+
+        /// @param cache If provided, the events for each bar are reused from
+        ///     the cache when possible, and newly generated events are added
+        ///     to the cache.
+        Generator(MidiFile &file, const Score &score,
+                  const LoadOptions &options,
+                  std::shared_ptr<MidiEventCache> cache = nullptr);
+        ~Generator();
+
+        /// Returns the state before the next bar is generated.
+        Checkpoint getCheckpoint() const;
+
+        /// Resumes generating events from a checkpoint that was created by a
+        /// generator for the same score and options.
+        void restore(const Checkpoint &checkpoint);
+
+        /// Returns the number of tracks, which are the master track, a track
+        /// for each player, and the metronome track (which also contains the
+        /// position changes).
+        size_t getNumTracks() const;
+
+        /// Appends the events for the next bar to the tracks, with absolute
+        /// ticks. Each track's events for the bar are sorted by time.
+        /// @return False if the end of the score has been reached.
+        bool generateBar(std::vector<MidiEventList> &tracks);
+
+        /// Returns the tick at the end of the most recently generated bar.
+        int64_t getCurrentTick() const { return myCurrentTick; }
+
+    private:
+        /// Adds the events for a voice in the current bar, using the cache if
+        /// possible.
+        /// @return The tick at the end of the voice's events.
+        int64_t addEventsForVoice(int64_t start_tick, const System &system,
+                                  const PlayerChange *players,
+                                  int staff_index, int voice_index,
+                                  int bar_start, int bar_end);
+
+        void flush(std::vector<MidiEventList> &tracks);
+
+        MidiFile &myFile;
+        const Score &myScore;
+        const LoadOptions myOptions;
+        std::shared_ptr<MidiEventCache> myCache;
+        const PlayOrder myPlayOrder;
+
+        /// The index of the next bar in the play order.
+        size_t myBarIndex;
+        SystemLocation myLocation;
+        int mySystemIndex;
+        std::vector<uint8_t> myActiveBends;
+        int64_t myCurrentTick;
+        int myCurrentTempo;
+
+        /// Events for the current bar.
+        MidiEventList myMasterTrack;
+        std::vector<MidiEventList> myPlayerTracks;
+        MidiEventList myMetronomeTrack;
+    };
+
     MidiFile();
 
-    void load(const Score &score, const LoadOptions &options);
+    /// @param cache If provided, the events for each bar are reused from the
+    ///     cache when possible (see Generator).
+    void load(const Score &score, const LoadOptions &options,
+              std::shared_ptr<MidiEventCache> cache = nullptr);
 
     int getTicksPerBeat() const { return myTicksPerBeat; }
     std::vector<MidiEventList> &getTracks() { return myTracks; }
     const std::vector<MidiEventList> &getTracks() const { return myTracks; }
 
 private:
-    int generateMetronome(MidiEventList &event_list, int current_tick,
-                          const System &system, const Barline &current_bar,
-                          const Barline &next_bar,
-                          const SystemLocation &location,
-                          const LoadOptions &options);
+    int64_t generateMetronome(MidiEventList &event_list, int64_t current_tick,
+                              const System &system, const Barline &current_bar,
+                              const Barline &next_bar,
+                              const SystemLocation &location,
+                              const LoadOptions &options);
 
-    int addTempoEvent(MidiEventList &event_list, int current_tick,
+    int addTempoEvent(MidiEventList &event_list, int64_t current_tick,
                       int current_tempo, const System &system, int bar_start,
                       int bar_end);
 
-    int addEventsForBar(std::vector<MidiEventList> &tracks,
-                        uint8_t &active_bend, int current_tick,
-                        int current_tempo, const Score &score,
-                        const System &system, int system_index,
-                        const Staff &staff, int staff_index, const Voice &voice,
-                        int voice_index, int bar_start, int bar_end,
-                        const LoadOptions &options);
+    int64_t addEventsForBar(std::vector<MidiEventList> &tracks,
+                            uint8_t &active_bend, int64_t current_tick,
+                            int current_tempo, const Score &score,
+                            const System &system, int system_index,
+                            const Staff &staff, int staff_index,
+                            const Voice &voice, int voice_index, int bar_start,
+                            int bar_end, const LoadOptions &options);
 
     int myTicksPerBeat;
     std::vector<MidiEventList> myTracks;
@@ -0,0 +1,129 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "midistream.h"
+
+#include <chrono>
+
+/// How long to wait before checking the queue again when it is full or empty.
+static const std::chrono::microseconds thePollInterval(200);
+
+MidiStream::MidiStream(const Score &score,
+                       const MidiFile::LoadOptions &options,
+                       std::shared_ptr<PlaybackTimeline> timeline,
+                       std::shared_ptr<MidiEventCache> cache,
+                       const SystemLocation &start_location,
+                       size_t max_queued_bars)
+    : myScore(score),
+      myGenerator(myFile, myScore, options, std::move(cache)),
+      myTimeline(std::move(timeline)),
+      myQueue(max_queued_bars),
+      myIsFinished(false),
+      myIsStopped(false)
+{
+    if (myTimeline)
+    {
+        myTimeline->setOptions(options, myFile.getTicksPerBeat());
+
+        myStartBar = myTimeline->seek(start_location);
+        if (myStartBar)
+            myGenerator.restore(myStartBar->myCheckpoint);
+    }
+
+    myThread = std::thread(&MidiStream::generate, this);
+}
+
+MidiStream::~MidiStream()
+{
+    myIsStopped = true;
+    myThread.join();
+}
+
+void MidiStream::generate()
+{
+    try
+    {
+        std::vector<MidiEventList> tracks(myGenerator.getNumTracks());
+        bool has_bar = true;
+
+        while (has_bar && !myIsStopped)
+        {
+            MidiFile::Generator::Checkpoint checkpoint;
+            if (myTimeline)
+                checkpoint = myGenerator.getCheckpoint();
+
+            has_bar = myGenerator.generateBar(tracks);
+
+            // Unload any systems that were only loaded by this copy of the
+            // score, if it is over the memory budget.
+            myScore.releaseSystems();
+
+            // Each track is sorted, so they can be combined with a merge
+            // rather than sorting all of the bar's events.
+            MidiEventList events = MidiEventList::merge(tracks);
+            for (MidiEventList &track : tracks)
+                track.clear();
+
+            if (myTimeline)
+            {
+                if (has_bar)
+                    myTimeline->addBar(checkpoint, events);
+                else
+                    myTimeline->setComplete(checkpoint.myBarIndex);
+            }
+
+            if (events.size() == 0)
+                continue;
+
+            while (!myQueue.tryPush(std::move(events)))
+            {
+                if (myIsStopped)
+                    return;
+
+                std::this_thread::sleep_for(thePollInterval);
+            }
+        }
+    }
+    catch (...)
+    {
+        myError = std::current_exception();
+    }
+
+    myIsFinished = true;
+}
+
+bool MidiStream::getNextBar(MidiEventList &events)
+{
+    while (!myQueue.tryPop(events))
+    {
+        if (myIsFinished)
+        {
+            // Check for a bar that was pushed just before finishing.
+            if (myQueue.tryPop(events))
+                return true;
+
+            if (myError)
+                std::rethrow_exception(myError);
+
+            return false;
+        }
+
+        std::this_thread::sleep_for(thePollInterval);
+    }
+
+    return true;
+}
@@ -0,0 +1,87 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MIDI_MIDISTREAM_H
+#define MIDI_MIDISTREAM_H
+
+#include <atomic>
+#include <boost/optional/optional.hpp>
+#include <exception>
+#include <memory>
+#include <midi/midifile.h>
+#include <midi/playbacktimeline.h>
+#include <score/score.h>
+#include <thread>
+#include <util/spscqueue.h>
+
+/// Generates the MIDI events for a score on a background thread, one bar at a
+/// time, and passes them to the consumer through a bounded queue. This allows
+/// playback to start once the first bar has been generated, instead of after
+/// the entire score has been processed.
+/// The stream generates the events from its own copy of the score, so the
+/// original score can be modified (or its systems unloaded) while the stream
+/// exists. The stream must be created on the thread that owns the score.
+class MidiStream
+{
+public:
+    /// @param timeline If provided, the events are generated starting from
+    ///     the closest bar in the timeline to the start location, and the
+    ///     timeline is updated with the bars that are generated.
+    /// @param cache If provided, the events for each bar are reused from the
+    ///     cache when possible.
+    MidiStream(const Score &score, const MidiFile::LoadOptions &options,
+               std::shared_ptr<PlaybackTimeline> timeline = nullptr,
+               std::shared_ptr<MidiEventCache> cache = nullptr,
+               const SystemLocation &start_location = SystemLocation(),
+               size_t max_queued_bars = 64);
+    MidiStream(const MidiStream &) = delete;
+    MidiStream &operator=(const MidiStream &) = delete;
+    ~MidiStream();
+
+    int getTicksPerBeat() const { return myFile.getTicksPerBeat(); }
+
+    /// Returns the bar from the timeline that the events start from, if any.
+    /// The events before this bar are not generated, so the channel state at
+    /// the start of the bar should be restored before playing the events.
+    const boost::optional<PlaybackTimeline::Bar> &getStartBar() const
+    {
+        return myStartBar;
+    }
+
+    /// Waits for the events for the next bar, which are sorted and have
+    /// absolute ticks. Any exception from generating the events is rethrown.
+    /// @return False if there are no more bars.
+    bool getNextBar(MidiEventList &events);
+
+private:
+    void generate();
+
+    /// The generator thread's copy of the score, which shares its systems
+    /// with the original score.
+    const Score myScore;
+    MidiFile myFile;
+    MidiFile::Generator myGenerator;
+    std::shared_ptr<PlaybackTimeline> myTimeline;
+    boost::optional<PlaybackTimeline::Bar> myStartBar;
+    Util::SpscQueue<MidiEventList> myQueue;
+    std::atomic<bool> myIsFinished;
+    std::atomic<bool> myIsStopped;
+    std::exception_ptr myError;
+    std::thread myThread;
+};
+
+#endif
@@ -0,0 +1,275 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "playbacktimeline.h"
+
+#include <algorithm>
+#include <score/dynamic.h>
+#include <tuple>
+
+enum Controller : uint8_t
+{
+    ModWheel = 0x01,
+    DataEntryCoarse = 0x06,
+    ChannelVolume = 0x07,
+    HoldPedal = 0x40
+};
+
+static const uint8_t DEFAULT_BEND = 64;
+
+PlaybackTimeline::ChannelState::ChannelState()
+    : myIsUsed(false),
+      myHasProgram(false),
+      myProgram(0),
+      myVolume(Dynamic::fff),
+      myPitchBend(DEFAULT_BEND),
+      myPitchBendRange(0),
+      myModWheel(0),
+      mySustain(false)
+{
+}
+
+/// Updates the channel state after an event.
+static void updateChannelState(
+    std::array<PlaybackTimeline::ChannelState,
+               PlaybackTimeline::NUM_CHANNELS> &channels,
+    const MidiEvent &event)
+{
+    const uint8_t status = event.getStatusByte() & 0xf0;
+    if (status == MidiEvent::SysEx)
+        return;
+
+    const MidiEvent::Data data = event.getData();
+    PlaybackTimeline::ChannelState &channel = channels[event.getChannel()];
+
+    switch (status)
+    {
+    case MidiEvent::ProgramChange:
+        channel.myIsUsed = true;
+        channel.myHasProgram = true;
+        channel.myProgram = data[1];
+        break;
+
+    case MidiEvent::PitchWheel:
+        channel.myIsUsed = true;
+        channel.myPitchBend = data[2];
+        break;
+
+    case MidiEvent::ControlChange:
+        channel.myIsUsed = true;
+        if (data[1] == Controller::ChannelVolume)
+            channel.myVolume = data[2];
+        else if (data[1] == Controller::ModWheel)
+            channel.myModWheel = data[2];
+        else if (data[1] == Controller::HoldPedal)
+            channel.mySustain = data[2] >= 64;
+        else if (data[1] == Controller::DataEntryCoarse)
+            channel.myPitchBendRange = data[2];
+        break;
+
+    default:
+        break;
+    }
+}
+
+MidiEventList PlaybackTimeline::Bar::getChannelEvents() const
+{
+    MidiEventList events;
+    const int64_t ticks = myCheckpoint.myTick;
+
+    for (uint8_t i = 0; i < NUM_CHANNELS; ++i)
+    {
+        const ChannelState &channel = myChannels[i];
+        if (!channel.myIsUsed)
+            continue;
+
+        for (const MidiEvent &event :
+             MidiEvent::pitchWheelRange(ticks, i, channel.myPitchBendRange))
+        {
+            events.append(event);
+        }
+
+        if (channel.myHasProgram)
+        {
+            events.append(
+                MidiEvent::programChange(ticks, i, channel.myProgram));
+        }
+
+        events.append(MidiEvent::volumeChange(ticks, i, channel.myVolume));
+        events.append(MidiEvent::pitchWheel(ticks, i, channel.myPitchBend));
+        events.append(MidiEvent::modWheel(ticks, i, channel.myModWheel));
+        events.append(MidiEvent::holdPedal(ticks, i, channel.mySustain));
+    }
+
+    return events;
+}
+
+PlaybackTimeline::PlaybackTimeline()
+    : myTicksPerBeat(0), myIsComplete(false), myIsIndexSorted(true)
+{
+}
+
+void PlaybackTimeline::setOptions(const MidiFile::LoadOptions &options,
+                                  int ticks_per_beat)
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+
+    if (options != myOptions || ticks_per_beat != myTicksPerBeat)
+    {
+        myOptions = options;
+        myTicksPerBeat = ticks_per_beat;
+
+        myBars.clear();
+        myChannels.fill(ChannelState());
+        myPassCounts.clear();
+        myIndex.clear();
+        myIsComplete = false;
+    }
+}
+
+void PlaybackTimeline::addBar(const MidiFile::Generator::Checkpoint &checkpoint,
+                              const MidiEventList &events)
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+
+    if (checkpoint.myBarIndex != myBars.size())
+        return;
+
+    Bar bar;
+    bar.myLocation = checkpoint.myLocation;
+    bar.myPass = myPassCounts[checkpoint.myLocation]++;
+    bar.myCheckpoint = checkpoint;
+    bar.myChannels = myChannels;
+
+    myBars.push_back(std::move(bar));
+    myIndex.push_back(myBars.size() - 1);
+    myIsIndexSorted = false;
+
+    for (const MidiEvent &event : events)
+        updateChannelState(myChannels, event);
+}
+
+void PlaybackTimeline::setComplete(size_t num_bars)
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+    if (num_bars == myBars.size())
+        myIsComplete = true;
+}
+
+bool PlaybackTimeline::isComplete() const
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+    return myIsComplete;
+}
+
+size_t PlaybackTimeline::getNumBars() const
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+    return myBars.size();
+}
+
+void PlaybackTimeline::invalidateSystem(int system)
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+
+    auto bar = std::find_if(myBars.begin(), myBars.end(), [=](const Bar &bar) {
+        return bar.myLocation.getSystem() == system;
+    });
+
+    if (bar == myBars.end())
+        return;
+
+    myChannels = bar->myChannels;
+    myBars.erase(bar, myBars.end());
+    myIsComplete = false;
+
+    myPassCounts.clear();
+    for (const Bar &bar : myBars)
+        ++myPassCounts[bar.myLocation];
+
+    myIndex.erase(std::remove_if(myIndex.begin(), myIndex.end(),
+                                 [&](size_t i) { return i >= myBars.size(); }),
+                  myIndex.end());
+}
+
+void PlaybackTimeline::clear()
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+
+    myBars.clear();
+    myChannels.fill(ChannelState());
+    myPassCounts.clear();
+    myIndex.clear();
+    myIsComplete = false;
+}
+
+void PlaybackTimeline::sortIndex() const
+{
+    if (myIsIndexSorted)
+        return;
+
+    std::sort(myIndex.begin(), myIndex.end(), [&](size_t a, size_t b) {
+        return std::tie(myBars[a].myLocation, myBars[a].myPass) <
+               std::tie(myBars[b].myLocation, myBars[b].myPass);
+    });
+
+    myIsIndexSorted = true;
+}
+
+boost::optional<PlaybackTimeline::Bar> PlaybackTimeline::seek(
+    const SystemLocation &location, int pass) const
+{
+    std::lock_guard<std::mutex> lock(myMutex);
+
+    if (myBars.empty())
+        return boost::none;
+
+    sortIndex();
+
+    // Find the last bar that starts at or before the location.
+    auto it = std::upper_bound(
+        myIndex.begin(), myIndex.end(), location,
+        [&](const SystemLocation &key, size_t i) {
+            return key < myBars[i].myLocation;
+        });
+
+    if (it != myIndex.begin())
+    {
+        const SystemLocation &bar_location = myBars[*std::prev(it)].myLocation;
+
+        // Find the requested pass through the bar, or the last pass if the
+        // bar hasn't been played that many times yet.
+        auto pass_it = std::lower_bound(
+            myIndex.begin(), it, std::make_tuple(bar_location, pass),
+            [&](size_t i, const std::tuple<SystemLocation, int> &key) {
+                return std::tie(myBars[i].myLocation, myBars[i].myPass) < key;
+            });
+        if (pass_it == it)
+            --pass_it;
+
+        const Bar &bar = myBars[*pass_it];
+        if (bar.myLocation.getSystem() == location.getSystem())
+            return bar;
+    }
+
+    // If the system hasn't been reached yet, continue from the end of the
+    // timeline.
+    if (!myIsComplete)
+        return myBars.back();
+
+    return boost::none;
+}
@@ -0,0 +1,121 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MIDI_PLAYBACKTIMELINE_H
+#define MIDI_PLAYBACKTIMELINE_H
+
+#include <array>
+#include <boost/optional/optional.hpp>
+#include <cstdint>
+#include <midi/midifile.h>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/// Records the playback state at the start of each bar, in playback order,
+/// so that playback can start from any location without generating the
+/// events for all of the preceding bars.
+///
+/// The timeline is filled in as the events are generated for playback (see
+/// MidiStream). Since the state at each bar depends on the bars before it,
+/// modifying a system discards the bars from the first time that the system
+/// is played.
+class PlaybackTimeline
+{
+public:
+    static const int NUM_CHANNELS = 16;
+
+    /// The state of a MIDI channel at the start of a bar.
+    struct ChannelState
+    {
+        ChannelState();
+
+        /// Whether any events have been sent to the channel.
+        bool myIsUsed;
+        bool myHasProgram;
+        uint8_t myProgram;
+        uint8_t myVolume;
+        uint8_t myPitchBend;
+        uint8_t myPitchBendRange;
+        uint8_t myModWheel;
+        bool mySustain;
+    };
+
+    struct Bar
+    {
+        SystemLocation myLocation;
+        /// The number of times that the bar was played previously.
+        int myPass;
+        MidiFile::Generator::Checkpoint myCheckpoint;
+        std::array<ChannelState, NUM_CHANNELS> myChannels;
+
+        /// Returns events that restore the state of each channel.
+        MidiEventList getChannelEvents() const;
+    };
+
+    PlaybackTimeline();
+
+    /// Clears the timeline if the options differ from the options that were
+    /// used to generate it.
+    void setOptions(const MidiFile::LoadOptions &options, int ticks_per_beat);
+
+    /// Records a bar, given the generator's state before the bar and the
+    /// bar's events. The bar is ignored if it is not the next bar in the
+    /// timeline (e.g. it was already recorded).
+    void addBar(const MidiFile::Generator::Checkpoint &checkpoint,
+                const MidiEventList &events);
+
+    /// Records that the end of the score was reached.
+    void setComplete(size_t num_bars);
+    bool isComplete() const;
+
+    size_t getNumBars() const;
+
+    /// Discards the bars from the first time that the system is played.
+    void invalidateSystem(int system);
+    /// Discards all of the bars (e.g. after systems are inserted or removed).
+    void clear();
+
+    /// Finds a bar to start generating events from in order to begin
+    /// playback at the given location (e.g. the bar containing the location).
+    /// If the location has not been reached yet, this returns the last bar in
+    /// the timeline.
+    boost::optional<Bar> seek(const SystemLocation &location,
+                              int pass = 0) const;
+
+private:
+    void sortIndex() const;
+
+    mutable std::mutex myMutex;
+    MidiFile::LoadOptions myOptions;
+    int myTicksPerBeat;
+    bool myIsComplete;
+
+    /// The bars in playback order.
+    std::vector<Bar> myBars;
+    /// The channel state after the last bar.
+    std::array<ChannelState, NUM_CHANNELS> myChannels;
+    /// The number of times that each bar has been played.
+    std::unordered_map<SystemLocation, int> myPassCounts;
+
+    /// The indices of the bars, ordered by their location and pass. This is
+    /// sorted when needed, since bars are added one at a time.
+    mutable std::vector<size_t> myIndex;
+    mutable bool myIsIndexSorted;
+};
+
+#endif
@@ -129,19 +129,14 @@ QRectF CaretPainter::boundingRect() const
         return QRectF();
 }
 
-void CaretPainter::addSystemRect(const QRectF &rect)
+void CaretPainter::setSystemRectFunction(const SystemRectFunction &func)
 {
-    mySystemRects.push_back(rect);
-}
-
-void CaretPainter::setSystemRect(int index, const QRectF &rect)
-{
-    mySystemRects.at(index) = rect;
+    mySystemRectFunction = func;
 }
 
 QRectF CaretPainter::getCurrentSystemRect() const
 {
-    return mySystemRects.at(myCaret.getLocation().getSystemIndex());
+    return mySystemRectFunction(myCaret.getLocation().getSystemIndex());
 }
 
 void CaretPainter::updatePosition()
@@ -162,13 +157,19 @@ void CaretPainter::onLocationChanged()
     if (location.getScore().getSystems().empty())
         return;
 
-    const System &system = location.getSystem();
+    // Keep a snapshot of the system for the layout, since the score may
+    // unload the system later (see Score::releaseSystems()).
+    std::shared_ptr<const System> snapshot =
+        location.getScore().getSystemSnapshot(location.getSystemIndex());
+    const System &system = *snapshot;
     if (system.getStaves().empty())
         return;
 
     myLayout.reset(new LayoutInfo(location.getScore(), system,
-                                  location.getSystemIndex(), location.getStaff(),
+                                  location.getSystemIndex(),
+                                  system.getStaves()[location.getStaffIndex()],
                                   location.getStaffIndex()));
+    mySystem = std::move(snapshot);
 
     const ViewFilter *filter =
         myViewOptions.getFilter()
@@ -189,7 +190,7 @@ void CaretPainter::onLocationChanged()
     }
 
     const QRectF oldRect = sceneBoundingRect();
-    setPos(0, mySystemRects.at(location.getSystemIndex()).top() + offset +
+    setPos(0, mySystemRectFunction(location.getSystemIndex()).top() + offset +
            myLayout->getSystemSymbolSpacing() + myLayout->getStaffHeight() -
            myLayout->getTabStaffBelowSpacing() - myLayout->STAFF_BORDER_SPACING -
            myLayout->getTabStaffHeight());
@@ -19,11 +19,13 @@
 #define PAINTERS_CARETPAINTER_H
 
 #include <boost/signals2/signal.hpp>
+#include <functional>
 #include <memory>
 #include <QGraphicsItem>
 
 class Caret;
 struct LayoutInfo;
+class System;
 class ViewOptions;
 
 class CaretPainter : public QGraphicsItem
@@ -36,8 +38,11 @@ public:
 
     virtual QRectF boundingRect() const override;
 
-    void addSystemRect(const QRectF &rect);
-    void setSystemRect(int index, const QRectF &rect);
+    typedef std::function<QRectF (int)> SystemRectFunction;
+    /// Sets the function used to find the location of a system in the
+    /// scene. The location is looked up whenever the caret moves, so it
+    /// does not need to be updated when other systems are resized.
+    void setSystemRectFunction(const SystemRectFunction &func);
     QRectF getCurrentSystemRect() const;
 
     void updatePosition();
@@ -53,8 +58,10 @@ private:
 
     const Caret &myCaret;
     const ViewOptions &myViewOptions;
+    /// The system that myLayout refers to.
+    std::shared_ptr<const System> mySystem;
     std::unique_ptr<LayoutInfo> myLayout;
-    std::vector<QRectF> mySystemRects;
+    SystemRectFunction mySystemRectFunction;
     boost::signals2::scoped_connection myCaretConnection;
     LocationChangedSlot onMyLocationChanged;
 
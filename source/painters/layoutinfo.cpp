@@ -83,10 +83,15 @@ int LayoutInfo::getStringCount() const
 }
 
 double LayoutInfo::getSystemSymbolSpacing() const
+{
+    return getSystemSymbolSpacing(mySystem);
+}
+
+double LayoutInfo::getSystemSymbolSpacing(const System &system)
 {
     double height = 0;
 
-    for (const Barline &barline : mySystem.getBarlines())
+    for (const Barline &barline : system.getBarlines())
     {
         if (barline.hasRehearsalSign())
         {
@@ -95,20 +100,20 @@ double LayoutInfo::getSystemSymbolSpacing() const
         }
     }
 
-    if (!mySystem.getAlternateEndings().empty())
+    if (!system.getAlternateEndings().empty())
         height += SYSTEM_SYMBOL_SPACING;
 
-    if (!mySystem.getTempoMarkers().empty())
+    if (!system.getTempoMarkers().empty())
         height += SYSTEM_SYMBOL_SPACING;
 
-    if (!mySystem.getChords().empty())
+    if (!system.getChords().empty())
         height += SYSTEM_SYMBOL_SPACING;
 
-    if (!mySystem.getTextItems().empty())
+    if (!system.getTextItems().empty())
         height += SYSTEM_SYMBOL_SPACING;
 
     double directionHeight = 0;
-    for (const Direction &direction : mySystem.getDirections())
+    for (const Direction &direction : system.getDirections())
     {
         directionHeight = std::max(directionHeight,
                                    direction.getSymbols().size() *
@@ -129,6 +134,13 @@ double LayoutInfo::getStaffHeight() const
             4 * STAFF_BORDER_SPACING;
 }
 
+double LayoutInfo::getMinStaffHeight(const Score &score, const Staff &staff)
+{
+    return STD_NOTATION_LINE_SPACING * (NUM_STD_NOTATION_LINES - 1) +
+            (staff.getStringCount() - 1) * score.getLineSpacing() +
+            4 * STAFF_BORDER_SPACING;
+}
+
 double LayoutInfo::getStdNotationLine(int line) const
 {
     return myStdNotationStaffAboveSpacing + STAFF_BORDER_SPACING +
@@ -101,7 +101,11 @@ struct LayoutInfo
     int getStringCount() const;
 
     double getSystemSymbolSpacing() const;
+    static double getSystemSymbolSpacing(const System &system);
     double getStaffHeight() const;
+    /// Returns the height of the staff without any symbols above or below
+    /// it, which can be computed without laying out the staff.
+    static double getMinStaffHeight(const Score &score, const Staff &staff);
 
     double getStdNotationLine(int line) const;
     double getStdNotationSpace(int space) const;
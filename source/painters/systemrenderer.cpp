@@ -77,33 +77,111 @@ SystemRenderer::SystemRenderer(const ScoreArea *score_area, const Score &score,
     myRehearsalSignFont.setPixelSize(12);
 }
 
+std::vector<LayoutConstPtr> SystemRenderer::layoutSystem(
+    const Score &score, const System &system, int systemIndex,
+    const ViewOptions &view_options)
+{
+    const ViewFilter *filter =
+        view_options.getFilter()
+            ? &score.getViewFilters()[*view_options.getFilter()]
+            : nullptr;
+
+    std::vector<LayoutConstPtr> layouts;
+    int i = 0;
+    for (const Staff &staff : system.getStaves())
+    {
+        if (filter && !filter->accept(score, systemIndex, i))
+        {
+            layouts.push_back(nullptr);
+        }
+        else
+        {
+            layouts.push_back(std::make_shared<LayoutInfo>(
+                score, system, systemIndex, staff, i));
+        }
+
+        ++i;
+    }
+
+    return layouts;
+}
+
+double SystemRenderer::getSystemHeight(
+    const std::vector<LayoutConstPtr> &layouts)
+{
+    double height = 0;
+    for (const LayoutConstPtr &layout : layouts)
+    {
+        if (!layout)
+            continue;
+
+        // The system symbols are drawn above the first visible staff.
+        if (height == 0)
+            height += layout->getSystemSymbolSpacing();
+
+        height += layout->getStaffHeight();
+    }
+
+    return height;
+}
+
+double SystemRenderer::estimateSystemHeight(const Score &score,
+                                            const System &system,
+                                            int systemIndex,
+                                            const ViewOptions &view_options)
+{
+    const ViewFilter *filter =
+        view_options.getFilter()
+            ? &score.getViewFilters()[*view_options.getFilter()]
+            : nullptr;
+
+    double height = 0;
+    int i = 0;
+    for (const Staff &staff : system.getStaves())
+    {
+        if (!filter || filter->accept(score, systemIndex, i))
+        {
+            // The system symbols are drawn above the first visible staff.
+            if (height == 0)
+                height += LayoutInfo::getSystemSymbolSpacing(system);
+
+            height += LayoutInfo::getMinStaffHeight(score, staff);
+        }
+
+        ++i;
+    }
+
+    return height;
+}
+
 QGraphicsItem *SystemRenderer::operator()(const System &system,
                                           int systemIndex)
+{
+    return (*this)(system, systemIndex,
+                   layoutSystem(myScore, system, systemIndex, myViewOptions));
+}
+
+QGraphicsItem *SystemRenderer::operator()(
+    const System &system, int systemIndex,
+    const std::vector<LayoutConstPtr> &layouts)
 {
     // Draw the bounding rectangle for the system.
     myParentSystem = new QGraphicsRectItem();
     myParentSystem->setPen(QPen(QBrush(QColor(0, 0, 0, 127)), 0.5));
 
-    const ViewFilter *filter =
-        myViewOptions.getFilter()
-            ? &myScore.getViewFilters()[*myViewOptions.getFilter()]
-            : nullptr;
-
     // Draw each staff.
     double height = 0;
     int i = 0;
     for (const Staff &staff : system.getStaves())
     {
-        if (filter && !filter->accept(myScore, systemIndex, i))
+        const LayoutConstPtr &layout = layouts[i];
+        if (!layout)
         {
             ++i;
             continue;
         }
 
         const bool isFirstStaff = (height == 0);
-        LayoutConstPtr layout = std::make_shared<LayoutInfo>(
-            myScore, system, systemIndex, staff, i);
-
         if (isFirstStaff)
         {
             drawSystemSymbols(system, *layout);
@@ -23,6 +23,7 @@
 #include <painters/musicfont.h>
 #include <QFontMetricsF>
 #include <score/staff.h>
+#include <vector>
 
 class QGraphicsItem;
 class QGraphicsItemGroup;
@@ -39,8 +40,30 @@ public:
     SystemRenderer(const ScoreArea *score_area, const Score &score,
                    const ViewOptions &view_options);
 
+    /// Computes the layout of each staff in the system, with null entries
+    /// for staves that are hidden by the view filter. No graphics items are
+    /// created, so this can safely be run for several systems in parallel.
+    static std::vector<LayoutConstPtr> layoutSystem(
+        const Score &score, const System &system, int systemIndex,
+        const ViewOptions &view_options);
+
+    /// Returns the height of a system with the given layouts, without
+    /// rendering it.
+    static double getSystemHeight(const std::vector<LayoutConstPtr> &layouts);
+
+    /// Returns an estimate of the system's height, which is a lower bound
+    /// that can be computed without laying out the system.
+    static double estimateSystemHeight(const Score &score,
+                                       const System &system, int systemIndex,
+                                       const ViewOptions &view_options);
+
     QGraphicsItem *operator()(const System &system, int systemIndex);
 
+    /// Renders the system using the layouts from layoutSystem(). This must be
+    /// called from the GUI thread.
+    QGraphicsItem *operator()(const System &system, int systemIndex,
+                              const std::vector<LayoutConstPtr> &layouts);
+
 private:
     /// Draws the tab clef.
     void drawTabClef(double x, const LayoutInfo &layout,
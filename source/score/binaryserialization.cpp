@@ -0,0 +1,124 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "binaryserialization.h"
+
+#include <istream>
+#include <iterator>
+#include <ostream>
+
+namespace ScoreUtils
+{
+namespace Binary
+{
+bool hasMagic(std::istream &is, const std::array<char, 4> &expected)
+{
+    const std::istream::pos_type start = is.tellg();
+
+    std::array<char, 4> magic;
+    is.read(magic.data(), magic.size());
+    const bool found = is.gcount() == static_cast<std::streamsize>(
+                                          magic.size()) && magic == expected;
+
+    is.clear();
+    is.seekg(start);
+    return found;
+}
+
+FileVersion readHeader(std::istream &input, std::string &data, size_t &offset)
+{
+    if (!input)
+        throw std::runtime_error("Could not open stream");
+
+    data.assign(std::istreambuf_iterator<char>(input),
+                std::istreambuf_iterator<char>());
+
+    if (data.size() < MAGIC.size() + 4 ||
+        !std::equal(MAGIC.begin(), MAGIC.end(), data.begin()))
+    {
+        throw std::runtime_error("Invalid binary file header");
+    }
+
+    uint32_t version = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        version |= static_cast<uint32_t>(
+                       static_cast<uint8_t>(data[MAGIC.size() + i]))
+                   << (8 * i);
+    }
+
+    if (version > static_cast<uint32_t>(FileVersion::LATEST_VERSION) ||
+        version < static_cast<uint32_t>(FileVersion::INITIAL_VERSION))
+    {
+        throw std::runtime_error("Invalid file version");
+    }
+
+    offset = MAGIC.size() + 4;
+    return static_cast<FileVersion>(version);
+}
+
+void writeHeader(std::ostream &output, FileVersion version)
+{
+    output.write(MAGIC.data(), MAGIC.size());
+
+    const uint32_t val = static_cast<uint32_t>(version);
+    for (int i = 0; i < 4; ++i)
+        output.put(static_cast<char>((val >> (8 * i)) & 0xff));
+}
+}
+
+BinaryInputArchive::BinaryInputArchive(const char *begin, const char *end,
+                                       FileVersion version)
+    : myBegin(begin), myPos(begin), myEnd(end), myVersion(version)
+{
+}
+
+FileVersion BinaryInputArchive::version() const
+{
+    return myVersion;
+}
+
+size_t BinaryInputArchive::position() const
+{
+    return static_cast<size_t>(myPos - myBegin);
+}
+
+bool BinaryInputArchive::atEnd() const
+{
+    return myPos == myEnd;
+}
+
+void BinaryInputArchive::throwError(const std::string &msg)
+{
+    throw std::runtime_error(msg);
+}
+
+BinaryOutputArchive::BinaryOutputArchive(FileVersion version)
+    : myVersion(version)
+{
+}
+
+const std::string &BinaryOutputArchive::data() const
+{
+    return myData;
+}
+
+void BinaryOutputArchive::clear()
+{
+    myData.clear();
+}
+}
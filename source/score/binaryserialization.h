@@ -0,0 +1,547 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SCORE_BINARYSERIALIZATION_H
+#define SCORE_BINARYSERIALIZATION_H
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <boost/date_time/gregorian/gregorian.hpp>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include "fileversion.h"
+#include <iosfwd>
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/// A compact binary alternative to the JSON archives in serialization.h.
+/// The same serialize() methods are used, but member names are not stored -
+/// the fields are read back in the order that they were written.
+///
+/// Integers are stored as (zigzag-encoded) variable length integers, strings
+/// and containers are prefixed with their length, and each object is prefixed
+/// with its size in bytes so that a reader can skip or validate it.
+namespace ScoreUtils
+{
+namespace Binary
+{
+    /// Bytes at the start of a binary file, which distinguish it from a gzip
+    /// compressed JSON file.
+    const std::array<char, 4> MAGIC = {{ 'P', 'T', 'B', '2' }};
+
+    /// Returns whether the stream begins with the given header bytes. The
+    /// stream position is left unchanged.
+    bool hasMagic(std::istream &is, const std::array<char, 4> &magic = MAGIC);
+}
+
+class BinaryInputArchive
+{
+public:
+    /// Reads from the given range of bytes, which must remain valid for the
+    /// lifetime of the archive.
+    BinaryInputArchive(const char *begin, const char *end,
+                       FileVersion version);
+
+    FileVersion version() const;
+
+    template <typename Name, typename T>
+    void operator()(const Name &, T &obj)
+    {
+        read(obj);
+    }
+
+    /// Reads a single object (e.g. a system) that was written with
+    /// BinaryOutputArchive::writeObject().
+    template <typename T>
+    void readObject(T &obj)
+    {
+        read(obj);
+    }
+
+    /// Returns the current offset from the start of the data.
+    size_t position() const;
+
+    /// Returns true if all of the data has been consumed.
+    bool atEnd() const;
+
+protected:
+    [[noreturn]] static void throwError(const std::string &msg);
+
+    inline void require(size_t n);
+    inline uint8_t readByte();
+    inline uint64_t readVarUint();
+    inline int64_t readVarInt();
+    inline uint32_t readFixed32();
+
+    inline void read(int &val);
+    inline void read(int8_t &val);
+    inline void read(unsigned int &val);
+    inline void read(uint8_t &val);
+    inline void read(bool &val);
+    inline void read(std::string &str);
+
+    template <typename T>
+    void read(std::vector<T> &vec);
+
+    template <typename K, typename V, typename C>
+    void read(std::map<K, V, C> &map);
+
+    template <typename T, size_t N>
+    void read(std::array<T, N> &arr);
+
+    template <size_t N>
+    void read(std::bitset<N> &bits);
+
+    template <typename T>
+    void read(boost::optional<T> &val);
+
+    template <typename T>
+    void read(std::shared_ptr<T> &val);
+
+    inline void read(boost::gregorian::date &date);
+
+    template <typename T>
+    typename std::enable_if<std::is_enum<T>::value>::type read(T &val)
+    {
+        val = static_cast<T>(readVarInt());
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_class<T>::value>::type read(T &obj)
+    {
+        const uint32_t size = readFixed32();
+        require(size);
+        const char *end = myPos + size;
+
+        obj.serialize(*this, myVersion);
+
+        if (myPos != end)
+            throwError("Object size does not match its contents");
+    }
+
+    const char *myBegin;
+    const char *myPos;
+    const char *myEnd;
+    const FileVersion myVersion;
+};
+
+template <typename T>
+void loadBinary(std::istream &input, T &obj);
+
+class BinaryOutputArchive
+{
+public:
+    BinaryOutputArchive(FileVersion version);
+
+    template <typename Name, typename T>
+    void operator()(const Name &, const T &obj)
+    {
+        write(obj);
+    }
+
+    /// Writes a single object (e.g. a system) with its size prefix.
+    template <typename T>
+    void writeObject(const T &obj)
+    {
+        write(obj);
+    }
+
+    /// Returns the data that has been written.
+    const std::string &data() const;
+
+    /// Discards the written data so that the archive can be reused.
+    void clear();
+
+protected:
+    inline void writeByte(uint8_t val);
+    inline void writeVarUint(uint64_t val);
+    inline void writeVarInt(int64_t val);
+
+    inline void write(int val);
+    inline void write(int8_t val);
+    inline void write(unsigned int val);
+    inline void write(uint8_t val);
+    inline void write(bool val);
+    inline void write(const std::string &str);
+
+    template <typename T>
+    void write(const std::vector<T> &vec);
+
+    template <typename K, typename V, typename C>
+    void write(const std::map<K, V, C> &map);
+
+    template <typename T, size_t N>
+    void write(const std::array<T, N> &arr);
+
+    template <size_t N>
+    void write(const std::bitset<N> &bits);
+
+    template <typename T>
+    void write(const boost::optional<T> &val);
+
+    template <typename T>
+    void write(const std::shared_ptr<T> &val);
+
+    inline void write(const boost::gregorian::date &date);
+
+    template <typename T>
+    typename std::enable_if<std::is_enum<T>::value>::type write(const T &val)
+    {
+        writeVarInt(static_cast<int>(val));
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_class<T>::value>::type write(const T &obj)
+    {
+        // Reserve space for the size, and fill it in afterwards.
+        const size_t start = myData.size();
+        myData.append(4, '\0');
+
+        const_cast<T &>(obj).serialize(*this, myVersion);
+
+        const uint32_t size = static_cast<uint32_t>(myData.size() - start - 4);
+        for (int i = 0; i < 4; ++i)
+            myData[start + i] = static_cast<char>((size >> (8 * i)) & 0xff);
+    }
+
+    std::string myData;
+    const FileVersion myVersion;
+};
+
+/// Writes the header and the given object to the output stream.
+template <typename T>
+void saveBinary(std::ostream &output, const T &obj);
+
+void BinaryInputArchive::require(size_t n)
+{
+    if (static_cast<size_t>(myEnd - myPos) < n)
+        throwError("Unexpected end of binary data");
+}
+
+uint8_t BinaryInputArchive::readByte()
+{
+    require(1);
+    return static_cast<uint8_t>(*myPos++);
+}
+
+uint64_t BinaryInputArchive::readVarUint()
+{
+    uint64_t val = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        const uint8_t byte = readByte();
+        val |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return val;
+    }
+
+    throwError("Invalid variable length integer");
+}
+
+int64_t BinaryInputArchive::readVarInt()
+{
+    const uint64_t val = readVarUint();
+    return static_cast<int64_t>(val >> 1) ^ -static_cast<int64_t>(val & 1);
+}
+
+uint32_t BinaryInputArchive::readFixed32()
+{
+    require(4);
+    uint32_t val = 0;
+    for (int i = 0; i < 4; ++i)
+        val |= static_cast<uint32_t>(static_cast<uint8_t>(myPos[i])) << (8 * i);
+    myPos += 4;
+    return val;
+}
+
+void BinaryInputArchive::read(int &val)
+{
+    val = static_cast<int>(readVarInt());
+}
+
+void BinaryInputArchive::read(int8_t &val)
+{
+    const int64_t int_val = readVarInt();
+    if (int_val > std::numeric_limits<int8_t>::max() ||
+        int_val < std::numeric_limits<int8_t>::min())
+    {
+        throw std::overflow_error("Invalid int8_t value");
+    }
+    val = static_cast<int8_t>(int_val);
+}
+
+void BinaryInputArchive::read(unsigned int &val)
+{
+    val = static_cast<unsigned int>(readVarUint());
+}
+
+void BinaryInputArchive::read(uint8_t &val)
+{
+    val = readByte();
+}
+
+void BinaryInputArchive::read(bool &val)
+{
+    val = readByte() != 0;
+}
+
+void BinaryInputArchive::read(std::string &str)
+{
+    const uint64_t size = readVarUint();
+    require(size);
+    str.assign(myPos, size);
+    myPos += size;
+}
+
+template <typename T>
+void BinaryInputArchive::read(std::vector<T> &vec)
+{
+    const uint64_t size = readVarUint();
+    // Every element takes at least one byte, which guards against huge
+    // allocations from a corrupted size.
+    require(size);
+
+    vec.resize(size);
+    for (T &obj : vec)
+        read(obj);
+}
+
+template <typename K, typename V, typename C>
+void BinaryInputArchive::read(std::map<K, V, C> &map)
+{
+    const uint64_t size = readVarUint();
+    require(size);
+
+    for (uint64_t i = 0; i < size; ++i)
+    {
+        K key;
+        read(key);
+        read(map[key]);
+    }
+}
+
+template <typename T, size_t N>
+void BinaryInputArchive::read(std::array<T, N> &arr)
+{
+    for (T &obj : arr)
+        read(obj);
+}
+
+template <size_t N>
+void BinaryInputArchive::read(std::bitset<N> &bits)
+{
+    const size_t num_bytes = (N + 7) / 8;
+    require(num_bytes);
+
+    bits.reset();
+    for (size_t i = 0; i < N; ++i)
+    {
+        if (static_cast<uint8_t>(myPos[i / 8]) & (1 << (i % 8)))
+            bits.set(i);
+    }
+
+    myPos += num_bytes;
+}
+
+template <typename T>
+void BinaryInputArchive::read(boost::optional<T> &val)
+{
+    bool has_value;
+    read(has_value);
+
+    if (has_value)
+    {
+        T data;
+        read(data);
+        val = std::move(data);
+    }
+    else
+        val.reset();
+}
+
+template <typename T>
+void BinaryInputArchive::read(std::shared_ptr<T> &val)
+{
+    // Shared objects (e.g. systems) are never null.
+    val = std::make_shared<T>();
+    read(*val);
+}
+
+void BinaryInputArchive::read(boost::gregorian::date &date)
+{
+    std::string date_str;
+    read(date_str);
+    date = boost::gregorian::from_undelimited_string(date_str);
+}
+
+void BinaryOutputArchive::writeByte(uint8_t val)
+{
+    myData.push_back(static_cast<char>(val));
+}
+
+void BinaryOutputArchive::writeVarUint(uint64_t val)
+{
+    while (val >= 0x80)
+    {
+        writeByte(static_cast<uint8_t>(val) | 0x80);
+        val >>= 7;
+    }
+
+    writeByte(static_cast<uint8_t>(val));
+}
+
+void BinaryOutputArchive::writeVarInt(int64_t val)
+{
+    // Zigzag encoding, so that small negative numbers are also compact.
+    writeVarUint((static_cast<uint64_t>(val) << 1) ^
+                 static_cast<uint64_t>(val >> 63));
+}
+
+void BinaryOutputArchive::write(int val)
+{
+    writeVarInt(val);
+}
+
+void BinaryOutputArchive::write(int8_t val)
+{
+    writeVarInt(val);
+}
+
+void BinaryOutputArchive::write(unsigned int val)
+{
+    writeVarUint(val);
+}
+
+void BinaryOutputArchive::write(uint8_t val)
+{
+    writeByte(val);
+}
+
+void BinaryOutputArchive::write(bool val)
+{
+    writeByte(val ? 1 : 0);
+}
+
+void BinaryOutputArchive::write(const std::string &str)
+{
+    writeVarUint(str.size());
+    myData.append(str);
+}
+
+template <typename T>
+void BinaryOutputArchive::write(const std::vector<T> &vec)
+{
+    writeVarUint(vec.size());
+    for (const T &obj : vec)
+        write(obj);
+}
+
+template <typename K, typename V, typename C>
+void BinaryOutputArchive::write(const std::map<K, V, C> &map)
+{
+    writeVarUint(map.size());
+    for (const auto &pair : map)
+    {
+        write(pair.first);
+        write(pair.second);
+    }
+}
+
+template <typename T, size_t N>
+void BinaryOutputArchive::write(const std::array<T, N> &arr)
+{
+    for (const T &obj : arr)
+        write(obj);
+}
+
+template <size_t N>
+void BinaryOutputArchive::write(const std::bitset<N> &bits)
+{
+    for (size_t i = 0; i < N; i += 8)
+    {
+        uint8_t byte = 0;
+        for (size_t j = i; j < std::min(N, i + 8); ++j)
+        {
+            if (bits.test(j))
+                byte |= 1 << (j - i);
+        }
+
+        writeByte(byte);
+    }
+}
+
+template <typename T>
+void BinaryOutputArchive::write(const boost::optional<T> &val)
+{
+    write(static_cast<bool>(val));
+    if (val)
+        write(*val);
+}
+
+template <typename T>
+void BinaryOutputArchive::write(const std::shared_ptr<T> &val)
+{
+    write(*val);
+}
+
+void BinaryOutputArchive::write(const boost::gregorian::date &date)
+{
+    write(boost::gregorian::to_iso_string(date));
+}
+
+namespace Binary
+{
+    /// Reads the header and returns the file version. The contents of the
+    /// stream are returned through the data parameter.
+    FileVersion readHeader(std::istream &input, std::string &data,
+                           size_t &offset);
+
+    /// Writes the header for the given file version.
+    void writeHeader(std::ostream &output, FileVersion version);
+}
+
+template <typename T>
+void loadBinary(std::istream &input, T &obj)
+{
+    std::string data;
+    size_t offset = 0;
+    const FileVersion version = Binary::readHeader(input, data, offset);
+
+    BinaryInputArchive ar(data.data() + offset, data.data() + data.size(),
+                          version);
+    ar.readObject(obj);
+}
+
+template <typename T>
+void saveBinary(std::ostream &output, const T &obj)
+{
+    Binary::writeHeader(output, FileVersion::LATEST_VERSION);
+
+    BinaryOutputArchive ar(FileVersion::LATEST_VERSION);
+    ar.writeObject(obj);
+    output.write(ar.data().data(),
+                 static_cast<std::streamsize>(ar.data().size()));
+}
+}
+
+#endif
@@ -17,17 +17,166 @@
 
 #include "score.h"
 
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <unordered_map>
+
+SystemLoader::~SystemLoader()
+{
+}
+
+#ifndef NDEBUG
+namespace
+{
+/// Debug check for code that holds a System& across getSystemSnapshot() and
+/// then modifies the snapshot through it. A copy of each system is kept while
+/// snapshots of it exist, and is compared against the system the next time
+/// that it is snapshotted or copied before modification.
+class SnapshotChecker
+{
+public:
+    SnapshotChecker() : myPruneSize(64)
+    {
+    }
+
+    /// Checks a node that is about to be returned as a snapshot, and starts
+    /// tracking it if necessary.
+    void onSnapshot(const std::shared_ptr<System> &node)
+    {
+        std::lock_guard<std::mutex> lock(myMutex);
+        if (check(node))
+            return;
+
+        if (myEntries.size() >= myPruneSize)
+        {
+            for (auto it = myEntries.begin(); it != myEntries.end();)
+            {
+                if (it->second.myNode.expired())
+                    it = myEntries.erase(it);
+                else
+                    ++it;
+            }
+
+            myPruneSize = std::max<size_t>(64, 2 * myEntries.size());
+        }
+
+        myEntries.emplace(node.get(), Entry{ node, *node });
+    }
+
+    /// Checks a shared node that is about to be copied for modification.
+    void onDetach(const std::shared_ptr<System> &node)
+    {
+        std::lock_guard<std::mutex> lock(myMutex);
+        check(node);
+    }
+
+    /// Stops tracking a node that is about to be modified by its only owner.
+    void onModify(const System *node)
+    {
+        std::lock_guard<std::mutex> lock(myMutex);
+        myEntries.erase(node);
+    }
+
+private:
+    struct Entry
+    {
+        std::weak_ptr<System> myNode;
+        System myCopy;
+    };
+
+    /// Returns false if the node is not tracked.
+    bool check(const std::shared_ptr<System> &node)
+    {
+        auto it = myEntries.find(node.get());
+        if (it == myEntries.end())
+            return false;
+
+        // The address may have been reused by a new node.
+        if (it->second.myNode.lock() != node)
+        {
+            myEntries.erase(it);
+            return false;
+        }
+
+        assert(*node == it->second.myCopy &&
+               "A snapshot was modified through a System& that was held "
+               "across Score::getSystemSnapshot()");
+        return true;
+    }
+
+    std::mutex myMutex;
+    std::unordered_map<const System *, Entry> myEntries;
+    size_t myPruneSize;
+};
+
+SnapshotChecker theSnapshotChecker;
+}
+#endif
+
 const int Score::MIN_LINE_SPACING = 6;
 const int Score::MAX_LINE_SPACING = 14;
 
 Score::Score()
-    : myLineSpacing(9)
+    : myLineSpacing(9),
+      myAccessCount(0),
+      myLoadedMemory(0),
+      myMemoryBudget(0),
+      myNumValidPlayerChanges(0)
 {
 }
 
+Score::Score(const Score &other)
+    : myLineSpacing(9),
+      myAccessCount(0),
+      myLoadedMemory(0),
+      myMemoryBudget(0),
+      myNumValidPlayerChanges(0)
+{
+    *this = other;
+}
+
+Score &Score::operator=(const Score &other)
+{
+    if (this == &other)
+        return *this;
+
+    std::lock(myLoaderMutex, other.myLoaderMutex);
+    std::lock_guard<std::mutex> lock(myLoaderMutex, std::adopt_lock);
+    std::lock_guard<std::mutex> other_lock(other.myLoaderMutex,
+                                           std::adopt_lock);
+
+    myScoreInfo = other.myScoreInfo;
+    mySystems = other.mySystems;
+    myPlayers = other.myPlayers;
+    myInstruments = other.myInstruments;
+    myLineSpacing = other.myLineSpacing;
+    myViewFilters = other.myViewFilters;
+
+    // Systems that have not been loaded yet are loaded separately by each
+    // copy.
+    mySystemLoader = other.mySystemLoader;
+    myLazySystems = other.myLazySystems;
+    myAccessCount = other.myAccessCount;
+    myLoadedMemory = other.myLoadedMemory;
+    myMemoryBudget = other.myMemoryBudget;
+
+    // The player change index is rebuilt on demand.
+    invalidatePlayerChanges(0);
+
+    return *this;
+}
+
 bool Score::operator==(const Score &other) const
 {
-    return myScoreInfo == other.myScoreInfo && mySystems == other.mySystems &&
+    // Compare the systems through getSystems() so that they are loaded first.
+    auto systems = getSystems();
+    auto other_systems = other.getSystems();
+
+    return myScoreInfo == other.myScoreInfo &&
+           systems.size() == other_systems.size() &&
+           std::equal(systems.begin(), systems.end(),
+                      other_systems.begin()) &&
            myPlayers == other.myPlayers &&
            myInstruments == other.myInstruments &&
            myLineSpacing == other.myLineSpacing &&
@@ -46,25 +195,252 @@ void Score::setScoreInfo(const ScoreInfo &info)
 
 boost::iterator_range<Score::SystemIterator> Score::getSystems()
 {
-    return boost::make_iterator_range(mySystems);
+    return boost::make_iterator_range(
+        SystemIterator(mySystems.begin(), this),
+        SystemIterator(mySystems.end(), this));
 }
 
 boost::iterator_range<Score::SystemConstIterator> Score::getSystems() const
 {
-    return boost::make_iterator_range(mySystems);
+    return boost::make_iterator_range(
+        SystemConstIterator(mySystems.begin(), this),
+        SystemConstIterator(mySystems.end(), this));
 }
 
 void Score::insertSystem(const System &system, int index)
 {
     if (index < 0)
-        mySystems.push_back(system);
-    else
-        mySystems.insert(mySystems.begin() + index, system);
+        index = static_cast<int>(mySystems.size());
+
+    mySystems.insert(mySystems.begin() + index,
+                     std::make_shared<System>(system));
+
+    if (mySystemLoader)
+    {
+        std::lock_guard<std::mutex> lock(myLoaderMutex);
+        const LazySystem lazy = { -1, true, true, ++myAccessCount, 0 };
+        myLazySystems.insert(myLazySystems.begin() + index, lazy);
+    }
+
+    invalidatePlayerChanges(index);
+}
+
+void Score::insertSystem(std::shared_ptr<const System> system, int index)
+{
+    if (index < 0)
+        index = static_cast<int>(mySystems.size());
+
+    // The system is copied before it is modified, since it is shared.
+    mySystems.insert(mySystems.begin() + index,
+                     std::const_pointer_cast<System>(system));
+
+    if (mySystemLoader)
+    {
+        std::lock_guard<std::mutex> lock(myLoaderMutex);
+        const LazySystem lazy = { -1, true, true, ++myAccessCount, 0 };
+        myLazySystems.insert(myLazySystems.begin() + index, lazy);
+    }
+
+    invalidatePlayerChanges(index);
 }
 
 void Score::removeSystem(int index)
 {
     mySystems.erase(mySystems.begin() + index);
+
+    if (mySystemLoader)
+    {
+        std::lock_guard<std::mutex> lock(myLoaderMutex);
+        const LazySystem &lazy = myLazySystems[index];
+        if (lazy.myLoaded)
+            myLoadedMemory -= lazy.myMemoryUsage;
+
+        myLazySystems.erase(myLazySystems.begin() + index);
+    }
+
+    invalidatePlayerChanges(index);
+}
+
+std::shared_ptr<const System> Score::getSystemSnapshot(int index) const
+{
+    std::lock_guard<std::mutex> lock(myLoaderMutex);
+    if (mySystemLoader)
+        loadSystem(index);
+
+#ifndef NDEBUG
+    theSnapshotChecker.onSnapshot(mySystems[index]);
+#endif
+    return mySystems[index];
+}
+
+void Score::setSystem(int index, std::shared_ptr<const System> system)
+{
+    mySystems[index] = std::const_pointer_cast<System>(system);
+
+    if (mySystemLoader)
+        markSystemLoaded(index);
+
+    invalidatePlayerChanges(index);
+}
+
+const System *Score::getSystemNode(int index) const
+{
+    std::lock_guard<std::mutex> lock(myLoaderMutex);
+    return mySystems[index].get();
+}
+
+void Score::setSystemLoader(std::unique_ptr<SystemLoader> loader,
+                            size_t memory_budget)
+{
+    std::lock_guard<std::mutex> lock(myLoaderMutex);
+
+    mySystemLoader = std::move(loader);
+    myMemoryBudget = memory_budget;
+    myLoadedMemory = 0;
+    myLazySystems.clear();
+
+    if (!mySystemLoader)
+        return;
+
+    // Discard any existing contents until the system is loaded.
+    const auto placeholder = std::make_shared<System>();
+
+    for (size_t i = 0; i < mySystems.size(); ++i)
+    {
+        const int index = static_cast<int>(i);
+        const LazySystem lazy = { index, false, false, 0,
+                                  mySystemLoader->getMemoryUsage(index) };
+        myLazySystems.push_back(lazy);
+        mySystems[i] = placeholder;
+    }
+}
+
+bool Score::hasSystemLoader() const
+{
+    return mySystemLoader != nullptr;
+}
+
+bool Score::isSystemLoaded(int index) const
+{
+    std::lock_guard<std::mutex> lock(myLoaderMutex);
+    return !mySystemLoader || myLazySystems[index].myLoaded;
+}
+
+void Score::loadAllSystems()
+{
+    if (!mySystemLoader)
+        return;
+
+    for (size_t i = 0; i < mySystems.size(); ++i)
+        lockSystem(i, false);
+
+    setSystemLoader(nullptr, 0);
+}
+
+void Score::releaseSystems() const
+{
+    std::lock_guard<std::mutex> lock(myLoaderMutex);
+    if (!mySystemLoader || myLoadedMemory <= myMemoryBudget)
+        return;
+
+    const auto placeholder = std::make_shared<System>();
+
+    std::vector<size_t> candidates;
+    for (size_t i = 0; i < myLazySystems.size(); ++i)
+    {
+        // Skip systems that are still referenced elsewhere (e.g. by a
+        // snapshot or a copy of the score), since unloading them would not
+        // free any memory.
+        const LazySystem &lazy = myLazySystems[i];
+        if (lazy.myLoaded && !lazy.myModified &&
+            mySystems[i].use_count() == 1)
+        {
+            candidates.push_back(i);
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [&](size_t a, size_t b) {
+        return myLazySystems[a].myLastAccess < myLazySystems[b].myLastAccess;
+    });
+
+    for (size_t i : candidates)
+    {
+        if (myLoadedMemory <= myMemoryBudget)
+            break;
+
+        LazySystem &lazy = myLazySystems[i];
+        lazy.myLoaded = false;
+        myLoadedMemory -= lazy.myMemoryUsage;
+
+        // The system can be reloaded later, so this does not change the
+        // logical contents of the score.
+        const_cast<std::shared_ptr<System> &>(mySystems[i]) = placeholder;
+    }
+}
+
+System &Score::lockSystem(size_t index, bool modify) const
+{
+    std::lock_guard<std::mutex> lock(myLoaderMutex);
+    if (mySystemLoader)
+        loadSystem(index);
+
+    // Copy a shared system before it can be modified. This is done under the
+    // lock so that a concurrent copy of the score sees either the old or the
+    // new node.
+    auto &node = const_cast<std::shared_ptr<System> &>(mySystems[index]);
+    if (modify)
+    {
+        if (node.use_count() > 1)
+        {
+#ifndef NDEBUG
+            theSnapshotChecker.onDetach(node);
+#endif
+            node = std::make_shared<System>(*node);
+        }
+#ifndef NDEBUG
+        else
+            theSnapshotChecker.onModify(node.get());
+#endif
+
+        // The node is now only reachable from this score and is about to be
+        // written to, so it can no longer be reloaded from the loader.
+        if (mySystemLoader)
+            myLazySystems[index].myModified = true;
+    }
+
+    return *node;
+}
+
+void Score::loadSystem(size_t index) const
+{
+    LazySystem &lazy = myLazySystems[index];
+    if (!lazy.myLoaded)
+    {
+        // Load into a new node, since the placeholder may be shared with
+        // copies of the score.
+        auto system = std::make_shared<System>();
+        mySystemLoader->load(lazy.myIndex, *system);
+        const_cast<std::shared_ptr<System> &>(mySystems[index]) = system;
+        lazy.myLoaded = true;
+        myLoadedMemory += lazy.myMemoryUsage;
+    }
+
+    lazy.myLastAccess = ++myAccessCount;
+}
+
+void Score::markSystemLoaded(size_t index)
+{
+    std::lock_guard<std::mutex> lock(myLoaderMutex);
+
+    LazySystem &lazy = myLazySystems[index];
+    if (!lazy.myLoaded)
+    {
+        lazy.myLoaded = true;
+        myLoadedMemory += lazy.myMemoryUsage;
+    }
+
+    lazy.myModified = true;
+    lazy.myLastAccess = ++myAccessCount;
 }
 
 boost::iterator_range<Score::PlayerIterator> Score::getPlayers()
@@ -137,6 +513,75 @@ void Score::removeViewFilter(int index)
     myViewFilters.erase(myViewFilters.begin() + index);
 }
 
+const PlayerChange *Score::getCurrentPlayers(int system_index,
+                                             int position) const
+{
+    if (system_index < 0)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(myPlayerChangeMutex);
+
+    const size_t index =
+        std::min(static_cast<size_t>(system_index), mySystems.size());
+    updatePlayerChangeIndex(index);
+
+    // Find the last player change in this system before the position.
+    if (index < mySystems.size())
+    {
+        auto changes = getSystems()[index].getPlayerChanges();
+        auto it = std::upper_bound(
+            changes.begin(), changes.end(), position,
+            [](int pos, const PlayerChange &change) {
+                return pos < change.getPosition();
+            });
+
+        if (it != changes.begin())
+            return &*std::prev(it);
+    }
+
+    // Otherwise, use the last player change from the previous systems.
+    int prev = myPrevPlayerChanges[index];
+    if (prev >= 0 && getSystems()[prev].getPlayerChanges().empty())
+    {
+        // The player changes were removed without invalidating the index.
+        myNumValidPlayerChanges = prev + 1;
+        updatePlayerChangeIndex(index);
+        prev = myPrevPlayerChanges[index];
+    }
+
+    if (prev < 0)
+        return nullptr;
+
+    return &getSystems()[prev].getPlayerChanges().back();
+}
+
+void Score::invalidatePlayerChanges(int system_index)
+{
+    std::lock_guard<std::mutex> lock(myPlayerChangeMutex);
+
+    // The entry for a system only depends on the systems before it.
+    myNumValidPlayerChanges =
+        std::min(myNumValidPlayerChanges,
+                 static_cast<size_t>(std::max(system_index, 0)) + 1);
+}
+
+void Score::updatePlayerChangeIndex(size_t index) const
+{
+    myPrevPlayerChanges.resize(mySystems.size() + 1);
+
+    for (size_t i = myNumValidPlayerChanges; i <= index; ++i)
+    {
+        if (i == 0)
+            myPrevPlayerChanges[i] = -1;
+        else if (getSystems()[i - 1].getPlayerChanges().empty())
+            myPrevPlayerChanges[i] = myPrevPlayerChanges[i - 1];
+        else
+            myPrevPlayerChanges[i] = static_cast<int>(i - 1);
+    }
+
+    myNumValidPlayerChanges = std::max(myNumValidPlayerChanges, index + 1);
+}
+
 int Score::getLineSpacing() const
 {
     return myLineSpacing;
@@ -154,27 +599,7 @@ const PlayerChange *ScoreUtils::getCurrentPlayers(const Score &score,
                                                   int systemIndex,
                                                   int positionIndex)
 {
-    const PlayerChange *lastChange = nullptr;
-
-    int i = 0;
-    for (const System &system : score.getSystems())
-    {
-        if (i > systemIndex)
-            break;
-
-        for (const PlayerChange &change : system.getPlayerChanges())
-        {
-            if (i < systemIndex ||
-               (i == systemIndex && change.getPosition() <= positionIndex))
-            {
-                lastChange = &change;
-            }
-        }
-
-        ++i;
-    }
-
-    return lastChange;
+    return score.getCurrentPlayers(systemIndex, positionIndex);
 }
 
 void ScoreUtils::adjustRehearsalSigns(Score &score)
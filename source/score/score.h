@@ -18,22 +18,117 @@
 #ifndef SCORE_SCORE_H
 #define SCORE_SCORE_H
 
+#include <boost/iterator/iterator_adaptor.hpp>
 #include <boost/range/iterator_range_core.hpp>
+#include <cstdint>
 #include "fileversion.h"
 #include "instrument.h"
+#include <memory>
+#include <mutex>
 #include "player.h"
 #include "scoreinfo.h"
 #include "system.h"
+#include <type_traits>
 #include "viewfilter.h"
 #include <vector>
 
 class PlayerChange;
+class Score;
 
+/// Base class for archives that store the systems of a score separately from
+/// the rest of the score. When writing the score with such an archive, the
+/// systems that are loaded on demand do not need to be loaded first.
+struct PartialScoreArchive
+{
+};
+
+/// Provides the contents of systems that are loaded on demand
+/// (see Score::setSystemLoader()).
+class SystemLoader
+{
+public:
+    virtual ~SystemLoader();
+
+    /// Loads the contents of a system. The index refers to the position of
+    /// the system when the loader was attached to the score. The loader is
+    /// shared by copies of the score, so this may be called concurrently.
+    virtual void load(int index, System &system) = 0;
+
+    /// Returns the approximate amount of memory (in bytes) that is used by the
+    /// system once it has been loaded.
+    virtual size_t getMemoryUsage(int index) const = 0;
+};
+
+/// Iterator over the systems in a score, which ensures that each system has
+/// been loaded before it is accessed. Since systems may be shared with copies
+/// of the score, a system is copied before it is accessed through a mutable
+/// iterator if it is shared. Read-only code should use const access to avoid
+/// these copies.
+template <typename SystemT, typename BaseIterator>
+class LazySystemIterator
+    : public boost::iterator_adaptor<LazySystemIterator<SystemT, BaseIterator>,
+                                     BaseIterator, SystemT>
+{
+public:
+    typedef typename LazySystemIterator::iterator_adaptor_::difference_type
+        difference_type;
+
+    LazySystemIterator() : myScore(nullptr)
+    {
+    }
+
+    LazySystemIterator(BaseIterator it, const Score *score)
+        : LazySystemIterator::iterator_adaptor_(it), myScore(score)
+    {
+    }
+
+    /// Allow conversions from a mutable iterator to a const iterator.
+    template <typename OtherSystem, typename OtherIterator>
+    LazySystemIterator(
+        const LazySystemIterator<OtherSystem, OtherIterator> &other,
+        typename std::enable_if<std::is_convertible<
+            OtherIterator, BaseIterator>::value>::type * = nullptr)
+        : LazySystemIterator::iterator_adaptor_(other.base()),
+          myScore(other.getScore())
+    {
+    }
+
+    /// Returns a reference rather than the proxy object from
+    /// boost::iterator_facade, so that e.g. getSystems()[i].getStaves() works.
+    SystemT &operator[](difference_type n) const
+    {
+        return *(*this + n);
+    }
+
+    const Score *getScore() const
+    {
+        return myScore;
+    }
+
+private:
+    friend class boost::iterator_core_access;
+
+    SystemT &dereference() const;
+
+    const Score *myScore;
+};
+
+/// Systems are stored as reference-counted nodes, so that copying a score only
+/// copies pointers to its systems. A system is copied the first time that it is
+/// modified while it is shared with another score or with a snapshot from
+/// getSystemSnapshot().
+///
+/// The copy is only made when a mutable reference is obtained, so a System&
+/// must not be held across a call to getSystemSnapshot() (or a copy of the
+/// score) and then used to modify the system, since that would also modify
+/// the snapshot. Take the snapshots first, or obtain the reference again.
 class Score
 {
 public:
-    typedef std::vector<System>::iterator SystemIterator;
-    typedef std::vector<System>::const_iterator SystemConstIterator;
+    typedef std::vector<std::shared_ptr<System>> SystemList;
+    typedef LazySystemIterator<System, SystemList::iterator> SystemIterator;
+    typedef LazySystemIterator<const System, SystemList::const_iterator>
+        SystemConstIterator;
     typedef std::vector<Player>::iterator PlayerIterator;
     typedef std::vector<Player>::const_iterator PlayerConstIterator;
     typedef std::vector<Instrument>::iterator InstrumentIterator;
@@ -42,8 +137,10 @@ public:
     typedef std::vector<ViewFilter>::const_iterator ViewFilterConstIterator;
 
     Score();
-    Score(const Score &other) = delete;
-    Score &operator=(const Score &other) = delete;
+    /// Creates a snapshot of the score. The systems are shared rather than
+    /// copied, so this is cheap even for large scores.
+    Score(const Score &other);
+    Score &operator=(const Score &other);
     bool operator==(const Score &other) const;
 
     template <class Archive>
@@ -54,16 +151,64 @@ public:
     /// Sets information about the score (e.g. title, author, etc.).
     void setScoreInfo(const ScoreInfo &info);
 
-    /// Returns the set of systems in the score.
+    /// Returns the set of systems in the score. Dereferencing a mutable
+    /// iterator counts as modifying the system (it is copied if shared, and
+    /// is never unloaded), so code that only reads the systems should use the
+    /// const overload.
     boost::iterator_range<SystemIterator> getSystems();
     /// Returns the set of systems in the score.
     boost::iterator_range<SystemConstIterator> getSystems() const;
 
     /// Adds a new system to the score, optionally at a specific index.
     void insertSystem(const System &system, int index = -1);
+    /// Adds a system from a snapshot to the score, without copying it.
+    void insertSystem(std::shared_ptr<const System> system, int index = -1);
     /// Removes the specified system from the score.
     void removeSystem(int index);
 
+    /// Returns a snapshot of the system, which is unaffected by any later
+    /// changes to the score, provided that no System& obtained before this
+    /// call is used to modify the system afterwards. Debug builds check for
+    /// this when the system is next snapshotted or copied.
+    std::shared_ptr<const System> getSystemSnapshot(int index) const;
+    /// Replaces a system with a snapshot from getSystemSnapshot().
+    void setSystem(int index, std::shared_ptr<const System> system);
+    /// Returns the node that currently holds the system, without loading it.
+    /// This changes when the system is replaced, or is copied before being
+    /// modified, so it identifies whether a snapshot is still shared with the
+    /// score.
+    const System *getSystemNode(int index) const;
+
+    /// Replaces the contents of the systems with placeholders that are loaded
+    /// by the loader the first time that they are accessed. Systems which have
+    /// not been modified may be unloaded again by releaseSystems() if more
+    /// than memory_budget bytes are in use.
+    void setSystemLoader(std::unique_ptr<SystemLoader> loader,
+                         size_t memory_budget);
+    /// Returns whether any systems are loaded on demand.
+    bool hasSystemLoader() const;
+    /// Returns whether the specified system is currently in memory.
+    bool isSystemLoaded(int index) const;
+    /// Loads any systems that have not been loaded yet, and stops loading
+    /// systems on demand.
+    void loadAllSystems();
+    /// Unloads the least recently used systems that have not been modified
+    /// until the memory budget is met. Any references to those systems are
+    /// invalidated, so this should only be called once e.g. rendering is
+    /// complete. Systems that are shared with a snapshot or a copy of the
+    /// score are kept, so a snapshot can be held to keep a system alive.
+    void releaseSystems() const;
+
+    /// Returns the active player change at the given position, if any.
+    /// The systems that contain player changes are indexed on demand, so
+    /// this does not need to scan the preceding systems.
+    const PlayerChange *getCurrentPlayers(int system_index,
+                                          int position) const;
+    /// Must be called after player changes are added to or removed from the
+    /// specified system. Inserting, removing, or replacing systems through
+    /// the score already does this.
+    void invalidatePlayerChanges(int system_index);
+
     /// Returns the set of players in the score.
     boost::iterator_range<PlayerIterator> getPlayers();
     /// Returns the set of players in the score.
@@ -105,18 +250,81 @@ public:
     static const int MAX_LINE_SPACING;
 
 private:
+    template <typename SystemT, typename BaseIterator>
+    friend class LazySystemIterator;
+
+    /// Tracks the state of a system that is loaded on demand.
+    struct LazySystem
+    {
+        int myIndex; ///< The loader's index for the system, or -1.
+        bool myLoaded;
+        bool myModified; ///< Modified systems are never unloaded.
+        uint64_t myLastAccess;
+        size_t myMemoryUsage;
+    };
+
+    /// Returns the system, after loading it if necessary. If the system will
+    /// be modified and is shared, it is copied first, and it is then marked
+    /// as modified.
+    System &accessSystem(size_t index, bool modify) const;
+    System &lockSystem(size_t index, bool modify) const;
+    /// Loads the system if necessary. myLoaderMutex must be held.
+    void loadSystem(size_t index) const;
+    /// Records that a system was replaced without being loaded.
+    void markSystemLoaded(size_t index);
+    /// Brings the player change index up to date for the given system.
+    void updatePlayerChangeIndex(size_t index) const;
+
     // TODO - add font settings, chord diagrams, etc.
     ScoreInfo myScoreInfo;
-    std::vector<System> mySystems;
+    SystemList mySystems;
     std::vector<Player> myPlayers;
     std::vector<Instrument> myInstruments;
     int myLineSpacing; ///< Spacing between tab lines (in pixels).
     std::vector<ViewFilter> myViewFilters;
+
+    std::shared_ptr<SystemLoader> mySystemLoader;
+    mutable std::vector<LazySystem> myLazySystems;
+    mutable uint64_t myAccessCount;
+    mutable size_t myLoadedMemory;
+    size_t myMemoryBudget;
+    mutable std::mutex myLoaderMutex;
+
+    /// For each system, the index of the last preceding system that has a
+    /// player change (or -1). There is an extra entry for the end of the
+    /// score, and only the first myNumValidPlayerChanges entries are valid.
+    mutable std::vector<int> myPrevPlayerChanges;
+    mutable size_t myNumValidPlayerChanges;
+    mutable std::mutex myPlayerChangeMutex;
 };
 
+template <typename SystemT, typename BaseIterator>
+SystemT &LazySystemIterator<SystemT, BaseIterator>::dereference() const
+{
+    if (!myScore)
+        return **this->base();
+
+    return myScore->accessSystem(this->base() - myScore->mySystems.begin(),
+                                 !std::is_const<SystemT>::value);
+}
+
+inline System &Score::accessSystem(size_t index, bool modify) const
+{
+    // Reading a system that is always in memory does not require the lock,
+    // since only this score's owner can replace it.
+    if (!mySystemLoader && !modify)
+        return *mySystems[index];
+
+    return lockSystem(index, modify);
+}
+
 template <class Archive>
 void Score::serialize(Archive &ar, const FileVersion version)
 {
+    if (!std::is_base_of<PartialScoreArchive, Archive>::value)
+        loadAllSystems();
+    invalidatePlayerChanges(0);
+
     ar("score_info", myScoreInfo);
     ar("systems", mySystems);
     ar("players", myPlayers);
@@ -17,26 +17,15 @@
 
 #include "serialization.h"
 
-#include <rapidjson/error/en.h>
-
 namespace ScoreUtils
 {
-InputArchive::InputArchive(std::istream &is) : myStream(is)
+InputArchive::InputArchive(std::istream &is)
+    : myParser(is), myHasMember(false)
 {
-    if (!is)
-        throw std::runtime_error("Could not open stream");
-
-    myDocument.ParseStream<0>(myStream);
-
-    if (myDocument.HasParseError())
-    {
-        throw std::runtime_error("Parse error at offset " +
-                                 std::to_string(myDocument.GetErrorOffset()) +
-                                 ": " +
-                                 GetParseError_En(myDocument.GetParseError()));
-    }
-
-    myIterators.push(myDocument.MemberBegin());
+    // Values are read from the stream as they are requested, rather than
+    // parsing the entire document up front.
+    myParser.startObject();
+    advance();
 
     (*this)("version", myVersion);
 }
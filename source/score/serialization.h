@@ -22,14 +22,14 @@
 #include <boost/date_time/gregorian/gregorian.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/optional.hpp>
-#include <boost/variant.hpp>
 #include <bitset>
 #include "fileversion.h"
+#include <limits>
 #include <map>
-#include <rapidjson/document.h>
+#include <memory>
 #include <rapidjson/prettywriter.h>
-#include <stack>
 #include <stdexcept>
+#include <util/jsonpullparser.h>
 #include <util/rapidjson_iostreams.h>
 #include <vector>
 
@@ -43,75 +43,41 @@ public:
     FileVersion version() const;
 
     template <typename T>
-    void operator()(const std::string &expectedName, T &obj)
+    void operator()(const char *expectedName, T &obj)
     {
-        if (expectedName != name())
+        if (!myHasMember || myName != expectedName)
         {
             throw std::runtime_error(
                 std::string("Unexpected or missing JSON data: found ") +
-                name() + ", expected " + expectedName);
+                (myHasMember ? myName : std::string()) + ", expected " +
+                expectedName);
         }
 
         read(obj);
         advance();
     }
 
-private:
-    typedef rapidjson::GenericValue<rapidjson::UTF8<> > JSONValue;
-
-    struct ValueVisitor : public boost::static_visitor<const JSONValue &>
-    {
-        const JSONValue &operator()(
-            const JSONValue::ConstMemberIterator &it) const
-        {
-            return it->value;
-        }
-
-        const JSONValue &operator()(
-            const JSONValue::ConstValueIterator &it) const
-        {
-            return *it;
-        }
-    };
-
-    struct NameVisitor : public boost::static_visitor<std::string>
-    {
-        std::string operator()(const JSONValue::ConstMemberIterator &it) const
-        {
-            return it->name.GetString();
-        }
-
-        std::string operator()(const JSONValue::ConstValueIterator &) const
-        {
-            throw std::logic_error("Cannot read the name of an array element");
-        }
-    };
-
-    struct AdvanceVisitor : public boost::static_visitor<void>
-    {
-        template <typename Iterator>
-        void operator()(Iterator &it) const
-        {
-            ++it;
-        }
-    };
-
-    void advance()
+    template <typename T>
+    void operator()(const std::string &expectedName, T &obj)
     {
-        AdvanceVisitor visitor;
-        myIterators.top().apply_visitor(visitor);
+        (*this)(expectedName.c_str(), obj);
     }
 
-    std::string name() const
+private:
+    /// Moves to the next member of the current object, if any.
+    void advance()
     {
-        NameVisitor visitor;
-        return myIterators.top().apply_visitor(visitor);
+        myHasMember = myParser.nextMember(myName);
     }
 
-    const JSONValue &value() const
+    /// Skips any remaining members of the current object.
+    void finishObject()
     {
-        ValueVisitor visitor;
-        return myIterators.top().apply_visitor(visitor);
+        while (myHasMember)
+        {
+            myParser.skipValue();
+            advance();
+        }
     }
 
     inline void read(int &val);
@@ -136,30 +102,35 @@ private:
     template <typename T>
     void read(boost::optional<T> &val);
 
+    template <typename T>
+    void read(std::shared_ptr<T> &val);
+
     inline void read(boost::gregorian::date &date);
 
     template <typename T>
     typename std::enable_if<std::is_enum<T>::value>::type read(T &val)
     {
-        val = static_cast<T>(value().GetInt());
+        int int_val;
+        read(int_val);
+        val = static_cast<T>(int_val);
     }
 
     template <typename T>
     typename std::enable_if<std::is_class<T>::value>::type read(T &obj)
     {
-        myIterators.push(value().MemberBegin());
+        myParser.startObject();
+        advance();
         obj.serialize(*this, myVersion);
-        myIterators.pop();
+        finishObject();
     }
 
-    Util::RapidJSON::IStreamWrapper myStream;
-    rapidjson::Document myDocument;
+    Util::JsonPullParser myParser;
     FileVersion myVersion;
 
-	// Iterate over both objects and arrays in a uniform manner.
-    typedef boost::variant<JSONValue::ConstMemberIterator,
-                           JSONValue::ConstValueIterator> Iterator;
-    std::stack<Iterator> myIterators;
+    /// The name of the current member, which is reused to avoid allocations.
+    std::string myName;
+    /// Whether there is a current member, or the end of the object was found.
+    bool myHasMember;
 };
 
 template <typename T>
@@ -209,6 +180,9 @@ private:
     template <typename T>
     void write(const boost::optional<T> &val);
 
+    template <typename T>
+    void write(const std::shared_ptr<T> &val);
+
     inline void write(const boost::gregorian::date &date);
 
     template <typename T>
@@ -239,12 +213,19 @@ void save(std::ostream &output, const std::string &name, const T &obj)
 
 void InputArchive::read(int &val)
 {
-    val = value().GetInt();
+    const int64_t int_val = myParser.readInt();
+    if (int_val > std::numeric_limits<int>::max() ||
+        int_val < std::numeric_limits<int>::min())
+    {
+        throw std::overflow_error("Invalid int value");
+    }
+    val = static_cast<int>(int_val);
 }
 
 void InputArchive::read(int8_t &val)
 {
-    int int_val = value().GetInt();
+    int int_val;
+    read(int_val);
     if (int_val > std::numeric_limits<int8_t>::max())
         throw std::overflow_error("Invalid int8_t value");
     val = static_cast<int8_t>(int_val);
@@ -252,12 +233,16 @@ void InputArchive::read(int8_t &val)
 
 void InputArchive::read(unsigned int &val)
 {
-    val = value().GetUint();
+    const uint64_t uint_val = myParser.readUint();
+    if (uint_val > std::numeric_limits<unsigned int>::max())
+        throw std::overflow_error("Invalid unsigned int value");
+    val = static_cast<unsigned int>(uint_val);
 }
 
 void InputArchive::read(uint8_t &val)
 {
-    unsigned int uint_val = value().GetUint();
+    unsigned int uint_val;
+    read(uint_val);
     if (uint_val > std::numeric_limits<uint8_t>::max())
         throw std::overflow_error("Invalid uint8_t value");
     val = static_cast<uint8_t>(uint_val);
@@ -265,60 +250,52 @@ void InputArchive::read(uint8_t &val)
 
 void InputArchive::read(bool &val)
 {
-    val = value().GetBool();
+    val = myParser.readBool();
 }
 
 void InputArchive::read(std::string &str)
 {
-    str = value().GetString();
+    myParser.readString(str);
 }
 
 template <typename T>
 void InputArchive::read(std::vector<T> &vec)
 {
-    auto size = value().Size();
-    myIterators.push(value().Begin());
+    vec.clear();
 
-    vec.resize(size);
-    for (unsigned int i = 0; i < size; ++i)
+    myParser.startArray();
+    while (myParser.nextElement())
     {
-        read(vec[i]);
-        advance();
+        vec.emplace_back();
+        read(vec.back());
     }
-
-    myIterators.pop();
 }
 
 template <typename K, typename V, typename C>
 void InputArchive::read(std::map<K, V, C> &map)
 {
-    auto it = value().MemberBegin();
-    const long long size = std::distance(it, value().MemberEnd());
-    myIterators.push(it);
+    myParser.startObject();
 
-    for (long long i = 0; i < size; ++i)
+    for (advance(); myHasMember; advance())
     {
-        const K key = boost::lexical_cast<K>(name());
+        const K key = boost::lexical_cast<K>(myName);
 
         V value;
         read(value);
         map[key] = value;
-
-        advance();
     }
-
-    myIterators.pop();
 }
 
 template <typename T, size_t N>
 void InputArchive::read(std::array<T, N> &arr)
 {
-    myIterators.push(value().MemberBegin());
+    myParser.startObject();
+    advance();
 
     for (size_t i = 0; i < N; ++i)
         (*this)(std::to_string(i), arr[i]);
 
-    myIterators.pop();
+    finishObject();
 }
 
 template <size_t N>
@@ -332,7 +309,7 @@ void InputArchive::read(std::bitset<N> &bits)
 template <typename T>
 void InputArchive::read(boost::optional<T> &val)
 {
-    if (value().IsNull())
+    if (myParser.readNull())
         val.reset();
     else
     {
@@ -342,6 +319,14 @@ void InputArchive::read(boost::optional<T> &val)
     }
 }
 
+template <typename T>
+void InputArchive::read(std::shared_ptr<T> &val)
+{
+    // Shared objects (e.g. systems) are never null.
+    val = std::make_shared<T>();
+    read(*val);
+}
+
 void InputArchive::read(boost::gregorian::date &date)
 {
     std::string date_str;
@@ -416,6 +401,12 @@ void OutputArchive::write(const boost::optional<T> &val)
         myStream.Null();
 }
 
+template <typename T>
+void OutputArchive::write(const std::shared_ptr<T> &val)
+{
+    write(*val);
+}
+
 void OutputArchive::write(const boost::gregorian::date &date)
 {
     write(boost::gregorian::to_iso_string(date));
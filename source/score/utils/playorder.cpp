@@ -0,0 +1,112 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "playorder.h"
+
+#include <score/score.h>
+#include <score/utils/directionindex.h>
+#include <score/utils/repeatindexer.h>
+#include <unordered_map>
+
+/// Checks whether a direction or repeat should be performed when moving
+/// between the two locations, and updates the repeat state.
+/// @return True if the playback position needs to be changed, in which case
+///     the new location is stored in new_location.
+static bool checkForRepeat(DirectionIndex *directions, RepeatIndexer &repeats,
+                           const SystemLocation &prev_location,
+                           const SystemLocation &location,
+                           SystemLocation &new_location)
+{
+    RepeatedSection *active_repeat = repeats.findRepeat(location);
+
+    new_location = location;
+    if (directions)
+    {
+        new_location = directions->performDirection(
+            prev_location, location,
+            active_repeat ? active_repeat->getCurrentRepeatNumber() : 1);
+    }
+
+    if (new_location != location)
+    {
+        // If a direction was performed, reset the repeat count for the active
+        // repeat, since we may end up returning to it later (e.g. D.C. al
+        // Fine).
+        if (active_repeat)
+            active_repeat->reset();
+    }
+    // If no musical direction was performed, try to perform a repeat.
+    else if (active_repeat)
+        new_location = active_repeat->performRepeat(location);
+
+    return new_location != location;
+}
+
+PlayOrder::PlayOrder(const Score &score, bool follow_directions)
+{
+    DirectionIndex direction_index(score);
+    DirectionIndex *directions = follow_directions ? &direction_index : nullptr;
+    RepeatIndexer repeats(score);
+    std::unordered_map<SystemLocation, int> pass_counts;
+
+    const int num_systems = static_cast<int>(score.getSystems().size());
+    SystemLocation location(0, 0);
+
+    while (location.getSystem() < num_systems)
+    {
+        const System &system = score.getSystems()[location.getSystem()];
+        const Barline *next_bar = system.getNextBarline(location.getPosition());
+
+        // If there isn't another bar in the system (e.g. after jumping to the
+        // end of the score for a Fine), move to the next system.
+        if (!next_bar)
+        {
+            location = SystemLocation(location.getSystem() + 1, 0);
+            continue;
+        }
+
+        Bar bar;
+        bar.myLocation = location;
+        bar.myPass = pass_counts[location]++;
+
+        const SystemLocation end_location(location.getSystem(),
+                                          next_bar->getPosition());
+        const RepeatedSection *repeat = repeats.findRepeat(end_location);
+        bar.myRepeatNumber = repeat ? repeat->getCurrentRepeatNumber() : 0;
+        bar.myTotalRepeatCount = repeat ? repeat->getTotalRepeatCount() : 0;
+
+        // Move to the next barline and follow any directions / repeats /
+        // alternate endings. At the end of the system, also check for a
+        // position change at the start of the next system.
+        bar.myIsPositionChange =
+            checkForRepeat(directions, repeats, location, end_location,
+                           bar.myNextLocation);
+
+        const Barline &last_bar = system.getBarlines().back();
+        if (!bar.myIsPositionChange &&
+            next_bar->getPosition() == last_bar.getPosition())
+        {
+            const SystemLocation next_system(location.getSystem() + 1, 0);
+            bar.myIsPositionChange =
+                checkForRepeat(directions, repeats, location, next_system,
+                               bar.myNextLocation);
+        }
+
+        myBars.push_back(bar);
+        location = bar.myNextLocation;
+    }
+}
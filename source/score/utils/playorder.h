@@ -0,0 +1,68 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SCORE_UTILS_PLAYORDER_H
+#define SCORE_UTILS_PLAYORDER_H
+
+#include <score/systemlocation.h>
+#include <vector>
+
+class Score;
+
+/// The order in which the bars of a score are played, after following the
+/// repeats, alternate endings, and (optionally) musical directions.
+///
+/// This is computed once for a score in a single pass, rather than tracking
+/// the state of the repeats and directions at each bar during playback. This
+/// also allows the nth bar of the performance to be looked up directly.
+class PlayOrder
+{
+public:
+    struct Bar
+    {
+        /// The location where playback of the bar begins, which is normally
+        /// the bar's start barline.
+        SystemLocation myLocation;
+        /// The number of times that the bar was played previously.
+        int myPass;
+        /// For a bar in a repeated section, the current repeat number
+        /// (starting from 1) and the total number of repeats. Otherwise,
+        /// these are both zero.
+        int myRepeatNumber;
+        int myTotalRepeatCount;
+        /// The location where playback continues after the bar.
+        SystemLocation myNextLocation;
+        /// Whether playback jumps to a different location after the bar
+        /// (e.g. for a repeat), rather than continuing to the next bar.
+        bool myIsPositionChange;
+    };
+
+    typedef std::vector<Bar>::const_iterator const_iterator;
+
+    explicit PlayOrder(const Score &score, bool follow_directions = true);
+
+    size_t getNumBars() const { return myBars.size(); }
+    const Bar &getBar(size_t i) const { return myBars[i]; }
+
+    const_iterator begin() const { return myBars.begin(); }
+    const_iterator end() const { return myBars.end(); }
+
+private:
+    std::vector<Bar> myBars;
+};
+
+#endif
@@ -25,7 +25,7 @@
 #include <score/score.h>
 #include <score/systemlocation.h>
 #include <score/utils.h>
-#include <score/utils/repeatindexer.h>
+#include <score/utils/playorder.h>
 #include <score/voiceutils.h>
 
 static const int thePositionLimit = 30;
@@ -99,39 +99,30 @@ typedef std::list<ExpandedBar> ExpandedBarList;
 
 static void expandScore(Score &score, ExpandedBarList &expanded_bars)
 {
-    Caret caret(score, theDefaultViewOptions);
-    RepeatIndexer repeat_index(score);
-    int remaining_repeats = 0;
+    // TODO - handle directions.
+    const PlayOrder play_order(score, false);
     bool alternate_ending = false;
 
-    while (true)
+    for (const PlayOrder::Bar &bar : play_order)
     {
-        const ScoreLocation &score_loc = caret.getLocation();
+        const SystemLocation &location = bar.myLocation;
+        const ScoreLocation score_loc(score, location.getSystem(), 0,
+                                      location.getPosition());
         const System &system = score_loc.getSystem();
         const Barline *prev_bar =
-            system.getPreviousBarline(score_loc.getPositionIndex() + 1);
+            system.getPreviousBarline(location.getPosition() + 1);
         const Barline *next_bar =
-            system.getNextBarline(score_loc.getPositionIndex());
+            system.getNextBarline(location.getPosition());
 
-        // Ensure that the caret is actually at the start of the bar.
-        caret.moveToPosition(prev_bar->getPosition());
-
-        const SystemLocation location(score_loc.getSystemIndex(),
-                                      score_loc.getPositionIndex());
-        const SystemLocation next_bar_loc(location.getSystem(),
-                                          next_bar->getPosition());
-
-        RepeatedSection *active_repeat = repeat_index.findRepeat(next_bar_loc);
-        if (active_repeat)
+        // The number of remaining repeats, including the current one.
+        int remaining_repeats = 0;
+        if (bar.myTotalRepeatCount)
         {
-            if (!remaining_repeats)
-                remaining_repeats = active_repeat->getTotalRepeatCount();
+            remaining_repeats =
+                bar.myTotalRepeatCount - bar.myRepeatNumber + 1;
         }
         else
-        {
-            remaining_repeats = 0;
             alternate_ending = false;
-        }
 
         if (!ScoreUtils::findInRange(system.getAlternateEndings(),
                                      prev_bar->getPosition(),
@@ -160,35 +151,12 @@ static void expandScore(Score &score, ExpandedBarList &expanded_bars)
                 alternate_ending);
         }
 
-        // TODO - handle directions.
-
-        // Follow repeats.
-        if (active_repeat)
+        // The next repeat doesn't start in an alternate ending.
+        if (bar.myIsPositionChange &&
+            next_bar->getBarType() == Barline::RepeatEnd)
         {
-            SystemLocation new_loc = active_repeat->performRepeat(next_bar_loc);
-            if (new_loc != next_bar_loc)
-            {
-                caret.moveToSystem(new_loc.getSystem(), false);
-                caret.moveToPosition(new_loc.getPosition());
-
-                if (next_bar->getBarType() == Barline::RepeatEnd)
-                {
-                    --remaining_repeats;
-                    alternate_ending = false;
-                }
-
-                continue;
-            }
-            else if (remaining_repeats == 1 &&
-                     next_bar->getBarType() == Barline::RepeatEnd)
-            {
-                remaining_repeats = 0;
-            }
+            alternate_ending = false;
         }
-
-        // Otherwise, advance to the next bar.
-        if (!caret.moveToNextBar())
-            break;
     }
 }
 
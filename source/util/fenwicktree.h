@@ -0,0 +1,115 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UTIL_FENWICKTREE_H
+#define UTIL_FENWICKTREE_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace Util
+{
+/// Stores a sequence of values, and supports updating a value or computing
+/// the sum of a prefix of the sequence in logarithmic time.
+template <typename T>
+class FenwickTree
+{
+public:
+    FenwickTree() = default;
+
+    /// Builds the tree from the given values in linear time.
+    explicit FenwickTree(std::vector<T> values)
+        : myValues(std::move(values)), myTree(myValues.size() + 1, T())
+    {
+        for (size_t i = 1; i < myTree.size(); ++i)
+        {
+            myTree[i] += myValues[i - 1];
+
+            const size_t parent = i + lowestBit(i);
+            if (parent < myTree.size())
+                myTree[parent] += myTree[i];
+        }
+    }
+
+    /// Returns the number of values.
+    size_t size() const
+    {
+        return myValues.size();
+    }
+
+    /// Returns the value at the given index.
+    const T &get(size_t index) const
+    {
+        return myValues[index];
+    }
+
+    /// Replaces the value at the given index.
+    void set(size_t index, const T &value)
+    {
+        const T delta = value - myValues[index];
+        myValues[index] = value;
+
+        for (size_t i = index + 1; i < myTree.size(); i += lowestBit(i))
+            myTree[i] += delta;
+    }
+
+    /// Returns the sum of the first count values.
+    T prefixSum(size_t count) const
+    {
+        T sum = T();
+        for (size_t i = count; i > 0; i -= lowestBit(i))
+            sum += myTree[i];
+        return sum;
+    }
+
+    /// Returns the number of leading values whose sum does not exceed the
+    /// given total. The values must not be negative.
+    size_t countPrefix(T total) const
+    {
+        size_t count = 0;
+        size_t step = 1;
+        while (step * 2 < myTree.size())
+            step *= 2;
+
+        for (; step > 0; step /= 2)
+        {
+            const size_t next = count + step;
+            if (next < myTree.size() && !(total < myTree[next]))
+            {
+                count = next;
+                total -= myTree[next];
+            }
+        }
+
+        return count;
+    }
+
+private:
+    static size_t lowestBit(size_t i)
+    {
+        return i & (~i + 1);
+    }
+
+    std::vector<T> myValues;
+    /// One-based tree, where myTree[i] holds the sum of the values in
+    /// (i - lowestBit(i), i].
+    std::vector<T> myTree;
+};
+}
+
+#endif
@@ -0,0 +1,377 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "jsonpullparser.h"
+
+#include <limits>
+#include <stdexcept>
+
+namespace Util
+{
+typedef std::char_traits<char> Traits;
+
+JsonPullParser::JsonPullParser(std::istream &stream)
+    : myBuffer(stream.rdbuf()), myOffset(0)
+{
+    if (!stream || !myBuffer)
+        throw std::runtime_error("Could not open stream");
+}
+
+void JsonPullParser::startObject()
+{
+    skipWhitespace();
+    expect('{');
+    myHasEntries.push_back(false);
+}
+
+bool JsonPullParser::nextMember(std::string &name)
+{
+    skipWhitespace();
+    if (myHasEntries.empty())
+        throwError("Not inside an object");
+
+    if (peek() == '}')
+    {
+        take();
+        myHasEntries.pop_back();
+        return false;
+    }
+
+    if (myHasEntries.back())
+    {
+        expect(',');
+        skipWhitespace();
+    }
+    myHasEntries.back() = true;
+
+    readString(name);
+    skipWhitespace();
+    expect(':');
+    return true;
+}
+
+void JsonPullParser::startArray()
+{
+    skipWhitespace();
+    expect('[');
+    myHasEntries.push_back(false);
+}
+
+bool JsonPullParser::nextElement()
+{
+    skipWhitespace();
+    if (myHasEntries.empty())
+        throwError("Not inside an array");
+
+    if (peek() == ']')
+    {
+        take();
+        myHasEntries.pop_back();
+        return false;
+    }
+
+    if (myHasEntries.back())
+        expect(',');
+    myHasEntries.back() = true;
+
+    return true;
+}
+
+int64_t JsonPullParser::readInt()
+{
+    skipWhitespace();
+
+    const bool negative = peek() == '-';
+    if (negative)
+        take();
+
+    const uint64_t magnitude = readDigits();
+    const uint64_t limit =
+        static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) +
+        (negative ? 1 : 0);
+    if (magnitude > limit)
+        throwError("Number too big to be stored in int64_t");
+
+    return negative ? static_cast<int64_t>(0 - magnitude)
+                    : static_cast<int64_t>(magnitude);
+}
+
+uint64_t JsonPullParser::readUint()
+{
+    skipWhitespace();
+    if (peek() == '-')
+        throwError("Expected an unsigned integer");
+
+    return readDigits();
+}
+
+bool JsonPullParser::readBool()
+{
+    skipWhitespace();
+    if (peek() == 't')
+    {
+        expectLiteral("true");
+        return true;
+    }
+
+    expectLiteral("false");
+    return false;
+}
+
+void JsonPullParser::readString(std::string &str)
+{
+    skipWhitespace();
+    expect('"');
+    str.clear();
+
+    while (true)
+    {
+        const int c = take();
+        if (c == '"')
+            return;
+        else if (c == Traits::eof())
+            throwError("Missing a closing quotation mark in string");
+        else if (static_cast<unsigned char>(c) < 0x20)
+            throwError("Invalid encoding in string");
+        else if (c != '\\')
+        {
+            str.push_back(static_cast<char>(c));
+            continue;
+        }
+
+        const int escape = take();
+        switch (escape)
+        {
+        case '"':
+        case '\\':
+        case '/':
+            str.push_back(static_cast<char>(escape));
+            break;
+        case 'b':
+            str.push_back('\b');
+            break;
+        case 'f':
+            str.push_back('\f');
+            break;
+        case 'n':
+            str.push_back('\n');
+            break;
+        case 'r':
+            str.push_back('\r');
+            break;
+        case 't':
+            str.push_back('\t');
+            break;
+        case 'u':
+        {
+            unsigned int codepoint = readHex4();
+            // Combine surrogate pairs.
+            if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
+            {
+                expect('\\');
+                expect('u');
+                const unsigned int low = readHex4();
+                if (low < 0xDC00 || low > 0xDFFF)
+                    throwError("The surrogate pair in string is invalid");
+                codepoint =
+                    (((codepoint - 0xD800) << 10) | (low - 0xDC00)) + 0x10000;
+            }
+
+            appendUtf8(str, codepoint);
+            break;
+        }
+        default:
+            throwError("Invalid escape character in string");
+        }
+    }
+}
+
+bool JsonPullParser::readNull()
+{
+    skipWhitespace();
+    if (peek() != 'n')
+        return false;
+
+    expectLiteral("null");
+    return true;
+}
+
+void JsonPullParser::skipValue()
+{
+    skipWhitespace();
+
+    switch (peek())
+    {
+    case '{':
+    {
+        std::string name;
+        startObject();
+        while (nextMember(name))
+            skipValue();
+        break;
+    }
+    case '[':
+        startArray();
+        while (nextElement())
+            skipValue();
+        break;
+    case '"':
+    {
+        std::string str;
+        readString(str);
+        break;
+    }
+    case 't':
+    case 'f':
+        readBool();
+        break;
+    case 'n':
+        readNull();
+        break;
+    default:
+    {
+        // Skip over any numeric characters, including fractions and exponents.
+        int c = peek();
+        if (c != '-' && (c < '0' || c > '9'))
+            throwError("Invalid value");
+
+        while ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' ||
+               c == '+' || c == '-')
+        {
+            take();
+            c = peek();
+        }
+        break;
+    }
+    }
+}
+
+void JsonPullParser::throwError(const std::string &msg) const
+{
+    throw std::runtime_error("Parse error at offset " +
+                             std::to_string(myOffset) + ": " + msg);
+}
+
+int JsonPullParser::peek()
+{
+    return myBuffer->sgetc();
+}
+
+int JsonPullParser::take()
+{
+    const int c = myBuffer->sbumpc();
+    if (c != Traits::eof())
+        ++myOffset;
+    return c;
+}
+
+void JsonPullParser::skipWhitespace()
+{
+    int c = peek();
+    while (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+    {
+        take();
+        c = peek();
+    }
+}
+
+void JsonPullParser::expect(char expected)
+{
+    const int c = take();
+    if (c == Traits::eof())
+        throwError("The document ended unexpectedly");
+    else if (c != expected)
+        throwError(std::string("Expected '") + expected + "'");
+}
+
+void JsonPullParser::expectLiteral(const char *literal)
+{
+    for (const char *c = literal; *c; ++c)
+    {
+        if (take() != *c)
+            throwError("Invalid value");
+    }
+}
+
+uint64_t JsonPullParser::readDigits()
+{
+    int c = peek();
+    if (c < '0' || c > '9')
+        throwError("Expected a number");
+
+    uint64_t value = 0;
+    while (c >= '0' && c <= '9')
+    {
+        const uint64_t digit = static_cast<uint64_t>(c - '0');
+        if (value > (std::numeric_limits<uint64_t>::max() - digit) / 10)
+            throwError("Number too big to be stored in uint64_t");
+
+        value = value * 10 + digit;
+        take();
+        c = peek();
+    }
+
+    if (c == '.' || c == 'e' || c == 'E')
+        throwError("Expected an integer");
+
+    return value;
+}
+
+unsigned int JsonPullParser::readHex4()
+{
+    unsigned int value = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        const int c = take();
+        value <<= 4;
+        if (c >= '0' && c <= '9')
+            value |= static_cast<unsigned int>(c - '0');
+        else if (c >= 'a' && c <= 'f')
+            value |= static_cast<unsigned int>(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F')
+            value |= static_cast<unsigned int>(c - 'A' + 10);
+        else
+            throwError("Incorrect hex digit after \\u escape in string");
+    }
+
+    return value;
+}
+
+void JsonPullParser::appendUtf8(std::string &str, unsigned int codepoint)
+{
+    if (codepoint <= 0x7F)
+        str.push_back(static_cast<char>(codepoint));
+    else if (codepoint <= 0x7FF)
+    {
+        str.push_back(static_cast<char>(0xC0 | ((codepoint >> 6) & 0xFF)));
+        str.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    }
+    else if (codepoint <= 0xFFFF)
+    {
+        str.push_back(static_cast<char>(0xE0 | ((codepoint >> 12) & 0xFF)));
+        str.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+        str.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    }
+    else
+    {
+        str.push_back(static_cast<char>(0xF0 | ((codepoint >> 18) & 0xFF)));
+        str.push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F)));
+        str.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+        str.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    }
+}
+}
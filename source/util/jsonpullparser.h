@@ -0,0 +1,80 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UTIL_JSONPULLPARSER_H
+#define UTIL_JSONPULLPARSER_H
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace Util
+{
+/// A minimal pull parser for JSON, which reads values on demand directly from
+/// a stream instead of building a document in memory.
+/// The caller is expected to know the structure of the data. Any errors
+/// (malformed data, or a value of the wrong type) throw a std::runtime_error.
+class JsonPullParser
+{
+public:
+    JsonPullParser(std::istream &stream);
+
+    /// Consumes the start of an object.
+    void startObject();
+    /// Advances to the next member of the current object, and reads its name.
+    /// Returns false (and consumes the end of the object) if there are no
+    /// more members.
+    bool nextMember(std::string &name);
+
+    /// Consumes the start of an array.
+    void startArray();
+    /// Returns true if there is another element in the current array, or
+    /// otherwise consumes the end of the array.
+    bool nextElement();
+
+    int64_t readInt();
+    uint64_t readUint();
+    bool readBool();
+    void readString(std::string &str);
+
+    /// If the next value is null, consumes it and returns true.
+    bool readNull();
+
+    /// Skips over the next value, including any nested objects or arrays.
+    void skipValue();
+
+private:
+    [[noreturn]] void throwError(const std::string &msg) const;
+
+    int peek();
+    int take();
+    void skipWhitespace();
+    void expect(char c);
+    void expectLiteral(const char *literal);
+    uint64_t readDigits();
+    unsigned int readHex4();
+    void appendUtf8(std::string &str, unsigned int codepoint);
+
+    std::streambuf *myBuffer;
+    size_t myOffset;
+    /// For each nested object or array, whether the first entry has been read.
+    std::vector<bool> myHasEntries;
+};
+}
+
+#endif
@@ -0,0 +1,106 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UTIL_PARALLEL_H
+#define UTIL_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace Util
+{
+/// Returns the number of worker threads to use by default.
+inline unsigned int defaultThreadCount()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/// Calls func(i) for each i in [0, count), spread across several threads.
+/// Work is handed out one index at a time, so uneven work items are balanced
+/// between the threads. If any call throws, the first exception is rethrown
+/// after all of the threads have finished.
+template <typename Function>
+void parallelFor(size_t count, Function func,
+                 unsigned int num_threads = defaultThreadCount())
+{
+    num_threads = static_cast<unsigned int>(
+        std::min<size_t>(std::max(1u, num_threads), count));
+
+    if (num_threads <= 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+            func(i);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+
+    auto worker = [&]() {
+        size_t i;
+        while (!failed && (i = next++) < count)
+        {
+            try
+            {
+                func(i);
+            }
+            catch (...)
+            {
+                failed = true;
+                throw;
+            }
+        }
+    };
+
+    // The current thread also does some of the work.
+    std::vector<std::future<void>> tasks;
+    for (unsigned int i = 1; i < num_threads; ++i)
+        tasks.push_back(std::async(std::launch::async, worker));
+
+    std::exception_ptr error;
+    try
+    {
+        worker();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    for (auto &&task : tasks)
+    {
+        try
+        {
+            task.get();
+        }
+        catch (...)
+        {
+            if (!error)
+                error = std::current_exception();
+        }
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+}
+}
+
+#endif
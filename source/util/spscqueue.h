@@ -0,0 +1,86 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UTIL_SPSCQUEUE_H
+#define UTIL_SPSCQUEUE_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace Util
+{
+/// A bounded, lock-free queue for passing items from one producer thread to
+/// one consumer thread. Neither operation blocks: tryPush() fails if the queue
+/// is full, and tryPop() fails if the queue is empty.
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t capacity)
+        : mySlots(capacity + 1), myHead(0), myTail(0)
+    {
+        assert(capacity > 0);
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    /// Called by the producer thread.
+    bool tryPush(T &&item)
+    {
+        const size_t tail = myTail.load(std::memory_order_relaxed);
+        const size_t next = increment(tail);
+        if (next == myHead.load(std::memory_order_acquire))
+            return false;
+
+        mySlots[tail] = std::move(item);
+        myTail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /// Called by the consumer thread.
+    bool tryPop(T &item)
+    {
+        const size_t head = myHead.load(std::memory_order_relaxed);
+        if (head == myTail.load(std::memory_order_acquire))
+            return false;
+
+        item = std::move(mySlots[head]);
+        myHead.store(increment(head), std::memory_order_release);
+        return true;
+    }
+
+private:
+    size_t increment(size_t index) const
+    {
+        return index + 1 == mySlots.size() ? 0 : index + 1;
+    }
+
+    /// One slot is always left empty to distinguish a full queue from an
+    /// empty queue.
+    std::vector<T> mySlots;
+    /// The next slot to pop from, which is only modified by the consumer.
+    std::atomic<size_t> myHead;
+    /// The next slot to push to, which is only modified by the producer.
+    std::atomic<size_t> myTail;
+};
+}
+
+#endif
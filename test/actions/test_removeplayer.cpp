@@ -36,12 +36,18 @@ TEST_CASE("Actions/RemovePlayer", "")
     system.insertStaff(Staff());
 
     score.insertSystem(system);
+    score.insertSystem(System());
     score.insertPlayer(player1);
     score.insertPlayer(player2);
 
+    // Systems without player changes should not be accessed mutably, which
+    // would copy them.
+    std::shared_ptr<const System> snapshot = score.getSystemSnapshot(1);
+
     RemovePlayer action(score, 0);
 
     action.redo();
+    REQUIRE(score.getSystemSnapshot(1) == snapshot);
     REQUIRE(score.getPlayers().size() == 1);
     REQUIRE(score.getPlayers()[0] == player2);
     {
@@ -52,6 +58,7 @@ TEST_CASE("Actions/RemovePlayer", "")
     }
 
     action.undo();
+    REQUIRE(score.getSystemSnapshot(1) == snapshot);
     REQUIRE(score.getPlayers().size() == 2);
     REQUIRE(score.getPlayers()[0] == player1);
     REQUIRE(score.getPlayers()[1] == player2);
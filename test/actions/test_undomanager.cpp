@@ -0,0 +1,202 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <catch.hpp>
+
+#include <actions/removesystem.h>
+#include <actions/storedsystem.h>
+#include <actions/undomanager.h>
+#include <memory>
+#include <score/score.h>
+#include <string>
+#include <vector>
+#include "../score/test_scoregenerator.h"
+
+TEST_CASE("Actions/UndoManager/StoredSystem", "")
+{
+    Score score;
+    ScoreGenerator::generate(score, 2, 2);
+    const System original = score.getSystems()[0];
+
+    StoredSystem stored(score.getSystemSnapshot(0));
+    REQUIRE(stored);
+
+    // The snapshot doesn't use any extra memory while the score shares it.
+    auto file = std::make_shared<UndoSpillFile>();
+    REQUIRE(stored.getMemoryUsage() == 0);
+    REQUIRE(!stored.spill(file));
+
+    score.getSystems()[0].getBarlines()[1].setPosition(100);
+    REQUIRE(stored.getMemoryUsage() > 0);
+
+    REQUIRE(stored.spill(file));
+    REQUIRE(stored.isSpilled());
+    REQUIRE(stored.getMemoryUsage() == 0);
+    REQUIRE(stored.getSpilledSize() == file->size());
+
+    // The system is reloaded when it is needed.
+    REQUIRE(*stored.get() == original);
+    REQUIRE(!stored.isSpilled());
+}
+
+TEST_CASE("Actions/UndoManager/SharedSnapshots", "")
+{
+    Score score;
+    ScoreGenerator::generate(score, 2, 2);
+    const System original = score.getSystems()[0];
+
+    // Two commands that hold snapshots of the same system.
+    StoredSystem first(score.getSystemSnapshot(0));
+    StoredSystem second(score.getSystemSnapshot(0));
+    SnapshotTracker tracker;
+    tracker.setSnapshots(0, { &first });
+    tracker.setSnapshots(1, { &second });
+    REQUIRE(tracker.getNumSnapshots() == 1);
+    REQUIRE(tracker.getMemoryUsage() == 0);
+
+    // Once the score modifies the system, it is only counted once, and is
+    // charged to the oldest command.
+    const System *node = score.getSystemNode(0);
+    score.getSystems()[0].getBarlines()[1].setPosition(100);
+    tracker.systemReplaced(node);
+    const size_t usage = first.getMemoryUsage();
+    REQUIRE(usage > 0);
+    REQUIRE(tracker.getMemoryUsage() == usage);
+    REQUIRE(tracker.getCommandMemoryUsage() ==
+            std::vector<size_t>({ usage, 0 }));
+
+    // Both snapshots are spilled together.
+    tracker.enforceBudget(1);
+    REQUIRE(tracker.getMemoryUsage() == 0);
+    REQUIRE(tracker.getNumSpilled() == 1);
+    REQUIRE(first.isSpilled());
+    REQUIRE(second.isSpilled());
+    REQUIRE(tracker.getSpilledBytes() == usage);
+
+    REQUIRE(*second.get() == original);
+    REQUIRE(!first.isSpilled());
+
+    // The spill file is emptied once nothing is spilled.
+    tracker.removeCommands(0);
+    REQUIRE(tracker.getNumSnapshots() == 0);
+    REQUIRE(tracker.getSpilledBytes() == 0);
+}
+
+TEST_CASE("Actions/UndoManager/ReplacedSystems", "")
+{
+    Score score;
+    ScoreGenerator::generate(score, 2, 2);
+
+    StoredSystem snapshot(score.getSystemSnapshot(0));
+    SnapshotTracker tracker;
+    tracker.setSnapshots(0, { &snapshot });
+    REQUIRE(tracker.getMemoryUsage() == 0);
+
+    // Another reference to the system (e.g. from the renderer) does not hide
+    // the memory that the snapshot uses once the score has replaced it.
+    std::shared_ptr<const System> other = score.getSystemSnapshot(0);
+    const System *node = score.getSystemNode(0);
+    score.getSystems()[0].getBarlines()[1].setPosition(100);
+    REQUIRE(score.getSystemNode(0) != node);
+    tracker.systemReplaced(node);
+    REQUIRE(tracker.getMemoryUsage() > 0);
+
+    // Restoring the snapshot shares it with the score again.
+    score.setSystem(0, snapshot.get());
+    tracker.systemRestored(score.getSystemNode(0));
+    REQUIRE(tracker.getMemoryUsage() == 0);
+
+    // Only the other reference remains once the snapshot is spilled.
+    score.getSystems()[0].getBarlines()[1].setPosition(100);
+    tracker.systemReplaced(node);
+    tracker.enforceBudget(1);
+    REQUIRE(tracker.getNumSpilled() == 1);
+    REQUIRE(other.use_count() == 1);
+}
+
+TEST_CASE("Actions/UndoManager/SpillFile", "")
+{
+    UndoSpillFile file;
+    const std::string data(600 * 1024, 'a');
+    const UndoSpillFile::EntryId first = file.write(data);
+    const UndoSpillFile::EntryId second = file.write(data);
+    const UndoSpillFile::EntryId third = file.write(std::string(10, 'b'));
+    REQUIRE(file.size() == 2 * data.size() + 10);
+
+    // The file is compacted once most of it is unused.
+    file.release(first);
+    REQUIRE(file.size() == 2 * data.size() + 10);
+    file.release(second);
+    REQUIRE(file.size() == 10);
+    REQUIRE(file.getLiveSize() == 10);
+    REQUIRE(file.read(third) == std::string(10, 'b'));
+
+    // The file is removed when it is empty.
+    file.release(third);
+    REQUIRE(file.size() == 0);
+    REQUIRE(file.read(file.write(data)) == data);
+}
+
+TEST_CASE("Actions/UndoManager/MemoryBudget", "")
+{
+    // Generate a separate copy for comparison, rather than sharing the
+    // systems.
+    Score score;
+    ScoreGenerator::generate(score, 20, 2);
+    Score original;
+    ScoreGenerator::generate(original, 20, 2);
+
+    UndoManager manager;
+    manager.addNewUndoStack(score);
+    manager.setActiveStackIndex(0);
+
+    const int num_commands = 10;
+    for (int i = 0; i < num_commands; ++i)
+    {
+        manager.push(new RemoveSystem(score, 0),
+                     UndoManager::AFFECTS_ALL_SYSTEMS);
+    }
+
+    // Without a budget, the removed systems are kept in memory.
+    UndoManager::MemoryStats stats = manager.getMemoryStats();
+    REQUIRE(stats.numCommands == num_commands);
+    REQUIRE(stats.numSnapshots == num_commands);
+    REQUIRE(stats.memoryUsage > 0);
+    REQUIRE(stats.numSpilled == 0);
+
+    // The oldest snapshots are spilled to meet the budget.
+    const size_t budget = stats.memoryUsage / 2;
+    manager.setMemoryBudget(budget);
+    stats = manager.getMemoryStats();
+    REQUIRE(stats.memoryUsage <= budget);
+    REQUIRE(stats.numSpilled > 0);
+    REQUIRE(stats.numSpilled < num_commands);
+    REQUIRE(stats.spilledBytes > 0);
+
+    // New commands are also kept within the budget.
+    manager.push(new RemoveSystem(score, 0), UndoManager::AFFECTS_ALL_SYSTEMS);
+    REQUIRE(manager.getMemoryStats().memoryUsage <= budget);
+
+    // Undoing the commands reloads the spilled systems.
+    for (int i = 0; i <= num_commands; ++i)
+        manager.undo();
+
+    REQUIRE(score == original);
+    stats = manager.getMemoryStats();
+    REQUIRE(stats.memoryUsage == 0);
+    REQUIRE(stats.numSpilled == 0);
+}
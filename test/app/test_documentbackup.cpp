@@ -0,0 +1,249 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <catch.hpp>
+
+#include <app/documentbackup.h>
+#include <boost/filesystem/operations.hpp>
+#include <chrono>
+#include <iostream>
+#include <score/score.h>
+#include "../score/test_scoregenerator.h"
+
+static boost::filesystem::path getBackupDir()
+{
+    return boost::filesystem::temp_directory_path() /
+           boost::filesystem::unique_path("pte-backup-%%%%-%%%%");
+}
+
+static void setEndBar(Score &score, int system, int position)
+{
+    score.getSystems()[system].getBarlines()[1].setPosition(position);
+}
+
+TEST_CASE("App/DocumentBackup/Recover", "")
+{
+    const boost::filesystem::path dir = getBackupDir();
+
+    Score score;
+    ScoreGenerator::generate(score, 5, 2);
+
+    {
+        DocumentBackup backup(dir);
+        backup.setFilename("test.pt2");
+
+        // The first change creates the initial snapshot.
+        setEndBar(score, 0, 100);
+        backup.recordChange(score, 0);
+        REQUIRE(!backup.hasChanges());
+        backup.wait();
+
+        // Subsequent changes are journaled.
+        setEndBar(score, 2, 101);
+        backup.recordChange(score, 2);
+        setEndBar(score, 2, 102);
+        backup.recordChange(score, 2);
+        REQUIRE(backup.hasChanges());
+
+        // Simulate a crash by not discarding the backup.
+    }
+
+    {
+        Score copy;
+        boost::filesystem::path filename;
+        REQUIRE(DocumentBackup::recover(dir, copy, filename));
+        REQUIRE(filename == "test.pt2");
+        REQUIRE(copy == score);
+    }
+
+    {
+        DocumentBackup backup(dir);
+        backup.discard();
+        REQUIRE(!boost::filesystem::exists(dir));
+
+        Score copy;
+        boost::filesystem::path filename;
+        REQUIRE(!DocumentBackup::recover(dir, copy, filename));
+    }
+}
+
+TEST_CASE("App/DocumentBackup/Snapshots", "")
+{
+    const boost::filesystem::path dir = getBackupDir();
+
+    Score score;
+    ScoreGenerator::generate(score, 5, 2);
+
+    DocumentBackup backup(dir);
+    backup.recordChange(score, 0);
+
+    // Take a snapshot after modifying a system and inserting a system.
+    setEndBar(score, 1, 100);
+    backup.recordChange(score, 1);
+    score.insertSystem(System(), 0);
+    backup.recordChange(score, -1);
+    backup.wait();
+    REQUIRE(backup.backup(score));
+    REQUIRE(!backup.hasChanges());
+    backup.wait();
+
+    // A change to all systems starts a new snapshot, so the changes after it
+    // can still be recovered.
+    setEndBar(score, 3, 101);
+    backup.recordChange(score, 3);
+    score.removeSystem(0);
+    backup.recordChange(score, -1);
+    REQUIRE(!backup.hasChanges());
+    setEndBar(score, 0, 102);
+    backup.recordChange(score, 0);
+    backup.wait();
+
+    {
+        Score copy;
+        boost::filesystem::path filename;
+        REQUIRE(DocumentBackup::recover(dir, copy, filename));
+        REQUIRE(filename.empty());
+        REQUIRE(copy == score);
+    }
+
+    REQUIRE(backup.backup(score));
+    backup.wait();
+    {
+        Score copy;
+        boost::filesystem::path filename;
+        REQUIRE(DocumentBackup::recover(dir, copy, filename));
+        REQUIRE(copy == score);
+    }
+
+    // A change to all systems while a snapshot is being written does not wait
+    // for it, and the new snapshot is taken afterwards.
+    REQUIRE(backup.backup(score));
+    score.insertSystem(System(), 1);
+    backup.recordChange(score, -1);
+    if (backup.isSnapshotPending())
+    {
+        REQUIRE(backup.hasChanges());
+        setEndBar(score, 1, 103);
+        backup.recordChange(score, 1);
+        backup.wait();
+        REQUIRE(backup.backup(score));
+    }
+    REQUIRE(!backup.isSnapshotPending());
+    backup.wait();
+    {
+        Score copy;
+        boost::filesystem::path filename;
+        REQUIRE(DocumentBackup::recover(dir, copy, filename));
+        REQUIRE(copy == score);
+    }
+
+    // Only the most recent snapshot should be kept.
+    int num_snapshots = 0;
+    for (boost::filesystem::directory_iterator it(dir), end; it != end; ++it)
+    {
+        if (it->path().extension() == ".pt2")
+            ++num_snapshots;
+    }
+    REQUIRE(num_snapshots == 1);
+
+    backup.discard();
+}
+
+/// Measures how long the calling (UI) thread is blocked when recording a
+/// change and taking a snapshot of a large score.
+TEST_CASE("App/DocumentBackup/Benchmark", "[.][benchmark]")
+{
+    using Clock = std::chrono::steady_clock;
+    using std::chrono::microseconds;
+
+    const boost::filesystem::path dir = getBackupDir();
+
+    Score score;
+    ScoreGenerator::generate(score, 2500, 4);
+
+    DocumentBackup backup(dir);
+
+    auto start = Clock::now();
+    backup.recordChange(score, 0);
+    auto initial_time = Clock::now() - start;
+
+    start = Clock::now();
+    backup.wait();
+    auto write_time = Clock::now() - start;
+
+    const int num_edits = 100;
+    Clock::duration journal_time(0);
+    Clock::duration snapshot_time(0);
+    Clock::duration all_systems_time(0);
+
+    for (int i = 0; i < num_edits; ++i)
+    {
+        setEndBar(score, i * 10, 100 + i);
+
+        start = Clock::now();
+        backup.recordChange(score, i * 10);
+        journal_time += Clock::now() - start;
+
+        start = Clock::now();
+        backup.backup(score);
+        snapshot_time += Clock::now() - start;
+
+        backup.wait();
+    }
+
+    // Changes to all systems, which are recorded while the previous snapshot
+    // is still being written.
+    for (int i = 0; i < num_edits; ++i)
+    {
+        setEndBar(score, i * 10 + 1, 100 + i);
+
+        start = Clock::now();
+        backup.recordChange(score, -1);
+        all_systems_time += Clock::now() - start;
+    }
+
+    backup.wait();
+    if (backup.isSnapshotPending())
+        REQUIRE(backup.backup(score));
+    backup.wait();
+
+    std::cout << "Initial snapshot: "
+              << std::chrono::duration_cast<microseconds>(initial_time).count()
+              << " us blocked, "
+              << std::chrono::duration_cast<microseconds>(write_time).count()
+              << " us in the background" << std::endl;
+    std::cout << "Per edit: "
+              << std::chrono::duration_cast<microseconds>(journal_time).count() /
+                     num_edits
+              << " us to journal, "
+              << std::chrono::duration_cast<microseconds>(snapshot_time)
+                         .count() /
+                     num_edits
+              << " us to take a snapshot" << std::endl;
+    std::cout << "Per change to all systems: "
+              << std::chrono::duration_cast<microseconds>(all_systems_time)
+                         .count() /
+                     num_edits
+              << " us blocked" << std::endl;
+
+    Score copy;
+    boost::filesystem::path filename;
+    REQUIRE(DocumentBackup::recover(dir, copy, filename));
+    REQUIRE(copy == score);
+
+    backup.discard();
+}
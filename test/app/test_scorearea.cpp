@@ -0,0 +1,97 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <catch.hpp>
+
+#include <algorithm>
+#include <app/documentmanager.h>
+#include <app/scorearea.h>
+#include <chrono>
+#include <iostream>
+#include <QScrollBar>
+#include <string>
+#include <vector>
+#include "../score/test_scoregenerator.h"
+
+/// Measures how long it takes to paint frames of a large score while
+/// scrolling through it and while zooming, including rendering any systems
+/// that come into view.
+TEST_CASE("App/ScoreArea/FrameTimeBenchmark", "[.][benchmark]")
+{
+    using Clock = std::chrono::steady_clock;
+
+    Document document;
+    ScoreGenerator::generate(document.getScore(), 500, 4, 2);
+
+    ScoreArea score_area(nullptr);
+    score_area.resize(1280, 800);
+    score_area.show();
+    score_area.renderDocument(document);
+
+    auto report = [](const std::string &name, std::vector<double> times) {
+        std::sort(times.begin(), times.end());
+        std::cout << name << ": median " << times[times.size() / 2]
+                  << " ms, max " << times.back() << " ms over "
+                  << times.size() << " frames" << std::endl;
+    };
+
+    // Scroll through the score in steps of roughly half a screen.
+    QScrollBar *scroll_bar = score_area.verticalScrollBar();
+    const int step = std::max(1, scroll_bar->pageStep() / 2);
+    std::vector<double> scroll_times;
+    for (int value = 0; value <= scroll_bar->maximum(); value += step)
+    {
+        const auto start = Clock::now();
+        scroll_bar->setValue(value);
+        score_area.viewport()->repaint();
+        scroll_times.push_back(
+            std::chrono::duration<double, std::milli>(Clock::now() - start)
+                .count());
+    }
+    report("Scrolling", scroll_times);
+
+    // Zoom in and out repeatedly, which redraws the visible systems at each
+    // zoom level.
+    scroll_bar->setValue(0);
+    std::vector<double> zoom_times;
+    for (int i = 0; i < 10; ++i)
+    {
+        for (double zoom : { 75.0, 100.0, 125.0, 150.0, 200.0 })
+        {
+            const auto start = Clock::now();
+            document.getViewOptions().setZoom(zoom);
+            score_area.refreshZoom();
+            score_area.viewport()->repaint();
+            zoom_times.push_back(
+                std::chrono::duration<double, std::milli>(Clock::now() - start)
+                    .count());
+        }
+    }
+    report("Zooming", zoom_times);
+
+    // Painting again at the same zoom level reuses the cached tiles.
+    std::vector<double> repaint_times;
+    for (int i = 0; i < 50; ++i)
+    {
+        const auto start = Clock::now();
+        score_area.viewport()->repaint();
+        repaint_times.push_back(
+            std::chrono::duration<double, std::milli>(Clock::now() - start)
+                .count());
+    }
+    report("Repainting", repaint_times);
+}
@@ -0,0 +1,274 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <catch.hpp>
+
+#include <algorithm>
+#include <audio/midischeduler.h>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using Clock = MidiScheduler::Clock;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+static int64_t getMicroseconds(Clock::duration duration)
+{
+    return std::chrono::duration_cast<microseconds>(duration).count();
+}
+
+TEST_CASE("Audio/MidiScheduler/Deadlines", "")
+{
+    MidiScheduler scheduler(96, 500000);
+    const Clock::time_point start = Clock::now();
+    scheduler.start(96, start, 100);
+
+    REQUIRE(scheduler.getDeadline(96) == start);
+    REQUIRE(getMicroseconds(scheduler.getDeadline(192) - start) == 500000);
+    REQUIRE(getMicroseconds(scheduler.getDeadline(120) - start) == 125000);
+
+    // Tempo changes only affect later events.
+    scheduler.setBeatDuration(192, 250000);
+    REQUIRE(getMicroseconds(scheduler.getDeadline(192) - start) == 500000);
+    REQUIRE(getMicroseconds(scheduler.getDeadline(288) - start) == 750000);
+
+    // Doubling the speed halves the time between the remaining events.
+    scheduler.setSpeed(288, 200);
+    REQUIRE(getMicroseconds(scheduler.getDeadline(288) - start) == 750000);
+    REQUIRE(getMicroseconds(scheduler.getDeadline(384) - start) == 875000);
+
+    // Deadlines are computed exactly even for large times.
+    const int64_t ticks = 96LL * 2 * 60 * 60 * 10;
+    REQUIRE(getMicroseconds(scheduler.getDeadline(288 + ticks) - start) ==
+            750000 + 125000LL * ticks / 96);
+}
+
+TEST_CASE("Audio/MidiScheduler/Batches", "")
+{
+    MidiEventList events;
+    events.append(MidiEvent::noteOn(0, 0, 60, 127, SystemLocation()));
+    events.append(MidiEvent::noteOn(0, 1, 61, 127, SystemLocation()));
+    events.append(MidiEvent::setTempo(2, 2000));
+    events.append(MidiEvent::noteOff(2, 0, 60, SystemLocation()));
+    events.append(MidiEvent::noteOff(2, 1, 61, SystemLocation()));
+    events.append(MidiEvent::endOfTrack(4));
+
+    std::atomic<int> speed(100);
+    std::atomic<bool> playing(true);
+    std::vector<std::pair<int64_t, size_t>> batches;
+    std::vector<Clock::time_point> times;
+
+    MidiScheduler scheduler(2, 1000);
+    const Clock::time_point start = Clock::now();
+    scheduler.start(0, start, speed);
+    scheduler.play(events.begin(), events.end(), speed, playing,
+                   [&](MidiEventList::const_iterator begin,
+                       MidiEventList::const_iterator end) {
+                       batches.emplace_back(begin->getTicks(), end - begin);
+                       times.push_back(Clock::now());
+                   });
+
+    const std::vector<std::pair<int64_t, size_t>> expected = {
+        { 0, 2 }, { 2, 3 }, { 4, 1 }
+    };
+    REQUIRE(batches == expected);
+
+    // The tempo change applies to the last batch.
+    REQUIRE(times[1] - start >= microseconds(1000));
+    REQUIRE(times[2] - start >= microseconds(3000));
+
+    // Nothing is dispatched after playback is stopped.
+    playing = false;
+    batches.clear();
+    scheduler.start(0, Clock::now(), speed);
+    scheduler.play(events.begin(), events.end(), speed, playing,
+                   [&](MidiEventList::const_iterator begin,
+                       MidiEventList::const_iterator end) {
+                       batches.emplace_back(begin->getTicks(), end - begin);
+                   });
+    REQUIRE(batches.empty());
+}
+
+TEST_CASE("Audio/MidiScheduler/OverlappingRanges", "")
+{
+    // The second range starts before the end of the first range, e.g. due to
+    // a grace note that is played before the downbeat.
+    MidiEventList first;
+    first.append(MidiEvent::noteOn(0, 0, 60, 127, SystemLocation()));
+    first.append(MidiEvent::noteOff(4, 0, 60, SystemLocation()));
+
+    MidiEventList second;
+    second.append(MidiEvent::noteOn(3, 1, 61, 127, SystemLocation()));
+    second.append(MidiEvent::noteOff(6, 1, 61, SystemLocation()));
+
+    std::atomic<int> speed(100);
+    std::atomic<bool> playing(true);
+    std::vector<int64_t> ticks;
+    std::vector<Clock::time_point> times;
+    auto dispatch = [&](MidiEventList::const_iterator begin,
+                        MidiEventList::const_iterator) {
+        ticks.push_back(begin->getTicks());
+        times.push_back(Clock::now());
+    };
+
+    MidiScheduler scheduler(2, 1000);
+    const Clock::time_point start = Clock::now();
+    scheduler.start(0, start, speed);
+    scheduler.play(first.begin(), first.end(), speed, playing, dispatch);
+    scheduler.play(second.begin(), second.end(), speed, playing, dispatch);
+
+    REQUIRE(ticks == std::vector<int64_t>({ 0, 4, 3, 6 }));
+
+    // The late event is dispatched immediately, and the following events are
+    // still scheduled relative to the start of playback.
+    REQUIRE(times[2] - start >= microseconds(2000));
+    REQUIRE(times[2] - times[1] < milliseconds(100));
+    REQUIRE(times[3] - start >= microseconds(3000));
+}
+
+namespace
+{
+/// Records when each message is sent, instead of sending it to a MIDI device.
+/// Sending a message also takes some time, as with a real device.
+class FakeMidiOutputDevice
+{
+public:
+    explicit FakeMidiOutputDevice(Clock::duration send_time)
+        : mySendTime(send_time)
+    {
+    }
+
+    void sendMessage(const uint8_t *, size_t)
+    {
+        const Clock::time_point now = Clock::now();
+        myTimes.push_back(now);
+
+        while (Clock::now() - now < mySendTime)
+        {
+        }
+    }
+
+    const std::vector<Clock::time_point> &getTimes() const { return myTimes; }
+
+private:
+    const Clock::duration mySendTime;
+    std::vector<Clock::time_point> myTimes;
+};
+
+struct TimingStats
+{
+    TimingStats(const std::vector<Clock::time_point> &times,
+                const std::vector<Clock::time_point> &expected)
+        : myMeanJitter(0), myMaxJitter(0), myDrift(0)
+    {
+        for (size_t i = 0; i < times.size(); ++i)
+        {
+            const int64_t error = getMicroseconds(times[i] - expected[i]);
+            myMeanJitter += std::abs(error);
+            myMaxJitter = std::max<int64_t>(myMaxJitter, std::abs(error));
+        }
+
+        myMeanJitter /= times.size();
+        myDrift = getMicroseconds(times.back() - expected.back());
+    }
+
+    int64_t myMeanJitter;
+    int64_t myMaxJitter;
+    int64_t myDrift;
+};
+
+std::ostream &operator<<(std::ostream &os, const TimingStats &stats)
+{
+    return os << "mean jitter " << stats.myMeanJitter << " us, max jitter "
+              << stats.myMaxJitter << " us, cumulative drift " << stats.myDrift
+              << " us";
+}
+}
+
+/// Compares the scheduler against the previous approach of sleeping for the
+/// delta between consecutive events, for a few seconds of sixteenth notes.
+TEST_CASE("Audio/MidiScheduler/Benchmark", "[.][benchmark]")
+{
+    const int ticks_per_beat = 960;
+    const int beat_duration = 100000;
+    const int num_notes = 500;
+    const auto send_time = microseconds(100);
+
+    MidiEventList events;
+    for (int i = 0; i < num_notes; ++i)
+    {
+        events.append(MidiEvent::noteOn(i * ticks_per_beat / 4, 0, 60, 127,
+                                        SystemLocation()));
+    }
+
+    MidiScheduler scheduler(ticks_per_beat, beat_duration);
+
+    auto getExpectedTimes = [&](Clock::time_point start) {
+        std::vector<Clock::time_point> expected;
+        for (const MidiEvent &event : events)
+        {
+            expected.push_back(
+                start + microseconds(event.getTicks() * beat_duration /
+                                     ticks_per_beat));
+        }
+        return expected;
+    };
+
+    {
+        FakeMidiOutputDevice device(send_time);
+        const Clock::time_point start = Clock::now();
+
+        int64_t prev_tick = 0;
+        for (const MidiEvent &event : events)
+        {
+            std::this_thread::sleep_for(microseconds(
+                (event.getTicks() - prev_tick) * beat_duration /
+                ticks_per_beat));
+            prev_tick = event.getTicks();
+
+            device.sendMessage(event.getData().begin(), event.getData().size());
+        }
+
+        std::cout << "Sleeping between events: "
+                  << TimingStats(device.getTimes(), getExpectedTimes(start))
+                  << std::endl;
+    }
+
+    {
+        FakeMidiOutputDevice device(send_time);
+        std::atomic<int> speed(100);
+        std::atomic<bool> playing(true);
+
+        const Clock::time_point start = Clock::now();
+        scheduler.start(0, start, speed);
+        scheduler.play(events.begin(), events.end(), speed, playing,
+                       [&](MidiEventList::const_iterator begin,
+                           MidiEventList::const_iterator end) {
+                           for (auto event = begin; event != end; ++event)
+                           {
+                               device.sendMessage(event->getData().begin(),
+                                                  event->getData().size());
+                           }
+                       });
+
+        std::cout << "Scheduler: "
+                  << TimingStats(device.getTimes(), getExpectedTimes(start))
+                  << std::endl;
+    }
+}
@@ -0,0 +1,37 @@
+/*
+  * Copyright (C) 2011 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define CATCH_CONFIG_RUNNER
+#include <catch.hpp>
+#include <QApplication>
+#include <QFontDatabase>
+
+int main(int argc, char *argv[])
+{
+    // The rendering benchmarks need widgets and fonts, but not a display.
+    if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication app(argc, argv);
+
+    // Load the same fonts as the application.
+    QFontDatabase::addApplicationFont(":fonts/emmentaler-13.otf");
+    QFontDatabase::addApplicationFont(":fonts/LiberationSans-Regular.ttf");
+    QFontDatabase::addApplicationFont(":fonts/LiberationSerif-Regular.ttf");
+
+    return Catch::Session().run(argc, argv);
+}
@@ -18,8 +18,17 @@
 #include <catch.hpp>
 
 #include <app/appinfo.h>
+#include <boost/filesystem/fstream.hpp>
+#include <chrono>
+#include <cstdint>
+#include <formats/gpx/documentreader.h>
+#include <formats/gpx/filesystem.h>
 #include <formats/gpx/gpximporter.h>
+#include <iostream>
 #include <score/score.h>
+#include <sstream>
+#include <string>
+#include <vector>
 
 TEST_CASE("Formats/GpxImport/Text", "")
 {
@@ -32,4 +41,282 @@ TEST_CASE("Formats/GpxImport/Text", "")
     REQUIRE(system.getTextItems().size() == 1);
     REQUIRE(system.getTextItems()[0].getPosition() == 9);
     REQUIRE(system.getTextItems()[0].getContents() == "foo");
-}
\ No newline at end of file
+}
+namespace
+{
+/// Writes bits in the order expected by Gpx::BitStream.
+class BitWriter
+{
+public:
+    void writeBits(uint32_t value, int n, bool reversed = false)
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            const int bit = reversed ? i : n - 1 - i;
+            if (myNumBits % 8 == 0)
+                myBytes.push_back(0);
+            if ((value >> bit) & 1)
+                myBytes.back() |= 0x80 >> (myNumBits % 8);
+            ++myNumBits;
+        }
+    }
+
+    std::string myBytes;
+    size_t myNumBits = 0;
+};
+}
+
+/// Compresses data in the BCFZ format, using back-references to earlier
+/// data at power-of-two offsets.
+static std::string compress(const std::string &data)
+{
+    BitWriter writer;
+    size_t i = 0;
+    while (i < data.size())
+    {
+        size_t best_offset = 0, best_length = 0;
+        for (size_t offset = 1; offset <= i && offset < 0x8000; offset *= 2)
+        {
+            size_t length = 0;
+            while (length < offset && i + length < data.size() &&
+                   data[i + length] == data[i + length - offset])
+            {
+                ++length;
+            }
+
+            if (length > best_length)
+            {
+                best_offset = offset;
+                best_length = length;
+            }
+        }
+
+        if (best_length >= 4)
+        {
+            writer.writeBits(1, 1);
+            writer.writeBits(15, 4);
+            writer.writeBits(static_cast<uint32_t>(best_offset), 15, true);
+            writer.writeBits(static_cast<uint32_t>(best_length), 15, true);
+            i += best_length;
+        }
+        else
+        {
+            const size_t length = std::min<size_t>(3, data.size() - i);
+            writer.writeBits(0, 1);
+            writer.writeBits(static_cast<uint32_t>(length), 2, true);
+            for (size_t j = 0; j < length; ++j, ++i)
+                writer.writeBits(static_cast<uint8_t>(data[i]), 8);
+        }
+    }
+
+    // The decoder stops before the last byte.
+    writer.myBytes.push_back(0);
+
+    std::string output("BCFZ");
+    for (int shift = 0; shift < 32; shift += 8)
+        output.push_back(static_cast<char>(data.size() >> shift));
+    return output + writer.myBytes;
+}
+
+static void writeUInt(std::string &data, size_t index, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+        data[index + i] = static_cast<char>(value >> (8 * i));
+}
+
+/// Adds a file entry to a BCFS image at the given sector.
+static void addFile(std::string &image, uint32_t sector,
+                    const std::string &name, const std::string &contents,
+                    const std::vector<uint32_t> &blocks)
+{
+    const size_t SECTOR_SIZE = 0x1000;
+    const size_t entry = 4 + sector * SECTOR_SIZE;
+    writeUInt(image, entry, 2);
+    image.replace(entry + 4, name.size(), name);
+    writeUInt(image, entry + 0x8C, static_cast<uint32_t>(contents.size()));
+
+    for (size_t i = 0; i < blocks.size(); ++i)
+    {
+        writeUInt(image, entry + 0x94 + 4 * i, blocks[i]);
+
+        const size_t start = i * SECTOR_SIZE;
+        if (start < contents.size())
+        {
+            image.replace(4 + blocks[i] * SECTOR_SIZE,
+                          std::min(SECTOR_SIZE, contents.size() - start),
+                          contents.substr(start, SECTOR_SIZE));
+        }
+    }
+}
+
+TEST_CASE("Formats/GpxImport/FileSystem", "")
+{
+    std::string contiguous, fragmented;
+    for (int i = 0; i < 5000; ++i)
+        contiguous.push_back(static_cast<char>('a' + i % 26));
+    for (int i = 0; i < 6000; ++i)
+        fragmented.push_back(static_cast<char>('A' + i % 7));
+
+    std::string image("BCFS");
+    image.resize(4 + 8 * 0x1000);
+    addFile(image, 1, "contiguous.xml", contiguous, { 2, 3 });
+    addFile(image, 4, "fragmented.xml", fragmented, { 7, 5 });
+
+    std::istringstream stream(compress(image));
+    Gpx::FileSystem file_system(stream);
+
+    boost::string_ref file = file_system.getFileContents("contiguous.xml");
+    REQUIRE(file == contiguous);
+
+    file = file_system.getFileContents("fragmented.xml");
+    REQUIRE(file == fragmented);
+    // The assembled contents should be reused.
+    REQUIRE(file_system.getFileContents("fragmented.xml").data() ==
+            file.data());
+
+    REQUIRE_THROWS(file_system.getFileContents("missing.xml"));
+}
+
+/// Measures the throughput of decompressing a GPX file.
+/// This is hidden by default - run with "pte_tests [benchmark]".
+TEST_CASE("Formats/GpxImport/DecompressBenchmark", "[.][benchmark]")
+{
+    std::string data;
+    {
+        boost::filesystem::ifstream input(
+            AppInfo::getAbsolutePath("data/text.gpx"), std::ios::binary);
+        std::ostringstream contents;
+        contents << input.rdbuf();
+        data = contents.str();
+    }
+
+    const int iterations = 500;
+    size_t total_size = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        std::istringstream stream(data);
+        Gpx::FileSystem file_system(stream);
+        total_size += file_system.getFileContents("score.gpif").size();
+    }
+    auto elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    REQUIRE(total_size > 0);
+    std::cout << "Decompressed " << iterations << " files at "
+              << (data.size() * iterations) / (elapsed * 1024 * 1024)
+              << " MB/s (compressed), "
+              << total_size / (elapsed * 1024 * 1024)
+              << " MB/s (score.gpif)" << std::endl;
+}
+
+/// Builds a score.gpif document with the given number of bars, where each bar
+/// contains eight eighth notes for each of two tracks.
+static std::string generateDocument(int num_bars)
+{
+    const int num_tracks = 2;
+    const int beats_per_bar = 8;
+    std::ostringstream xml;
+
+    xml << "<GPIF><Score><Title>Benchmark</Title></Score><Tracks>";
+    for (int i = 0; i < num_tracks; ++i)
+    {
+        xml << "<Track id=\"" << i << "\"><Name>Track</Name>"
+            << "<GeneralMidi><Program>25</Program></GeneralMidi>"
+            << "<Properties><Property name=\"Tuning\">"
+            << "<Pitches>40 45 50 55 59 64</Pitches></Property>"
+            << "</Properties></Track>";
+    }
+
+    xml << "</Tracks><MasterBars>";
+    for (int i = 0; i < num_bars; ++i)
+    {
+        xml << "<MasterBar><Key><AccidentalCount>0</AccidentalCount>"
+            << "<Mode>Major</Mode></Key><Time>4/4</Time><Bars>";
+        for (int j = 0; j < num_tracks; ++j)
+            xml << (j ? " " : "") << i * num_tracks + j;
+        xml << "</Bars></MasterBar>";
+    }
+
+    xml << "</MasterBars><Bars>";
+    for (int i = 0; i < num_bars * num_tracks; ++i)
+    {
+        xml << "<Bar id=\"" << i << "\"><Voices>" << i
+            << " -1 -1 -1</Voices></Bar>";
+    }
+
+    xml << "</Bars><Voices>";
+    for (int i = 0; i < num_bars * num_tracks; ++i)
+    {
+        xml << "<Voice id=\"" << i << "\"><Beats>";
+        for (int j = 0; j < beats_per_bar; ++j)
+            xml << (j ? " " : "") << i * beats_per_bar + j;
+        xml << "</Beats></Voice>";
+    }
+
+    const int num_beats = num_bars * num_tracks * beats_per_bar;
+    xml << "</Voices><Beats>";
+    for (int i = 0; i < num_beats; ++i)
+    {
+        xml << "<Beat id=\"" << i << "\"><Rhythm ref=\"0\"/><Notes>" << i
+            << "</Notes><Properties><Property name=\"Brush\">"
+            << "<Direction>Up</Direction></Property></Properties></Beat>";
+    }
+
+    xml << "</Beats><Notes>";
+    for (int i = 0; i < num_beats; ++i)
+    {
+        xml << "<Note id=\"" << i << "\"><Properties>"
+            << "<Property name=\"String\"><String>" << i % 6
+            << "</String></Property><Property name=\"Fret\"><Fret>"
+            << i % 12 << "</Fret></Property></Properties></Note>";
+    }
+
+    xml << "</Notes><Rhythms><Rhythm id=\"0\"><NoteValue>Eighth</NoteValue>"
+        << "</Rhythm></Rhythms></GPIF>";
+    return xml.str();
+}
+
+TEST_CASE("Formats/GpxImport/EmptyVoice", "")
+{
+    // A voice id of -1 indicates an empty voice, which is used here for the
+    // second track's bar.
+    std::string xml = generateDocument(1);
+    const std::string voices = "<Voices>1 -1";
+    const size_t pos = xml.find(voices);
+    REQUIRE(pos != std::string::npos);
+    xml.replace(pos, voices.size(), "<Voices>-1 -1");
+
+    Score score;
+    Gpx::DocumentReader reader(std::vector<char>(xml.begin(), xml.end()));
+    reader.readScore(score);
+
+    const System &system = score.getSystems()[0];
+    REQUIRE(system.getStaves()[0].getVoices()[0].getPositions().size() == 8);
+    REQUIRE(system.getStaves()[1].getVoices()[0].getPositions().empty());
+}
+
+/// Measures the time for reading a large GPX document.
+/// This is hidden by default - run with "pte_tests [benchmark]".
+TEST_CASE("Formats/GpxImport/DocumentReaderBenchmark", "[.][benchmark]")
+{
+    const int num_bars = 5000;
+    const std::string xml = generateDocument(num_bars);
+
+    std::vector<char> buffer(xml.begin(), xml.end());
+
+    auto start = std::chrono::steady_clock::now();
+    Score score;
+    Gpx::DocumentReader reader(std::move(buffer));
+    reader.readScore(score);
+    auto elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    REQUIRE(score.getPlayers().size() == 2);
+    REQUIRE(score.getSystems().size() > 0);
+
+    std::cout << "Read " << num_bars << " bars (" << xml.size() / 1024
+              << " KB) in " << elapsed * 1000 << " ms, "
+              << xml.size() / (elapsed * 1024 * 1024) << " MB/s" << std::endl;
+}
@@ -18,8 +18,14 @@
 #include <catch.hpp>
 
 #include <app/appinfo.h>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/scope_exit.hpp>
+#include <chrono>
 #include <formats/guitar_pro/guitarproimporter.h>
+#include <iostream>
 #include <score/score.h>
+#include <sstream>
 
 static void loadTest(GuitarProImporter &importer, const char *filename,
                      Score &score)
@@ -288,4 +294,72 @@ TEST_CASE("Formats/GuitarPro/IrregularGroups", "")
     REQUIRE(groups[2].getLength() == 6);
     REQUIRE(groups[2].getNotesPlayed() == 6);
     REQUIRE(groups[2].getNotesPlayedOver() == 4);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Formats/GuitarPro/TruncatedFile", "")
+{
+    std::string contents;
+    {
+        boost::filesystem::ifstream input(
+            AppInfo::getAbsolutePath("data/keys.gp5"), std::ios::binary);
+        std::ostringstream stream;
+        stream << input.rdbuf();
+        contents = stream.str();
+    }
+
+    const boost::filesystem::path path =
+        boost::filesystem::temp_directory_path() /
+        boost::filesystem::unique_path("pte-%%%%-%%%%.gp5");
+    // Remove the file even if a check fails.
+    BOOST_SCOPE_EXIT(&path) {
+        boost::system::error_code ec;
+        boost::filesystem::remove(path, ec);
+    } BOOST_SCOPE_EXIT_END
+
+    {
+        boost::filesystem::ofstream output(path, std::ios::binary);
+        output << contents.substr(0, contents.size() / 2);
+    }
+
+    Score score;
+    GuitarProImporter importer;
+    REQUIRE_THROWS_AS(importer.load(path, score), FileFormatException);
+}
+
+/// Measures the import throughput across the test files.
+/// This is hidden by default - run with "pte_tests [benchmark]".
+TEST_CASE("Formats/GuitarPro/Benchmark", "[.][benchmark]")
+{
+    const char *files[] = {
+        "data/alt_endings.gp5",     "data/barlines.gp5",
+        "data/gracenote.gp5",       "data/irregular.gp5",
+        "data/keys.gp5",            "data/notes.gp5",
+        "data/positions.gp5",       "data/rehearsal_signs.gp5",
+        "data/tempos.gp5",          "data/text.gp5",
+        "data/time_signatures.gp5"
+    };
+
+    const int iterations = 200;
+    uintmax_t total_size = 0;
+    GuitarProImporter importer;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        for (const char *file : files)
+        {
+            const boost::filesystem::path path =
+                AppInfo::getAbsolutePath(file);
+
+            Score score;
+            importer.load(path, score);
+            total_size += boost::filesystem::file_size(path);
+        }
+    }
+    auto elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Imported " << total_size / 1024 << " KB in "
+              << elapsed * 1000 << " ms, "
+              << total_size / (elapsed * 1024 * 1024) << " MB/s" << std::endl;
+}
@@ -0,0 +1,374 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <catch.hpp>
+
+#include <app/appinfo.h>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <chrono>
+#include <formats/powertab/chunkedfile.h>
+#include <formats/powertab/powertabexporter.h>
+#include <formats/powertab/powertabimporter.h>
+#include <iostream>
+#include <score/score.h>
+#include <sstream>
+#include "../../score/test_scoregenerator.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+static const char *theTestFiles[] = {
+    "data/test_editstaff.pt2",
+    "data/test_viewfilter.pt2"
+};
+
+/// Saves the score with the given encoding and loads it back.
+static void roundTrip(const Score &score, PowerTabExporter::Encoding encoding,
+                      Score &copy)
+{
+    const boost::filesystem::path path =
+        boost::filesystem::temp_directory_path() /
+        boost::filesystem::unique_path("pte-%%%%-%%%%.pt2");
+
+    PowerTabExporter exporter(encoding);
+    exporter.save(path, score);
+
+    PowerTabImporter importer;
+    importer.load(path, copy);
+
+    boost::filesystem::remove(path);
+}
+
+TEST_CASE("Formats/PowerTab/BinaryRoundTrip", "")
+{
+    for (const char *filename : theTestFiles)
+    {
+        INFO(filename);
+
+        Score score;
+        PowerTabImporter importer;
+        importer.load(AppInfo::getAbsolutePath(filename), score);
+
+        Score copy;
+        roundTrip(score, PowerTabExporter::Encoding::Binary, copy);
+        REQUIRE(score == copy);
+
+        // Converting back to JSON should also give the same result.
+        Score json_copy;
+        roundTrip(copy, PowerTabExporter::Encoding::Json, json_copy);
+        REQUIRE(score == json_copy);
+    }
+}
+
+TEST_CASE("Formats/PowerTab/ChunkedRoundTrip", "")
+{
+    for (const char *filename : theTestFiles)
+    {
+        INFO(filename);
+
+        Score score;
+        PowerTabImporter importer;
+        importer.load(AppInfo::getAbsolutePath(filename), score);
+
+        Score copy;
+        roundTrip(score, PowerTabExporter::Encoding::Chunked, copy);
+        REQUIRE(score == copy);
+    }
+
+    // Check that the systems end up in the right order when they are loaded
+    // by several threads.
+    Score score;
+    ScoreGenerator::generate(score, 50, 2);
+
+    std::stringstream stream;
+    PowerTab::Chunked::save(stream, score, 4);
+
+    Score copy;
+    PowerTab::Chunked::load(stream, copy, 4);
+    REQUIRE(score == copy);
+
+    // Load the systems on demand, with a memory budget that is small enough
+    // for systems to be unloaded.
+    stream.seekg(0);
+    Score lazy_copy;
+    PowerTab::Chunked::loadLazy(stream, lazy_copy, 1024);
+    REQUIRE(lazy_copy.hasSystemLoader());
+    REQUIRE(!lazy_copy.isSystemLoaded(0));
+
+    REQUIRE(score == lazy_copy);
+    lazy_copy.releaseSystems();
+    REQUIRE(!lazy_copy.isSystemLoaded(0));
+    REQUIRE(score == lazy_copy);
+}
+
+/// Compares the load and save times of the two encodings on a large score.
+/// This is hidden by default - run with "pte_tests [benchmark]".
+TEST_CASE("Formats/PowerTab/Benchmark", "[.][benchmark]")
+{
+    Score source;
+    PowerTabImporter importer;
+    importer.load(AppInfo::getAbsolutePath(theTestFiles[0]), source);
+
+    // Build a large score by repeating the systems.
+    Score score;
+    for (const Player &player : source.getPlayers())
+        score.insertPlayer(player);
+    for (const Instrument &instrument : source.getInstruments())
+        score.insertInstrument(instrument);
+    while (score.getSystems().size() < 400)
+    {
+        for (const System &system : source.getSystems())
+            score.insertSystem(system);
+    }
+
+    const boost::filesystem::path path =
+        boost::filesystem::temp_directory_path() /
+        boost::filesystem::unique_path("pte-%%%%-%%%%.pt2");
+
+    for (auto encoding : { PowerTabExporter::Encoding::Json,
+                           PowerTabExporter::Encoding::Binary })
+    {
+        using Clock = std::chrono::steady_clock;
+        PowerTabExporter exporter(encoding);
+
+        auto start = Clock::now();
+        exporter.save(path, score);
+        auto save_time = Clock::now() - start;
+
+        Score copy;
+        start = Clock::now();
+        importer.load(path, copy);
+        auto load_time = Clock::now() - start;
+
+        REQUIRE(score == copy);
+
+        using std::chrono::milliseconds;
+        std::cout << (encoding == PowerTabExporter::Encoding::Json ? "JSON"
+                                                                   : "Binary")
+                  << ": save "
+                  << std::chrono::duration_cast<milliseconds>(save_time).count()
+                  << " ms, load "
+                  << std::chrono::duration_cast<milliseconds>(load_time).count()
+                  << " ms, size " << boost::filesystem::file_size(path)
+                  << " bytes" << std::endl;
+    }
+
+    boost::filesystem::remove(path);
+}
+
+/// Returns the current resident set size of the process in kilobytes, or zero
+/// if it is not available.
+static long getMemoryUsage()
+{
+#ifdef _WIN32
+    return 0;
+#else
+    // The peak from getrusage() would include generating the test file, so
+    // sample the current size instead.
+    boost::filesystem::ifstream statm("/proc/self/statm");
+    long size = 0;
+    long resident = 0;
+    if (!(statm >> size >> resident))
+        return 0;
+
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+#endif
+}
+
+/// Measures the time and memory usage for loading a large JSON file.
+TEST_CASE("Formats/PowerTab/StreamingLoadBenchmark", "[.][benchmark]")
+{
+    const boost::filesystem::path path =
+        boost::filesystem::temp_directory_path() /
+        boost::filesystem::unique_path("pte-%%%%-%%%%.pt2");
+
+    // 2500 systems with 4 bars each.
+    {
+        Score score;
+        ScoreGenerator::generate(score, 2500, 4);
+
+        PowerTabExporter exporter;
+        exporter.save(path, score);
+    }
+
+#ifdef __GLIBC__
+    // Return the memory that was used to generate the file to the system, so
+    // that it is not counted as part of the baseline.
+    malloc_trim(0);
+#endif
+    const long initial_memory = getMemoryUsage();
+
+    auto start = std::chrono::steady_clock::now();
+    Score score;
+    PowerTabImporter importer;
+    importer.load(path, score);
+    auto load_time = std::chrono::steady_clock::now() - start;
+
+    REQUIRE(score.getSystems().size() == 2500);
+
+    const long final_memory = getMemoryUsage();
+    std::cout << "Loaded 10000 bars in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     load_time).count()
+              << " ms, RSS grew by " << final_memory - initial_memory
+              << " KB (from " << initial_memory << " KB)" << std::endl;
+
+    boost::filesystem::remove(path);
+}
+
+/// Returns a unique path for a temporary file.
+static boost::filesystem::path getTempPath()
+{
+    return boost::filesystem::temp_directory_path() /
+           boost::filesystem::unique_path("pte-%%%%-%%%%.pt2");
+}
+
+static void loadChunked(const boost::filesystem::path &path, Score &score)
+{
+    boost::filesystem::ifstream file(path, std::ios::in | std::ios::binary);
+    PowerTab::Chunked::load(file, score);
+}
+
+TEST_CASE("Formats/PowerTab/ChunkedSaveChanges", "")
+{
+    const boost::filesystem::path path = getTempPath();
+
+    Score score;
+    ScoreGenerator::generate(score, 10, 2);
+
+    // If there isn't an existing file, everything should be written.
+    PowerTab::Chunked::saveChanges(path, score, {});
+    {
+        Score copy;
+        loadChunked(path, copy);
+        REQUIRE(score == copy);
+    }
+
+    // Only system 3 should be written again, so the change to system 5 won't
+    // be saved.
+    score.getSystems()[3].getBarlines()[1].setPosition(1000);
+    score.getSystems()[5].getBarlines()[1].setPosition(2000);
+    PowerTab::Chunked::saveChanges(path, score, { 3 });
+    {
+        Score copy;
+        loadChunked(path, copy);
+        REQUIRE(copy.getSystems()[3] == score.getSystems()[3]);
+        REQUIRE(copy.getSystems()[5].getBarlines()[1].getPosition() != 2000);
+        REQUIRE(copy.getSystems()[6] == score.getSystems()[6]);
+
+        copy.getSystems()[5].getBarlines()[1].setPosition(2000);
+        REQUIRE(score == copy);
+    }
+
+    // If the number of systems has changed, everything should be written.
+    score.removeSystem(0);
+    PowerTab::Chunked::saveChanges(path, score, {});
+    {
+        Score copy;
+        loadChunked(path, copy);
+        REQUIRE(score == copy);
+    }
+
+    // No temporary files should be left behind.
+    int num_files = 0;
+    const boost::filesystem::path dir = path.parent_path();
+    for (auto it = boost::filesystem::directory_iterator(dir);
+         it != boost::filesystem::directory_iterator(); ++it)
+    {
+        if (it->path().filename().string().find(
+                path.filename().string()) == 0)
+        {
+            ++num_files;
+        }
+    }
+    REQUIRE(num_files == 1);
+
+    boost::filesystem::remove(path);
+}
+
+/// Compares the time for saving a large file after a single edit.
+TEST_CASE("Formats/PowerTab/IncrementalSaveBenchmark", "[.][benchmark]")
+{
+    const boost::filesystem::path path = getTempPath();
+
+    Score score;
+    ScoreGenerator::generate(score, 2500, 4);
+
+    using Clock = std::chrono::steady_clock;
+    using std::chrono::milliseconds;
+
+    auto start = Clock::now();
+    PowerTab::Chunked::saveChanges(path, score, {});
+    auto full_time = Clock::now() - start;
+
+    score.getSystems()[100].getBarlines()[1].setPosition(1000);
+
+    start = Clock::now();
+    PowerTab::Chunked::saveChanges(path, score, { 100 });
+    auto delta_time = Clock::now() - start;
+
+    Score copy;
+    loadChunked(path, copy);
+    REQUIRE(score == copy);
+
+    std::cout << "Full save: "
+              << std::chrono::duration_cast<milliseconds>(full_time).count()
+              << " ms, save after one edit: "
+              << std::chrono::duration_cast<milliseconds>(delta_time).count()
+              << " ms" << std::endl;
+
+    boost::filesystem::remove(path);
+}
+
+/// Measures how the load time of the chunked format scales with the number of
+/// threads.
+TEST_CASE("Formats/PowerTab/ParallelLoadBenchmark", "[.][benchmark]")
+{
+    std::string data;
+    {
+        Score score;
+        ScoreGenerator::generate(score, 500, 4);
+
+        std::ostringstream output;
+        PowerTab::Chunked::save(output, score);
+        data = output.str();
+    }
+
+    for (unsigned int num_threads = 1;
+         num_threads <= Util::defaultThreadCount(); num_threads *= 2)
+    {
+        std::istringstream input(data);
+
+        auto start = std::chrono::steady_clock::now();
+        Score score;
+        PowerTab::Chunked::load(input, score, num_threads);
+        auto load_time = std::chrono::steady_clock::now() - start;
+
+        REQUIRE(score.getSystems().size() == 500);
+
+        std::cout << "Loaded 500 systems with " << num_threads
+                  << " thread(s) in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(
+                         load_time).count()
+                  << " ms" << std::endl;
+    }
+}
@@ -0,0 +1,138 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <catch.hpp>
+
+#include <app/appinfo.h>
+#include <app/settingsmanager.h>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <formats/batchconverter.h>
+#include <string>
+#include <vector>
+
+namespace fs = boost::filesystem;
+
+TEST_CASE("Formats/BatchConverter", "")
+{
+    const fs::path dir =
+        fs::temp_directory_path() / fs::unique_path("pte-batch-%%%%-%%%%");
+
+    BatchConverter::Options options;
+    options.myInputDir = dir / "input";
+    options.myReportFile = dir / "report.jsonl";
+    options.myNumThreads = 2;
+
+    fs::create_directories(options.myInputDir / "nested");
+    fs::copy_file(AppInfo::getAbsolutePath("data/keys.gp5"),
+                  options.myInputDir / "keys.gp5");
+    fs::copy_file(AppInfo::getAbsolutePath("data/notes.gp5"),
+                  options.myInputDir / "nested" / "notes.gp5");
+    {
+        fs::ofstream invalid(options.myInputDir / "invalid.gp5");
+        invalid << "not a guitar pro file";
+        fs::ofstream unsupported(options.myInputDir / "readme.txt");
+        unsupported << "ignored";
+    }
+
+    SettingsManager settings_manager;
+
+    SECTION("Validate")
+    {
+        BatchConverter converter(settings_manager, options);
+        std::vector<BatchConverter::Result> failures;
+        REQUIRE(converter.findFiles(failures).size() == 3);
+        REQUIRE(failures.empty());
+
+        auto results = converter.run();
+        REQUIRE(results.size() == 3);
+        REQUIRE(results[0].myFile == "invalid.gp5");
+        REQUIRE(!results[0].mySuccess);
+        REQUIRE(!results[0].myError.empty());
+        REQUIRE(results[1].myFile == "keys.gp5");
+        REQUIRE(results[1].mySuccess);
+        REQUIRE(results[1].myNumSystems > 0);
+        REQUIRE(results[1].myNumPlayers > 0);
+        REQUIRE(results[2].mySuccess);
+
+        REQUIRE(BatchConverter::readReport(options.myReportFile).size() == 3);
+        REQUIRE(BatchConverter::readUnfinishedFiles(options.myReportFile)
+                    .empty());
+
+        // Simulate a job that crashed while processing a file, and was then
+        // interrupted while writing a line.
+        fs::copy_file(AppInfo::getAbsolutePath("data/keys.gp5"),
+                      options.myInputDir / "crash.gp5");
+        {
+            fs::ofstream report(options.myReportFile, std::ios::app);
+            report << BatchConverter::formatStarted("crash.gp5") << '\n';
+            report << "{\"file\": \"nes";
+        }
+        REQUIRE(BatchConverter::readUnfinishedFiles(options.myReportFile) ==
+                std::vector<fs::path>{ "crash.gp5" });
+
+        // The completed files should be skipped, and the file that crashed
+        // should be reported as a failure rather than processed again.
+        fs::copy_file(AppInfo::getAbsolutePath("data/tempos.gp5"),
+                      options.myInputDir / "tempos.gp5");
+        results = converter.run();
+        REQUIRE(results.size() == 2);
+        REQUIRE(results[0].myFile == "crash.gp5");
+        REQUIRE(!results[0].mySuccess);
+        REQUIRE(results[1].myFile == "tempos.gp5");
+        REQUIRE(results[1].mySuccess);
+        REQUIRE(BatchConverter::readReport(options.myReportFile).size() == 5);
+        REQUIRE(BatchConverter::readUnfinishedFiles(options.myReportFile)
+                    .empty());
+    }
+
+    SECTION("Convert")
+    {
+        options.myOutputDir = dir / "output";
+        options.myOutputFormat = "pt2";
+        options.myPolish = true;
+
+        // This has the same output path as keys.gp5.
+        fs::copy_file(AppInfo::getAbsolutePath("data/tempos.gp5"),
+                      options.myInputDir / "keys.gpx");
+
+        BatchConverter converter(settings_manager, options);
+        auto results = converter.run();
+        REQUIRE(results.size() == 4);
+        REQUIRE(results[0].myFile == "keys.gpx");
+        REQUIRE(!results[0].mySuccess);
+        REQUIRE(results[2].myFile == "keys.gp5");
+        REQUIRE(results[2].mySuccess);
+        REQUIRE(results[3].mySuccess);
+
+        REQUIRE(fs::exists(options.myOutputDir / "keys.pt2"));
+        REQUIRE(fs::exists(options.myOutputDir / "nested" / "notes.pt2"));
+        REQUIRE(!fs::exists(options.myOutputDir / "invalid.pt2"));
+    }
+
+    fs::remove_all(dir);
+}
+
+TEST_CASE("Formats/BatchConverter/FormatResult", "")
+{
+    BatchConverter::Result result;
+    result.myFile = "dir/file.gp5";
+    result.myError = "Invalid \"file\"";
+    REQUIRE(BatchConverter::formatResult(result) ==
+            "{\"file\":\"dir/file.gp5\",\"success\":false,"
+            "\"error\":\"Invalid \\\"file\\\"\"}");
+}
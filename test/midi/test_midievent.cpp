@@ -0,0 +1,127 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <midi/midievent.h>
+#include <midi/midifile.h>
+#include <new>
+#include <score/score.h>
+#include <type_traits>
+#include "../score/test_scoregenerator.h"
+
+/// Counts the heap allocations made by the test program, for the benchmarks.
+static std::atomic<size_t> theAllocationCount(0);
+
+void *operator new(std::size_t size)
+{
+    ++theAllocationCount;
+
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+TEST_CASE("Midi/MidiEvent/Data", "")
+{
+    static_assert(std::is_trivially_copyable<MidiEvent>::value,
+                  "MidiEvent should be trivially copyable.");
+
+    const MidiEvent note =
+        MidiEvent::noteOn(1, 2, 60, 127, SystemLocation(3, 4));
+    REQUIRE(note.getTicks() == 1);
+    REQUIRE(note.getChannel() == 2);
+    REQUIRE(note.isNoteOnOff());
+    REQUIRE(note.getLocation() == SystemLocation(3, 4));
+    REQUIRE(note.getData().size() == 3);
+    REQUIRE(note.getData()[0] == MidiEvent::NoteOn + 2);
+    REQUIRE(note.getData()[1] == 60);
+    REQUIRE(note.getData()[2] == 127);
+
+    const MidiEvent program = MidiEvent::programChange(0, 1, 30);
+    REQUIRE(program.isProgramChange());
+    REQUIRE(program.getData().size() == 2);
+
+    // Meta messages are also stored inline.
+    MidiEvent tempo = MidiEvent::setTempo(0, 500000);
+    REQUIRE(tempo.isTempoChange());
+    REQUIRE(tempo.getTempo() == 500000);
+    REQUIRE(tempo.getData().size() == 6);
+
+    REQUIRE(MidiEvent::positionChange(0, SystemLocation(1, 2))
+                .isPositionChange());
+
+    // Absolute times may not fit in 32 bits.
+    const int64_t ticks = 3000000000LL;
+    tempo.setTicks(ticks);
+    REQUIRE(tempo.getTicks() == ticks);
+}
+
+/// Measures the time and number of allocations to generate the MIDI events
+/// for a score where every note is bent and played with vibrato.
+TEST_CASE("Midi/MidiEvent/Benchmark", "[.][benchmark]")
+{
+    using Clock = std::chrono::steady_clock;
+    using std::chrono::milliseconds;
+
+    Score score;
+    ScoreGenerator::generate(score, 100, 4, 4);
+
+    for (System &system : score.getSystems())
+    {
+        for (Staff &staff : system.getStaves())
+        {
+            for (Position &pos : staff.getVoices()[0].getPositions())
+            {
+                pos.setProperty(Position::Vibrato);
+                for (Note &note : pos.getNotes())
+                    note.setBend(Bend(Bend::BendAndRelease, 4));
+            }
+        }
+    }
+
+    MidiFile::LoadOptions options;
+    options.myVibratoStrength = 80;
+
+    const size_t initial_count = theAllocationCount;
+    const auto start = Clock::now();
+
+    MidiFile file;
+    file.load(score, options);
+
+    const auto time = Clock::now() - start;
+    const size_t num_allocations = theAllocationCount - initial_count;
+
+    size_t num_events = 0;
+    for (const MidiEventList &track : file.getTracks())
+        num_events += track.size();
+
+    std::cout << "Events: " << num_events << ", allocations: "
+              << num_allocations << ", time: "
+              << std::chrono::duration_cast<milliseconds>(time).count()
+              << " ms" << std::endl;
+}
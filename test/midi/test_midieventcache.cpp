@@ -0,0 +1,163 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <midi/midieventcache.h>
+#include <midi/midifile.h>
+#include <score/score.h>
+#include "../score/test_scoregenerator.h"
+
+static MidiFile::LoadOptions getOptions()
+{
+    MidiFile::LoadOptions options;
+    options.myEnableMetronome = true;
+    options.myRecordPositionChanges = true;
+    return options;
+}
+
+/// Checks that loading the score with the cache produces the same events as
+/// loading the score from scratch.
+static void requireSameEvents(const Score &score,
+                              const std::shared_ptr<MidiEventCache> &cache)
+{
+    MidiFile expected;
+    expected.load(score, getOptions());
+
+    MidiFile file;
+    file.load(score, getOptions(), cache);
+
+    REQUIRE(file.getTracks().size() == expected.getTracks().size());
+    for (size_t i = 0; i < file.getTracks().size(); ++i)
+    {
+        const MidiEventList &track = file.getTracks()[i];
+        const MidiEventList &expected_track = expected.getTracks()[i];
+        REQUIRE(track.size() == expected_track.size());
+
+        for (auto it1 = track.begin(), it2 = expected_track.begin();
+             it1 != track.end(); ++it1, ++it2)
+        {
+            REQUIRE(it1->getTicks() == it2->getTicks());
+            REQUIRE(it1->getLocation() == it2->getLocation());
+            REQUIRE(it1->getData().size() == it2->getData().size());
+            REQUIRE(std::equal(it1->getData().begin(), it1->getData().end(),
+                               it2->getData().begin()));
+        }
+    }
+}
+
+static void changeNote(Score &score, int system)
+{
+    Note &note = score.getSystems()[system]
+                     .getStaves()[0]
+                     .getVoices()[0]
+                     .getPositions()[2]
+                     .getNotes()[0];
+    note.setFretNumber(note.getFretNumber() + 3);
+}
+
+TEST_CASE("Midi/MidiEventCache/Events", "")
+{
+    Score score;
+    ScoreGenerator::generate(score, 10, 4, 2);
+
+    auto cache = std::make_shared<MidiEventCache>();
+    requireSameEvents(score, cache);
+    REQUIRE(cache->size() == 10 * 4 * 2 * Staff::NUM_VOICES);
+
+    // Reuse the cached events.
+    requireSameEvents(score, cache);
+
+    // Regenerate the modified system.
+    changeNote(score, 3);
+    cache->invalidateSystem(3);
+    REQUIRE(cache->size() == 7 * 4 * 2 * Staff::NUM_VOICES);
+    requireSameEvents(score, cache);
+    REQUIRE(cache->size() == 10 * 4 * 2 * Staff::NUM_VOICES);
+
+    // Changing the options discards the cached events.
+    MidiFile::LoadOptions options = getOptions();
+    options.myVibratoStrength = 50;
+    cache->setOptions(options, 480);
+    REQUIRE(cache->size() == 0);
+}
+
+TEST_CASE("Midi/MidiEventCache/Players", "")
+{
+    Score score;
+    ScoreGenerator::generate(score, 10, 4, 2);
+
+    auto cache = std::make_shared<MidiEventCache>();
+    requireSameEvents(score, cache);
+
+    // Swap the players. The events for the later systems depend on the
+    // players, so they are regenerated even though only the first system's
+    // events were invalidated.
+    System &system = score.getSystems()[0];
+    const PlayerChange change = system.getPlayerChanges()[0];
+    system.removePlayerChange(change);
+
+    PlayerChange new_change(0);
+    new_change.insertActivePlayer(0, ActivePlayer(1, 1));
+    new_change.insertActivePlayer(1, ActivePlayer(0, 0));
+    system.insertPlayerChange(new_change);
+
+    cache->invalidateSystem(0);
+    requireSameEvents(score, cache);
+}
+
+/// Measures how long it takes to generate the events for a large score after
+/// editing a note, with and without the cache.
+TEST_CASE("Midi/MidiEventCache/Benchmark", "[.][benchmark]")
+{
+    using Clock = std::chrono::steady_clock;
+    using std::chrono::microseconds;
+
+    Score score;
+    ScoreGenerator::generate(score, 300, 4, 4);
+
+    auto cache = std::make_shared<MidiEventCache>();
+    {
+        MidiFile file;
+        file.load(score, getOptions(), cache);
+    }
+
+    changeNote(score, 150);
+    cache->invalidateSystem(150);
+
+    auto start = Clock::now();
+    {
+        MidiFile file;
+        file.load(score, getOptions());
+    }
+    auto full_time = Clock::now() - start;
+
+    start = Clock::now();
+    {
+        MidiFile file;
+        file.load(score, getOptions(), cache);
+    }
+    auto cached_time = Clock::now() - start;
+
+    std::cout << "Generating the events after an edit: "
+              << std::chrono::duration_cast<microseconds>(full_time).count()
+              << " us from scratch, "
+              << std::chrono::duration_cast<microseconds>(cached_time).count()
+              << " us with the cache" << std::endl;
+}
@@ -0,0 +1,116 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <midi/midieventlist.h>
+#include <midi/midifile.h>
+#include <score/score.h>
+#include "../score/test_scoregenerator.h"
+
+static MidiEvent makeEvent(int ticks, uint8_t channel, uint8_t pitch)
+{
+    return MidiEvent::noteOn(ticks, channel, pitch, 127, SystemLocation());
+}
+
+static std::vector<std::pair<int, int>> getEvents(const MidiEventList &list)
+{
+    std::vector<std::pair<int, int>> events;
+    for (const MidiEvent &event : list)
+        events.emplace_back(event.getTicks(), event.getData()[1]);
+
+    return events;
+}
+
+TEST_CASE("Midi/MidiEventList/Merge", "")
+{
+    std::vector<MidiEventList> lists(3);
+    lists[0].append(makeEvent(0, 0, 1));
+    lists[0].append(makeEvent(10, 0, 2));
+    lists[0].append(makeEvent(10, 0, 3));
+    lists[0].append(makeEvent(30, 0, 4));
+
+    // The second list is empty.
+
+    lists[2].append(makeEvent(0, 1, 5));
+    lists[2].append(makeEvent(5, 1, 6));
+    lists[2].append(makeEvent(10, 1, 7));
+
+    // Events with the same ticks should keep the order of their lists.
+    const std::vector<std::pair<int, int>> expected = {
+        { 0, 1 }, { 0, 5 }, { 5, 6 }, { 10, 2 }, { 10, 3 }, { 10, 7 }, { 30, 4 }
+    };
+
+    MidiEventList merged = MidiEventList::merge(lists);
+    REQUIRE(merged.size() == 7);
+    REQUIRE(getEvents(merged) == expected);
+
+    // Lists with delta ticks can also be merged.
+    for (MidiEventList &list : lists)
+        list.convertToDeltaTicks();
+
+    merged = MidiEventList::merge(lists);
+    REQUIRE(getEvents(merged) == expected);
+}
+
+/// Compares the previous approach (concatenating the tracks and sorting them)
+/// to merging the tracks, for a song with 20 tracks and 300 systems.
+TEST_CASE("Midi/MidiEventList/MergeBenchmark", "[.][benchmark]")
+{
+    using Clock = std::chrono::steady_clock;
+    using std::chrono::microseconds;
+
+    Score score;
+    ScoreGenerator::generate(score, 300, 4, 20);
+
+    auto start = Clock::now();
+    MidiFile file;
+    file.load(score, MidiFile::LoadOptions());
+    auto load_time = Clock::now() - start;
+
+    start = Clock::now();
+    MidiEventList sorted;
+    {
+        std::vector<MidiEventList> tracks = file.getTracks();
+        for (MidiEventList &track : tracks)
+        {
+            track.convertToAbsoluteTicks();
+            sorted.concat(track);
+        }
+
+        std::stable_sort(sorted.begin(), sorted.end());
+    }
+    auto sort_time = Clock::now() - start;
+
+    start = Clock::now();
+    MidiEventList merged = MidiEventList::merge(file.getTracks());
+    auto merge_time = Clock::now() - start;
+
+    REQUIRE(getEvents(merged) == getEvents(sorted));
+
+    std::cout << "Events: " << merged.size() << ", generating tracks: "
+              << std::chrono::duration_cast<microseconds>(load_time).count()
+              << " us" << std::endl;
+    std::cout << "Concat + stable_sort: "
+              << std::chrono::duration_cast<microseconds>(sort_time).count()
+              << " us, merge: "
+              << std::chrono::duration_cast<microseconds>(merge_time).count()
+              << " us" << std::endl;
+}
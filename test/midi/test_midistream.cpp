@@ -0,0 +1,141 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <midi/midistream.h>
+#include <score/score.h>
+#include <tuple>
+#include "../score/test_scoregenerator.h"
+
+typedef std::tuple<int64_t, std::vector<uint8_t>, SystemLocation> EventInfo;
+
+static void addEvent(std::vector<EventInfo> &events, const MidiEvent &event)
+{
+    events.emplace_back(
+        event.getTicks(),
+        std::vector<uint8_t>(event.getData().begin(), event.getData().end()),
+        event.getLocation());
+}
+
+TEST_CASE("Midi/MidiStream/Events", "")
+{
+    Score score;
+    ScoreGenerator::generate(score, 10, 4, 3);
+
+    MidiFile::LoadOptions options;
+    options.myEnableMetronome = true;
+    options.myRecordPositionChanges = true;
+
+    // The stream should produce the same events as loading the whole score,
+    // except for the end of track events.
+    MidiFile file;
+    file.load(score, options);
+
+    std::vector<EventInfo> expected;
+    for (const MidiEvent &event : MidiEventList::merge(file.getTracks()))
+    {
+        if (event.getStatusByte() != MidiEvent::MetaMessage ||
+            event.isTempoChange())
+        {
+            addEvent(expected, event);
+        }
+    }
+
+    // Use a small queue so that the producer thread needs to wait.
+    MidiStream stream(score, options, nullptr, nullptr, SystemLocation(), 2);
+    REQUIRE(stream.getTicksPerBeat() == file.getTicksPerBeat());
+
+    std::vector<EventInfo> events;
+    int num_bars = 0;
+    int64_t prev_ticks = 0;
+    MidiEventList bar;
+    while (stream.getNextBar(bar))
+    {
+        ++num_bars;
+        for (const MidiEvent &event : bar)
+        {
+            REQUIRE(event.getTicks() >= prev_ticks);
+            prev_ticks = event.getTicks();
+            addEvent(events, event);
+        }
+    }
+
+    REQUIRE(num_bars == 40);
+    REQUIRE(!stream.getNextBar(bar));
+
+    // Events with the same ticks might be in a different order at the start
+    // or end of a bar.
+    std::sort(expected.begin(), expected.end());
+    std::sort(events.begin(), events.end());
+    REQUIRE(events == expected);
+}
+
+TEST_CASE("Midi/MidiStream/Stop", "")
+{
+    Score score;
+    ScoreGenerator::generate(score, 10);
+
+    // The stream can be destroyed while the producer thread is waiting for
+    // the queue to have space.
+    MidiStream stream(score, MidiFile::LoadOptions(), nullptr, nullptr,
+                      SystemLocation(), 1);
+    MidiEventList bar;
+    REQUIRE(stream.getNextBar(bar));
+}
+
+/// Measures the time until the first bar is available, compared to loading
+/// the entire score, for scores of different lengths.
+TEST_CASE("Midi/MidiStream/Benchmark", "[.][benchmark]")
+{
+    using Clock = std::chrono::steady_clock;
+    using std::chrono::microseconds;
+
+    for (int num_systems : { 50, 200, 500 })
+    {
+        Score score;
+        ScoreGenerator::generate(score, num_systems, 4, 4);
+
+        MidiFile::LoadOptions options;
+        options.myEnableMetronome = true;
+        options.myRecordPositionChanges = true;
+
+        auto start = Clock::now();
+        {
+            MidiFile file;
+            file.load(score, options);
+            MidiEventList::merge(file.getTracks());
+        }
+        auto load_time = Clock::now() - start;
+
+        start = Clock::now();
+        MidiStream stream(score, options);
+        MidiEventList bar;
+        REQUIRE(stream.getNextBar(bar));
+        auto stream_time = Clock::now() - start;
+
+        std::cout << num_systems << " systems: loading the score takes "
+                  << std::chrono::duration_cast<microseconds>(load_time).count()
+                  << " us, the first bar is streamed after "
+                  << std::chrono::duration_cast<microseconds>(stream_time)
+                         .count()
+                  << " us" << std::endl;
+    }
+}
@@ -0,0 +1,259 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <midi/midistream.h>
+#include <midi/playbacktimeline.h>
+#include <score/dynamic.h>
+#include <score/score.h>
+#include "../score/test_scoregenerator.h"
+
+/// Generates a score where the first two bars of the second system are
+/// repeated.
+static void generateScore(Score &score, int num_systems, int num_staves = 1)
+{
+    ScoreGenerator::generate(score, num_systems, 4, num_staves);
+
+    System &system = score.getSystems()[1];
+    system.getBarlines()[0].setBarType(Barline::RepeatStart);
+    system.getBarlines()[2].setBarType(Barline::RepeatEnd);
+    system.getBarlines()[2].setRepeatCount(2);
+}
+
+static MidiFile::LoadOptions getOptions()
+{
+    MidiFile::LoadOptions options;
+    options.myEnableMetronome = true;
+    options.myRecordPositionChanges = true;
+    return options;
+}
+
+/// Returns the events for each bar from the stream.
+static std::vector<MidiEventList> getBars(MidiStream &stream)
+{
+    std::vector<MidiEventList> bars;
+    MidiEventList bar;
+    while (stream.getNextBar(bar))
+        bars.push_back(bar);
+
+    return bars;
+}
+
+/// Returns whether the bar contains events for the given system.
+static bool containsSystem(const MidiEventList &bar, int system)
+{
+    return std::any_of(bar.begin(), bar.end(), [=](const MidiEvent &event) {
+        return event.getLocation().getSystem() == system;
+    });
+}
+
+static void requireEqual(const MidiEventList &list1,
+                         const MidiEventList &list2)
+{
+    REQUIRE(list1.size() == list2.size());
+
+    for (auto it1 = list1.begin(), it2 = list2.begin(); it1 != list1.end();
+         ++it1, ++it2)
+    {
+        REQUIRE(it1->getTicks() == it2->getTicks());
+        REQUIRE(it1->getLocation() == it2->getLocation());
+        REQUIRE(it1->getData().size() == it2->getData().size());
+        REQUIRE(std::equal(it1->getData().begin(), it1->getData().end(),
+                           it2->getData().begin()));
+    }
+}
+
+TEST_CASE("Midi/PlaybackTimeline/Seek", "")
+{
+    Score score;
+    generateScore(score, 10);
+
+    auto timeline = std::make_shared<PlaybackTimeline>();
+    REQUIRE(!timeline->seek(SystemLocation(0, 0)));
+
+    int ticks_per_beat = 0;
+    {
+        MidiStream stream(score, getOptions(), timeline);
+        REQUIRE(!stream.getStartBar());
+        ticks_per_beat = stream.getTicksPerBeat();
+        getBars(stream);
+    }
+
+    REQUIRE(timeline->isComplete());
+    REQUIRE(timeline->getNumBars() == 42);
+
+    auto bar = timeline->seek(SystemLocation(1, 12));
+    REQUIRE(bar.is_initialized());
+    REQUIRE(bar->myLocation == SystemLocation(1, 9));
+    REQUIRE(bar->myPass == 0);
+    REQUIRE(bar->myCheckpoint.myBarIndex == 5);
+
+    // The second time through the repeat.
+    bar = timeline->seek(SystemLocation(1, 12), 1);
+    REQUIRE(bar.is_initialized());
+    REQUIRE(bar->myLocation == SystemLocation(1, 9));
+    REQUIRE(bar->myPass == 1);
+    REQUIRE(bar->myCheckpoint.myBarIndex == 7);
+
+    // A bar is only played twice.
+    bar = timeline->seek(SystemLocation(1, 12), 2);
+    REQUIRE(bar.is_initialized());
+    REQUIRE(bar->myPass == 1);
+
+    bar = timeline->seek(SystemLocation(3, 0));
+    REQUIRE(bar.is_initialized());
+    REQUIRE(bar->myLocation == SystemLocation(3, 0));
+    REQUIRE(bar->myCheckpoint.myBarIndex == 14);
+
+    // The location is past the end of the score.
+    REQUIRE(!timeline->seek(SystemLocation(10, 0)));
+
+    // Changing the options discards the timeline.
+    MidiFile::LoadOptions options = getOptions();
+    options.myEnableMetronome = false;
+    timeline->setOptions(options, ticks_per_beat);
+    REQUIRE(timeline->getNumBars() == 0);
+    REQUIRE(!timeline->isComplete());
+}
+
+TEST_CASE("Midi/PlaybackTimeline/Resume", "")
+{
+    Score score;
+    generateScore(score, 10, 2);
+
+    auto timeline = std::make_shared<PlaybackTimeline>();
+    std::vector<MidiEventList> expected;
+    {
+        MidiStream stream(score, getOptions(), timeline);
+        expected = getBars(stream);
+    }
+
+    REQUIRE(expected.size() == timeline->getNumBars());
+
+    // Resuming from a bar should produce the same events as generating the
+    // events from the start of the score.
+    for (const SystemLocation &location :
+         { SystemLocation(0, 0), SystemLocation(1, 9), SystemLocation(1, 20),
+           SystemLocation(6, 30) })
+    {
+        MidiStream stream(score, getOptions(), timeline, nullptr, location);
+        REQUIRE(stream.getStartBar().is_initialized());
+
+        const std::vector<MidiEventList> bars = getBars(stream);
+        const size_t start = stream.getStartBar()->myCheckpoint.myBarIndex;
+        REQUIRE(start + bars.size() == expected.size());
+
+        for (size_t i = 0; i < bars.size(); ++i)
+            requireEqual(bars[i], expected[start + i]);
+    }
+
+    // The channel state should match the initial events for each player.
+    auto bar = timeline->seek(SystemLocation(4, 0));
+    REQUIRE(bar.is_initialized());
+    for (int i = 0; i < 2; ++i)
+    {
+        const PlaybackTimeline::ChannelState &channel = bar->myChannels[i];
+        REQUIRE(channel.myIsUsed);
+        REQUIRE(channel.myHasProgram);
+        REQUIRE(channel.myVolume == Dynamic::fff);
+    }
+    REQUIRE(!bar->myChannels[2].myIsUsed);
+    REQUIRE(bar->getChannelEvents().size() > 0);
+}
+
+TEST_CASE("Midi/PlaybackTimeline/Invalidate", "")
+{
+    Score score;
+    generateScore(score, 10);
+
+    auto timeline = std::make_shared<PlaybackTimeline>();
+    {
+        MidiStream stream(score, getOptions(), timeline);
+        getBars(stream);
+    }
+
+    // The bars from the first time that the system is played are discarded.
+    timeline->invalidateSystem(1);
+    REQUIRE(timeline->getNumBars() == 4);
+    REQUIRE(!timeline->isComplete());
+
+    timeline->invalidateSystem(5);
+    REQUIRE(timeline->getNumBars() == 4);
+
+    // Playback from a later system continues from the end of the timeline.
+    auto bar = timeline->seek(SystemLocation(5, 0));
+    REQUIRE(bar.is_initialized());
+    REQUIRE(bar->myLocation == SystemLocation(0, 27));
+
+    {
+        MidiStream stream(score, getOptions(), timeline, nullptr,
+                          SystemLocation(5, 0));
+        getBars(stream);
+    }
+
+    REQUIRE(timeline->isComplete());
+    REQUIRE(timeline->getNumBars() == 42);
+
+    timeline->clear();
+    REQUIRE(timeline->getNumBars() == 0);
+}
+
+/// Measures the time until the first bar at the start location is available,
+/// with and without a timeline from a previous playback.
+TEST_CASE("Midi/PlaybackTimeline/Benchmark", "[.][benchmark]")
+{
+    using Clock = std::chrono::steady_clock;
+    using std::chrono::microseconds;
+
+    Score score;
+    generateScore(score, 300, 4);
+
+    const SystemLocation location(250, 0);
+    auto timeline = std::make_shared<PlaybackTimeline>();
+
+    // Generate the events from the start of the score until reaching the
+    // location.
+    auto start = Clock::now();
+    {
+        MidiStream stream(score, getOptions(), timeline);
+        MidiEventList bar;
+        while (stream.getNextBar(bar) &&
+               !containsSystem(bar, location.getSystem()))
+        {
+        }
+    }
+    auto initial_time = Clock::now() - start;
+
+    start = Clock::now();
+    {
+        MidiStream stream(score, getOptions(), timeline, nullptr, location);
+        MidiEventList bar;
+        REQUIRE(stream.getNextBar(bar));
+        REQUIRE(containsSystem(bar, location.getSystem()));
+    }
+    auto seek_time = Clock::now() - start;
+
+    std::cout << "Starting playback at system 250: "
+              << std::chrono::duration_cast<microseconds>(initial_time).count()
+              << " us from the start of the score, "
+              << std::chrono::duration_cast<microseconds>(seek_time).count()
+              << " us from the timeline" << std::endl;
+}
@@ -0,0 +1,89 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <catch.hpp>
+
+#include <app/scorearea.h>
+#include <app/viewoptions.h>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <painters/systemrenderer.h>
+#include <QGraphicsItem>
+#include <score/score.h>
+#include <util/parallel.h>
+#include <vector>
+#include "../score/test_scoregenerator.h"
+
+/// Measures how long it takes to lay out every system of a large score on one
+/// thread and on all cores, and to create the items from the layouts.
+TEST_CASE("Painters/SystemRenderer/Benchmark", "[.][benchmark]")
+{
+    using Clock = std::chrono::steady_clock;
+    using std::chrono::milliseconds;
+
+    Score generated_score;
+    ScoreGenerator::generate(generated_score, 500, 4, 2);
+    const Score &score = generated_score;
+    const size_t num_systems = score.getSystems().size();
+    const ViewOptions view_options;
+
+    auto layoutSystems = [&](unsigned int num_threads) {
+        std::vector<std::vector<LayoutConstPtr>> layouts(num_systems);
+        Util::parallelFor(num_systems, [&](size_t i) {
+            const int index = static_cast<int>(i);
+            layouts[i] = SystemRenderer::layoutSystem(
+                score, score.getSystems()[index], index, view_options);
+        }, num_threads);
+
+        return layouts;
+    };
+
+    auto start = Clock::now();
+    layoutSystems(1);
+    const auto serial_time = Clock::now() - start;
+
+    start = Clock::now();
+    const std::vector<std::vector<LayoutConstPtr>> layouts =
+        layoutSystems(Util::defaultThreadCount());
+    const auto parallel_time = Clock::now() - start;
+
+    // The items are created on the GUI thread, as in the score area.
+    ScoreArea score_area(nullptr);
+    SystemRenderer render(&score_area, score, view_options);
+
+    start = Clock::now();
+    for (size_t i = 0; i < num_systems; ++i)
+    {
+        const int index = static_cast<int>(i);
+        std::unique_ptr<QGraphicsItem> item(
+            render(score.getSystems()[index], index, layouts[i]));
+        REQUIRE(item);
+    }
+    const auto items_time = Clock::now() - start;
+
+    std::cout << "Layout of " << num_systems << " systems: "
+              << std::chrono::duration_cast<milliseconds>(serial_time).count()
+              << " ms on 1 thread, "
+              << std::chrono::duration_cast<milliseconds>(parallel_time)
+                     .count()
+              << " ms on " << Util::defaultThreadCount() << " threads"
+              << std::endl;
+    std::cout << "Creating items: "
+              << std::chrono::duration_cast<milliseconds>(items_time).count()
+              << " ms" << std::endl;
+}
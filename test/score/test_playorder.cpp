@@ -0,0 +1,131 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <catch.hpp>
+
+#include <score/alternateending.h>
+#include <score/direction.h>
+#include <score/score.h>
+#include <score/utils/playorder.h>
+#include <vector>
+#include "test_scoregenerator.h"
+
+/// Returns the locations of the bars in the play order.
+static std::vector<SystemLocation> getLocations(const PlayOrder &order)
+{
+    std::vector<SystemLocation> locations;
+    for (const PlayOrder::Bar &bar : order)
+        locations.push_back(bar.myLocation);
+
+    return locations;
+}
+
+TEST_CASE("Score/PlayOrder/Repeats", "")
+{
+    Score score;
+    ScoreGenerator::generate(score, 2, 4);
+
+    // Repeat the first two bars of the second system three times.
+    System &system = score.getSystems()[1];
+    system.getBarlines()[0].setBarType(Barline::RepeatStart);
+    system.getBarlines()[2].setBarType(Barline::RepeatEnd);
+    system.getBarlines()[2].setRepeatCount(3);
+
+    const PlayOrder order(score);
+    REQUIRE(order.getNumBars() == 12);
+    REQUIRE(getLocations(order) ==
+            std::vector<SystemLocation>(
+                { SystemLocation(0, 0), SystemLocation(0, 9),
+                  SystemLocation(0, 18), SystemLocation(0, 27),
+                  SystemLocation(1, 0), SystemLocation(1, 9),
+                  SystemLocation(1, 0), SystemLocation(1, 9),
+                  SystemLocation(1, 0), SystemLocation(1, 9),
+                  SystemLocation(1, 18), SystemLocation(1, 27) }));
+
+    const PlayOrder::Bar &first_bar = order.getBar(0);
+    REQUIRE(first_bar.myPass == 0);
+    REQUIRE(first_bar.myTotalRepeatCount == 0);
+    REQUIRE(!first_bar.myIsPositionChange);
+    REQUIRE(first_bar.myNextLocation == SystemLocation(0, 9));
+
+    // The last bar of the system continues at the start of the next system.
+    REQUIRE(order.getBar(3).myNextLocation == SystemLocation(1, 0));
+
+    const PlayOrder::Bar &repeat_end = order.getBar(7);
+    REQUIRE(repeat_end.myPass == 1);
+    REQUIRE(repeat_end.myRepeatNumber == 2);
+    REQUIRE(repeat_end.myTotalRepeatCount == 3);
+    REQUIRE(repeat_end.myIsPositionChange);
+    REQUIRE(repeat_end.myNextLocation == SystemLocation(1, 0));
+
+    const PlayOrder::Bar &last_pass = order.getBar(9);
+    REQUIRE(last_pass.myPass == 2);
+    REQUIRE(last_pass.myRepeatNumber == 3);
+    REQUIRE(!last_pass.myIsPositionChange);
+
+    REQUIRE(order.getBar(11).myNextLocation == SystemLocation(2, 0));
+}
+
+TEST_CASE("Score/PlayOrder/AlternateEndings", "")
+{
+    Score score;
+    ScoreGenerator::generate(score, 1, 4);
+
+    // The first ending is the third bar, and the second ending is the fourth
+    // bar.
+    System &system = score.getSystems()[0];
+    system.getBarlines()[3].setBarType(Barline::RepeatEnd);
+    system.getBarlines()[3].setRepeatCount(2);
+
+    AlternateEnding ending1(18);
+    ending1.addNumber(1);
+    system.insertAlternateEnding(ending1);
+    AlternateEnding ending2(27);
+    ending2.addNumber(2);
+    system.insertAlternateEnding(ending2);
+
+    const PlayOrder order(score);
+    REQUIRE(getLocations(order) ==
+            std::vector<SystemLocation>(
+                { SystemLocation(0, 0), SystemLocation(0, 9),
+                  SystemLocation(0, 18), SystemLocation(0, 0),
+                  SystemLocation(0, 9), SystemLocation(0, 27) }));
+}
+
+TEST_CASE("Score/PlayOrder/Directions", "")
+{
+    Score score;
+    ScoreGenerator::generate(score, 2, 2);
+
+    Direction direction(10);
+    direction.insertSymbol(DirectionSymbol(DirectionSymbol::DaCapo));
+    score.getSystems()[1].insertDirection(direction);
+
+    const PlayOrder order(score);
+    REQUIRE(getLocations(order) ==
+            std::vector<SystemLocation>(
+                { SystemLocation(0, 0), SystemLocation(0, 9),
+                  SystemLocation(1, 0), SystemLocation(1, 9),
+                  SystemLocation(0, 0), SystemLocation(0, 9),
+                  SystemLocation(1, 0), SystemLocation(1, 9) }));
+    REQUIRE(order.getBar(3).myIsPositionChange);
+    REQUIRE(order.getBar(5).myPass == 1);
+
+    // Directions can be ignored.
+    const PlayOrder repeat_order(score, false);
+    REQUIRE(repeat_order.getNumBars() == 4);
+}
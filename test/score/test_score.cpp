@@ -18,6 +18,8 @@
 #include <catch.hpp>
 
 #include <score/score.h>
+#include <score/scorelocation.h>
+#include <vector>
 
 TEST_CASE("Score/Score/Systems", "")
 {
@@ -77,3 +79,207 @@ TEST_CASE("Score/Score/ViewFilters", "")
     REQUIRE(score.getViewFilters().size() == 1);
     REQUIRE(score.getViewFilters()[0] == filter1);
 }
+
+namespace
+{
+/// Creates systems that are identified by the position of their end bar.
+class TestSystemLoader : public SystemLoader
+{
+public:
+    TestSystemLoader(std::vector<int> &loads) : myLoads(loads)
+    {
+    }
+
+    void load(int index, System &system) override
+    {
+        myLoads.push_back(index);
+        system = System();
+        system.getBarlines()[1].setPosition(100 + index);
+    }
+
+    size_t getMemoryUsage(int) const override
+    {
+        return 10;
+    }
+
+private:
+    std::vector<int> &myLoads;
+};
+
+int getEndPosition(const System &system)
+{
+    return system.getBarlines()[1].getPosition();
+}
+}
+
+TEST_CASE("Score/Score/LazySystems", "")
+{
+    Score score;
+    for (int i = 0; i < 4; ++i)
+        score.insertSystem(System());
+
+    std::vector<int> loads;
+    score.setSystemLoader(
+        std::unique_ptr<SystemLoader>(new TestSystemLoader(loads)), 20);
+    REQUIRE(score.hasSystemLoader());
+    REQUIRE(score.getSystems().size() == 4);
+    REQUIRE(loads.empty());
+
+    // Systems are loaded when accessed, and only once.
+    const Score &const_score = score;
+    REQUIRE(getEndPosition(const_score.getSystems()[2]) == 102);
+    REQUIRE(getEndPosition(const_score.getSystems()[2]) == 102);
+    REQUIRE(loads == std::vector<int>({ 2 }));
+    REQUIRE(score.isSystemLoaded(2));
+    REQUIRE(!score.isSystemLoaded(0));
+
+    // Inserting and removing systems should keep track of the loader's
+    // indices.
+    score.removeSystem(0);
+    score.insertSystem(System(), 1);
+    REQUIRE(getEndPosition(const_score.getSystems()[0]) == 101);
+    REQUIRE(getEndPosition(const_score.getSystems()[1]) == 30);
+    REQUIRE(getEndPosition(const_score.getSystems()[3]) == 103);
+    REQUIRE(loads == std::vector<int>({ 2, 1, 3 }));
+
+    // Systems 0, 2, 3 are using 30 bytes, so the least recently used system
+    // that is unmodified should be unloaded.
+    score.getSystems()[3].getBarlines()[1].setPosition(50);
+    score.releaseSystems();
+    REQUIRE(score.isSystemLoaded(0));
+    REQUIRE(!score.isSystemLoaded(2));
+    REQUIRE(score.isSystemLoaded(3));
+
+    // Modified systems are not unloaded.
+    score.setSystemLoader(
+        std::unique_ptr<SystemLoader>(new TestSystemLoader(loads)), 0);
+    loads.clear();
+    score.getSystems()[0].getBarlines()[1].setPosition(50);
+    const_score.getSystems()[1];
+    score.releaseSystems();
+    REQUIRE(score.isSystemLoaded(0));
+    REQUIRE(!score.isSystemLoaded(1));
+    REQUIRE(getEndPosition(const_score.getSystems()[0]) == 50);
+
+    // Systems that are referenced by a snapshot are not unloaded.
+    std::shared_ptr<const System> snapshot = score.getSystemSnapshot(2);
+    score.releaseSystems();
+    REQUIRE(score.isSystemLoaded(2));
+    snapshot.reset();
+    score.releaseSystems();
+    REQUIRE(!score.isSystemLoaded(2));
+
+    // Loading everything detaches the loader.
+    score.loadAllSystems();
+    REQUIRE(!score.hasSystemLoader());
+    REQUIRE(loads == std::vector<int>({ 0, 1, 2, 1, 2, 3 }));
+    REQUIRE(getEndPosition(const_score.getSystems()[3]) == 103);
+}
+
+TEST_CASE("Score/Score/Snapshots", "")
+{
+    Score score;
+    for (int i = 0; i < 3; ++i)
+    {
+        score.insertSystem(System());
+        score.getSystems()[i].getBarlines()[1].setPosition(100 + i);
+    }
+
+    // Copies share the systems until they are modified.
+    Score copy(score);
+    REQUIRE(copy == score);
+    REQUIRE(&static_cast<const Score &>(copy).getSystems()[1] ==
+            &static_cast<const Score &>(score).getSystems()[1]);
+
+    // Reading through a const location does not copy a shared system.
+    const ScoreLocation location(score, 1);
+    REQUIRE(&location.getSystem() ==
+            &static_cast<const Score &>(copy).getSystems()[1]);
+
+    score.getSystems()[1].getBarlines()[1].setPosition(50);
+    REQUIRE(getEndPosition(score.getSystems()[1]) == 50);
+    REQUIRE(getEndPosition(copy.getSystems()[1]) == 101);
+    REQUIRE(getEndPosition(copy.getSystems()[0]) == 100);
+
+    score.removeSystem(0);
+    REQUIRE(copy.getSystems().size() == 3);
+
+    // System snapshots are unaffected by later changes, and can be restored.
+    std::shared_ptr<const System> snapshot = score.getSystemSnapshot(0);
+    score.getSystems()[0].getBarlines()[1].setPosition(60);
+    REQUIRE(getEndPosition(*snapshot) == 50);
+
+    score.setSystem(0, snapshot);
+    REQUIRE(getEndPosition(score.getSystems()[0]) == 50);
+
+    score.insertSystem(snapshot, 0);
+    score.getSystems()[0].getBarlines()[1].setPosition(70);
+    REQUIRE(getEndPosition(score.getSystems()[0]) == 70);
+    REQUIRE(getEndPosition(score.getSystems()[1]) == 50);
+    REQUIRE(getEndPosition(*snapshot) == 50);
+
+    // Once the snapshots are released, the system is modified in place and
+    // can be snapshotted again.
+    snapshot.reset();
+    score.getSystems()[1].getBarlines()[1].setPosition(80);
+    snapshot = score.getSystemSnapshot(1);
+    REQUIRE(getEndPosition(*snapshot) == 80);
+}
+
+TEST_CASE("Score/Score/LazySnapshots", "")
+{
+    Score score;
+    for (int i = 0; i < 3; ++i)
+        score.insertSystem(System());
+
+    std::vector<int> loads;
+    score.setSystemLoader(
+        std::unique_ptr<SystemLoader>(new TestSystemLoader(loads)), 0);
+
+    // Copies of a lazily loaded score share the loader.
+    Score copy(score);
+    REQUIRE(copy.hasSystemLoader());
+    REQUIRE(getEndPosition(copy.getSystems()[1]) == 101);
+    REQUIRE(!score.isSystemLoaded(1));
+
+    score.getSystems()[2].getBarlines()[1].setPosition(50);
+    REQUIRE(getEndPosition(copy.getSystems()[2]) == 102);
+    REQUIRE(getEndPosition(score.getSystems()[2]) == 50);
+}
+
+TEST_CASE("Score/Score/PlayerChanges", "")
+{
+    Score score;
+    for (int i = 0; i < 5; ++i)
+        score.insertSystem(System());
+
+    PlayerChange change;
+    change.setPosition(4);
+    score.getSystems()[1].insertPlayerChange(change);
+    change.setPosition(8);
+    score.getSystems()[1].insertPlayerChange(change);
+
+    REQUIRE(!score.getCurrentPlayers(0, 100));
+    REQUIRE(!score.getCurrentPlayers(1, 3));
+    REQUIRE(score.getCurrentPlayers(1, 4)->getPosition() == 4);
+    REQUIRE(score.getCurrentPlayers(1, 7)->getPosition() == 4);
+    REQUIRE(score.getCurrentPlayers(4, 0)->getPosition() == 8);
+    REQUIRE(score.getCurrentPlayers(5, 0)->getPosition() == 8);
+
+    // Adding a player change to a later system.
+    change.setPosition(2);
+    score.getSystems()[3].insertPlayerChange(change);
+    score.invalidatePlayerChanges(3);
+    REQUIRE(score.getCurrentPlayers(3, 1)->getPosition() == 8);
+    REQUIRE(score.getCurrentPlayers(4, 0) ==
+            &score.getSystems()[3].getPlayerChanges()[0]);
+
+    // Removing a system with a player change.
+    score.removeSystem(1);
+    REQUIRE(!score.getCurrentPlayers(1, 100));
+    REQUIRE(score.getCurrentPlayers(3, 0)->getPosition() == 2);
+
+    // The index recovers if the player changes in a system are removed.
+    score.getSystems()[2].removePlayerChange(change);
+    REQUIRE(!score.getCurrentPlayers(3, 0));
+}
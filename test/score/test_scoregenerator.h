@@ -0,0 +1,79 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TEST_SCORE_SCOREGENERATOR_H
+#define TEST_SCORE_SCOREGENERATOR_H
+
+#include <score/score.h>
+
+namespace ScoreGenerator {
+
+    /// Fills the score with synthetic data (eighth notes in 4/4 time), for
+    /// benchmarking operations on large scores.
+    inline void generate(Score &score, int numSystems, int barsPerSystem = 4,
+                         int numStaves = 1)
+    {
+        const int notesPerBar = 8;
+        const int barWidth = notesPerBar + 1;
+
+        for (int i = 0; i < numStaves; ++i)
+        {
+            score.insertPlayer(Player());
+            score.insertInstrument(Instrument());
+        }
+
+        for (int i = 0; i < numSystems; ++i)
+        {
+            System system;
+
+            for (int j = 0; j < numStaves; ++j)
+            {
+                Staff staff;
+                Voice &voice = staff.getVoices()[0];
+
+                for (int bar = 0; bar < barsPerSystem; ++bar)
+                {
+                    for (int n = 0; n < notesPerBar; ++n)
+                    {
+                        Position pos(bar * barWidth + n + 1);
+                        pos.insertNote(Note(n % 6, (i + bar + n) % 12));
+                        voice.insertPosition(pos);
+                    }
+                }
+
+                system.insertStaff(staff);
+            }
+
+            for (int bar = 1; bar < barsPerSystem; ++bar)
+                system.insertBarline(Barline(bar * barWidth, Barline::SingleBar));
+            system.getBarlines().back().setPosition(barsPerSystem * barWidth +
+                                                    1);
+
+            if (i == 0)
+            {
+                PlayerChange change(0);
+                for (int j = 0; j < numStaves; ++j)
+                    change.insertActivePlayer(j, ActivePlayer(j, j));
+                system.insertPlayerChange(change);
+            }
+
+            score.insertSystem(system);
+        }
+    }
+}
+
+#endif
@@ -20,6 +20,7 @@
 
 #include <catch.hpp>
 
+#include <score/binaryserialization.h>
 #include <score/serialization.h>
 #include <sstream>
 
@@ -38,6 +39,15 @@ namespace Serialization {
         ScoreUtils::load(input, name, copy);
 
         REQUIRE(original == copy);
+
+        // Also check the binary archive.
+        std::stringstream binary;
+        ScoreUtils::saveBinary(binary, original);
+
+        T binary_copy;
+        ScoreUtils::loadBinary(binary, binary_copy);
+
+        REQUIRE(original == binary_copy);
     }
 }
 
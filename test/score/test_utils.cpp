@@ -17,6 +17,8 @@
   
 #include <catch.hpp>
 
+#include <chrono>
+#include <iostream>
 #include <score/score.h>
 #include <score/system.h>
 #include <score/utils.h>
@@ -47,3 +49,70 @@ TEST_CASE("Score/Utils/GetCurrentPlayers", "")
     REQUIRE(ScoreUtils::getCurrentPlayers(score, 0, 7));
     REQUIRE(ScoreUtils::getCurrentPlayers(score, 1, 0));
 }
+
+TEST_CASE("Score/Utils/GetCurrentPlayers/Benchmark", "[.][benchmark]")
+{
+    using Clock = std::chrono::steady_clock;
+    using std::chrono::microseconds;
+
+    const int num_systems = 2000;
+    const int num_positions = 40;
+
+    Score score;
+    for (int i = 0; i < num_systems; ++i)
+    {
+        System system;
+        if (i % 50 == 0)
+        {
+            PlayerChange change;
+            change.setPosition(i % num_positions);
+            system.insertPlayerChange(change);
+        }
+        score.insertSystem(system);
+    }
+
+    // Look up the players at every position, as the notation layout does.
+    auto start = Clock::now();
+    size_t num_changes = 0;
+    for (int i = 0; i < num_systems; ++i)
+    {
+        for (int j = 0; j < num_positions; ++j)
+        {
+            if (ScoreUtils::getCurrentPlayers(score, i, j))
+                ++num_changes;
+        }
+    }
+    auto indexed_time = Clock::now() - start;
+
+    // Compare against scanning all of the previous systems.
+    start = Clock::now();
+    size_t num_scanned_changes = 0;
+    for (int i = 0; i < num_systems; ++i)
+    {
+        for (int j = 0; j < num_positions; ++j)
+        {
+            const PlayerChange *last_change = nullptr;
+            for (int k = 0; k <= i; ++k)
+            {
+                for (const PlayerChange &change :
+                     score.getSystems()[k].getPlayerChanges())
+                {
+                    if (k < i || change.getPosition() <= j)
+                        last_change = &change;
+                }
+            }
+
+            if (last_change)
+                ++num_scanned_changes;
+        }
+    }
+    auto scan_time = Clock::now() - start;
+
+    REQUIRE(num_changes == num_scanned_changes);
+
+    std::cout << "Looking up the players at every position: "
+              << std::chrono::duration_cast<microseconds>(scan_time).count()
+              << " us by scanning, "
+              << std::chrono::duration_cast<microseconds>(indexed_time).count()
+              << " us with the index" << std::endl;
+}
@@ -0,0 +1,60 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <catch.hpp>
+
+#include <numeric>
+#include <util/fenwicktree.h>
+#include <vector>
+
+TEST_CASE("Util/FenwickTree/PrefixSum", "")
+{
+    std::vector<int> values = { 3, 1, 4, 1, 5, 9, 2, 6, 5, 3 };
+    Util::FenwickTree<int> tree(values);
+
+    REQUIRE(tree.size() == values.size());
+    for (size_t i = 0; i <= values.size(); ++i)
+    {
+        REQUIRE(tree.prefixSum(i) ==
+                std::accumulate(values.begin(), values.begin() + i, 0));
+    }
+
+    tree.set(4, 10);
+    values[4] = 10;
+    REQUIRE(tree.get(4) == 10);
+    for (size_t i = 0; i <= values.size(); ++i)
+    {
+        REQUIRE(tree.prefixSum(i) ==
+                std::accumulate(values.begin(), values.begin() + i, 0));
+    }
+}
+
+TEST_CASE("Util/FenwickTree/CountPrefix", "")
+{
+    Util::FenwickTree<double> tree({ 10, 20, 0, 30 });
+
+    REQUIRE(tree.countPrefix(-1) == 0);
+    REQUIRE(tree.countPrefix(5) == 0);
+    REQUIRE(tree.countPrefix(10) == 1);
+    REQUIRE(tree.countPrefix(29) == 1);
+    REQUIRE(tree.countPrefix(30) == 3);
+    REQUIRE(tree.countPrefix(59) == 3);
+    REQUIRE(tree.countPrefix(60) == 4);
+    REQUIRE(tree.countPrefix(1000) == 4);
+
+    REQUIRE(Util::FenwickTree<double>().countPrefix(10) == 0);
+}
@@ -0,0 +1,92 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <catch.hpp>
+
+#include <sstream>
+#include <util/jsonpullparser.h>
+
+TEST_CASE("Util/JsonPullParser/Values", "")
+{
+    std::istringstream input(
+        "{ \"a\": -12, \"b\": [true, false, null], "
+        "\"c\": \"x\\\"\\u00e9\\n\", \"d\": {\"e\": [1.5e3, {}]}, \"f\": 7 }");
+    Util::JsonPullParser parser(input);
+    std::string name;
+
+    parser.startObject();
+    REQUIRE(parser.nextMember(name));
+    REQUIRE(name == "a");
+    REQUIRE(parser.readInt() == -12);
+
+    REQUIRE(parser.nextMember(name));
+    REQUIRE(name == "b");
+    parser.startArray();
+    REQUIRE(parser.nextElement());
+    REQUIRE(parser.readBool() == true);
+    REQUIRE(parser.nextElement());
+    REQUIRE(parser.readNull() == false);
+    REQUIRE(parser.readBool() == false);
+    REQUIRE(parser.nextElement());
+    REQUIRE(parser.readNull() == true);
+    REQUIRE(!parser.nextElement());
+
+    REQUIRE(parser.nextMember(name));
+    REQUIRE(name == "c");
+    std::string str;
+    parser.readString(str);
+    REQUIRE(str == "x\"\xc3\xa9\n");
+
+    REQUIRE(parser.nextMember(name));
+    REQUIRE(name == "d");
+    parser.skipValue();
+
+    REQUIRE(parser.nextMember(name));
+    REQUIRE(name == "f");
+    REQUIRE(parser.readUint() == 7);
+    REQUIRE(!parser.nextMember(name));
+}
+
+TEST_CASE("Util/JsonPullParser/Errors", "")
+{
+    {
+        std::istringstream input("{ \"a\": 1.5 }");
+        Util::JsonPullParser parser(input);
+        std::string name;
+        parser.startObject();
+        parser.nextMember(name);
+        REQUIRE_THROWS_AS(parser.readInt(), std::runtime_error);
+    }
+
+    {
+        std::istringstream input("[1 2]");
+        Util::JsonPullParser parser(input);
+        parser.startArray();
+        REQUIRE(parser.nextElement());
+        parser.readInt();
+        REQUIRE_THROWS_AS(parser.nextElement(), std::runtime_error);
+    }
+
+    {
+        std::istringstream input("{ \"a\": \"unterminated");
+        Util::JsonPullParser parser(input);
+        std::string name;
+        parser.startObject();
+        parser.nextMember(name);
+        REQUIRE_THROWS_AS(parser.readString(name), std::runtime_error);
+    }
+}
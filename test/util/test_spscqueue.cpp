@@ -0,0 +1,69 @@
+/*
+  * Copyright (C) 2016 Cameron White
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <catch.hpp>
+
+#include <thread>
+#include <util/spscqueue.h>
+
+TEST_CASE("Util/SpscQueue/PushPop", "")
+{
+    Util::SpscQueue<int> queue(2);
+    int value = 0;
+
+    REQUIRE(!queue.tryPop(value));
+    REQUIRE(queue.tryPush(1));
+    REQUIRE(queue.tryPush(2));
+    REQUIRE(!queue.tryPush(3));
+
+    REQUIRE(queue.tryPop(value));
+    REQUIRE(value == 1);
+    REQUIRE(queue.tryPush(3));
+
+    REQUIRE(queue.tryPop(value));
+    REQUIRE(value == 2);
+    REQUIRE(queue.tryPop(value));
+    REQUIRE(value == 3);
+    REQUIRE(!queue.tryPop(value));
+}
+
+TEST_CASE("Util/SpscQueue/Threads", "")
+{
+    const int count = 100000;
+    Util::SpscQueue<int> queue(16);
+
+    std::thread producer([&]() {
+        for (int i = 0; i < count; ++i)
+        {
+            while (!queue.tryPush(int(i)))
+                std::this_thread::yield();
+        }
+    });
+
+    bool in_order = true;
+    for (int i = 0; i < count; ++i)
+    {
+        int value = -1;
+        while (!queue.tryPop(value))
+            std::this_thread::yield();
+
+        in_order = in_order && value == i;
+    }
+
+    producer.join();
+    REQUIRE(in_order);
+}